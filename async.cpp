@@ -0,0 +1,289 @@
+#include "async.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+thread_local bool suspendable = false;
+// Будильник задачи, которую продвигает Resume этого потока.
+thread_local const std::shared_ptr<EvalWaker>* current_waker = nullptr;
+
+}  // namespace
+
+bool CanSuspend() {
+    return suspendable;
+}
+
+std::shared_ptr<EvalWaker> CurrentWaker() {
+    return current_waker ? *current_waker : nullptr;
+}
+
+SuspendGuard::SuspendGuard(bool allow) : previous_(suspendable) {
+    suspendable = allow;
+}
+
+SuspendGuard::~SuspendGuard() {
+    suspendable = previous_;
+}
+
+EvalTask EvalTask::promise_type::get_return_object() {
+    leaf = Handle::from_promise(*this);
+    return EvalTask{leaf};
+}
+
+std::coroutine_handle<> EvalTask::promise_type::FinalAwaiter::await_suspend(
+    std::coroutine_handle<promise_type> handle) noexcept {
+    auto& promise = handle.promise();
+    if (!promise.continuation) {
+        return std::noop_coroutine();
+    }
+    promise.root->leaf = promise.continuation;
+    return promise.continuation;
+}
+
+void EvalTask::promise_type::return_value(std::string value) {
+    result = std::move(value);
+}
+
+void EvalTask::promise_type::unhandled_exception() {
+    error = std::current_exception();
+}
+
+EvalTask::EvalTask(Handle handle) : handle_(handle) {
+}
+
+EvalTask::EvalTask(EvalTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {
+}
+
+EvalTask& EvalTask::operator=(EvalTask&& other) noexcept {
+    std::swap(handle_, other.handle_);
+    return *this;
+}
+
+EvalTask::~EvalTask() {
+    if (handle_) {
+        handle_.destroy();
+    }
+}
+
+bool EvalTask::Resume() {
+    if (!handle_.done()) {
+        auto& root = handle_.promise();
+        root.suspended = {};
+        auto previous = std::exchange(current_waker, &root.waker);
+        root.leaf.resume();
+        current_waker = previous;
+    }
+    return handle_.done();
+}
+
+bool EvalTask::Done() const {
+    return handle_.done();
+}
+
+const EvalSuspend& EvalTask::Suspended() const {
+    return handle_.promise().suspended;
+}
+
+void EvalTask::SetWaker(std::shared_ptr<EvalWaker> waker) {
+    handle_.promise().waker = std::move(waker);
+}
+
+std::string EvalTask::Result() {
+    auto& promise = handle_.promise();
+    if (promise.error) {
+        std::rethrow_exception(promise.error);
+    }
+    return std::move(promise.result);
+}
+
+bool EvalTask::await_ready() const noexcept {
+    return handle_.done();
+}
+
+std::coroutine_handle<> EvalTask::await_suspend(Handle awaiting) noexcept {
+    auto& promise = handle_.promise();
+    promise.continuation = awaiting;
+    promise.root = awaiting.promise().root;
+    promise.root->leaf = handle_;
+    return handle_;
+}
+
+std::string EvalTask::await_resume() {
+    return Result();
+}
+
+// Будильник задачи планировщика. Каналы и future держат его дольше самой задачи,
+// поэтому по её завершении он отвязывается от планировщика.
+class EvalScheduler::Sleeper : public EvalWaker {
+public:
+    explicit Sleeper(EvalScheduler* scheduler) : scheduler_(scheduler) {
+    }
+
+    void Wake() override {
+        std::lock_guard lock{mutex_};
+        if (scheduler_) {
+            scheduler_->Wake(this);
+        }
+    }
+
+    void Detach() {
+        std::lock_guard lock{mutex_};
+        scheduler_ = nullptr;
+    }
+
+    // Пробуждение пришло, пока задача не спала; под EvalScheduler::mutex_.
+    bool woken = false;
+
+private:
+    std::mutex mutex_;
+    EvalScheduler* scheduler_;
+};
+
+EvalScheduler::EvalScheduler(size_t threads) {
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+        threads_.emplace_back([this] { Run(); });
+    }
+}
+
+EvalScheduler::~EvalScheduler() {
+    {
+        std::unique_lock lock{mutex_};
+        idle_.wait(lock, [this] { return pending_ == 0; });
+        stop_ = true;
+    }
+    ready_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::future<std::string> EvalScheduler::Spawn(EvalTask task) {
+    Entry entry{std::move(task), {}, std::make_shared<Sleeper>(this)};
+    entry.task.SetWaker(entry.sleeper);
+    auto result = entry.result.get_future();
+    {
+        std::lock_guard lock{mutex_};
+        queue_.push_back(std::move(entry));
+        ++pending_;
+    }
+    ready_.notify_one();
+    return result;
+}
+
+size_t EvalScheduler::Pending() const {
+    std::lock_guard lock{mutex_};
+    return pending_;
+}
+
+void EvalScheduler::Run() {
+    while (true) {
+        Entry entry;
+        {
+            std::unique_lock lock{mutex_};
+            while (true) {
+                ExpireTimers();
+                if (stop_ || !queue_.empty()) {
+                    break;
+                }
+                if (timers_.empty()) {
+                    ready_.wait(lock);
+                } else {
+                    ready_.wait_until(lock, timers_.begin()->first);
+                }
+            }
+            if (queue_.empty()) {
+                return;
+            }
+            entry = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        if (!entry.task.Resume()) {
+            const EvalSuspend& suspended = entry.task.Suspended();
+            if (suspended.blocked) {
+                Park(std::move(entry), suspended.deadline);
+                continue;
+            }
+            {
+                std::lock_guard lock{mutex_};
+                queue_.push_back(std::move(entry));
+            }
+            ready_.notify_one();
+            continue;
+        }
+        std::string value;
+        std::exception_ptr error;
+        try {
+            value = entry.task.Result();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Кадр задачи держит объекты её интерпретатора: освобождаем его до того, как
+        // владелец узнает о завершении и сможет удалить интерпретатор.
+        entry.task = EvalTask{};
+        entry.sleeper->Detach();
+        if (error) {
+            entry.result.set_exception(error);
+        } else {
+            entry.result.set_value(std::move(value));
+        }
+        std::lock_guard lock{mutex_};
+        if (--pending_ == 0) {
+            idle_.notify_all();
+        }
+    }
+}
+
+void EvalScheduler::Park(Entry entry, std::chrono::steady_clock::time_point deadline) {
+    {
+        std::lock_guard lock{mutex_};
+        Sleeper* sleeper = entry.sleeper.get();
+        if (!std::exchange(sleeper->woken, false)) {
+            auto timer = timers_.end();
+            if (deadline != std::chrono::steady_clock::time_point::max()) {
+                timer = timers_.emplace(deadline, sleeper);
+            }
+            parked_.emplace(sleeper, Parked{std::move(entry), timer});
+            // Спящий поток мог ждать более позднего срока.
+            if (timer != timers_.end() && timer == timers_.begin()) {
+                ready_.notify_one();
+            }
+            return;
+        }
+        queue_.push_back(std::move(entry));
+    }
+    ready_.notify_one();
+}
+
+void EvalScheduler::Wake(Sleeper* sleeper) {
+    {
+        std::lock_guard lock{mutex_};
+        auto it = parked_.find(sleeper);
+        if (it == parked_.end()) {
+            sleeper->woken = true;
+            return;
+        }
+        if (it->second.timer != timers_.end()) {
+            timers_.erase(it->second.timer);
+        }
+        queue_.push_back(std::move(it->second.entry));
+        parked_.erase(it);
+    }
+    ready_.notify_one();
+}
+
+void EvalScheduler::ExpireTimers() {
+    auto now = std::chrono::steady_clock::now();
+    bool expired = false;
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+        auto it = parked_.find(timers_.begin()->second);
+        timers_.erase(timers_.begin());
+        queue_.push_back(std::move(it->second.entry));
+        parked_.erase(it);
+        expired = true;
+    }
+    if (expired) {
+        ready_.notify_all();
+    }
+}
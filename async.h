@@ -0,0 +1,214 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Приостановка вычисления посреди формы (см. EvalMachine). Бросается в безопасной
+// точке и ловится машиной; исключением из std::exception не является, чтобы его не
+// перехватили обработчики ошибок вычисления.
+struct EvalSuspend {
+    // Вычисление ждёт канала или future: продолжать его есть смысл после пробуждения
+    // (EvalWaker) или к сроку deadline.
+    bool blocked = false;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// Будит приостановленную задачу, когда то, чего она ждёт, стало доступно. Вызывается
+// из любого потока и может прийти раньше, чем задача действительно уснёт.
+class EvalWaker {
+public:
+    virtual void Wake() = 0;
+
+    virtual ~EvalWaker() = default;
+};
+
+// Можно ли сейчас бросить EvalSuspend: только внутри EvalMachine::Run и не под
+// SuspendGuard{false}.
+bool CanSuspend();
+
+// Будильник задачи, которую сейчас продвигает EvalTask::Resume; nullptr, если задачу
+// продолжают вручную.
+std::shared_ptr<EvalWaker> CurrentWaker();
+
+// Разрешает или запрещает приостановку, пока жив объект. Запрещают её вызовы, которые
+// держат состояние на стеке C++: задачи пула, функции C++, учёт профилировщика.
+class SuspendGuard {
+public:
+    explicit SuspendGuard(bool allow);
+
+    ~SuspendGuard();
+
+    SuspendGuard(const SuspendGuard&) = delete;
+    SuspendGuard& operator=(const SuspendGuard&) = delete;
+
+private:
+    bool previous_;
+};
+
+// Сопрограмма вычисления (см. Scheme::EvaluateAsync). Создаётся приостановленной и
+// продвигается через Resume до следующей точки уступки. Внутри другой EvalTask её
+// можно дождаться через co_await: уступки вложенной задачи приостанавливают всю цепочку.
+class EvalTask {
+public:
+    struct promise_type {
+        EvalTask get_return_object();
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        // Завершившаяся задача передаёт управление той, что её ждёт.
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<promise_type> handle) noexcept;
+
+            void await_resume() noexcept {
+            }
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_value(std::string value);
+
+        void unhandled_exception();
+
+        std::string result;
+        std::exception_ptr error;
+        std::coroutine_handle<promise_type> continuation;
+        // Корень цепочки co_await хранит самую вложенную задачу: её и продолжает Resume.
+        promise_type* root = this;
+        std::coroutine_handle<promise_type> leaf;
+        // Хранятся в корне: причина последней приостановки и будильник задачи.
+        EvalSuspend suspended;
+        std::shared_ptr<EvalWaker> waker;
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    // Точка уступки: задача возвращает управление тому, кто вызвал Resume.
+    using Yield = std::suspend_always;
+
+    // Уступка посреди формы: причина видна через Suspended.
+    struct Suspend {
+        EvalSuspend reason;
+
+        bool await_ready() noexcept {
+            return false;
+        }
+
+        void await_suspend(Handle handle) noexcept {
+            handle.promise().root->suspended = reason;
+        }
+
+        void await_resume() noexcept {
+        }
+    };
+
+    EvalTask() = default;
+
+    explicit EvalTask(Handle handle);
+
+    EvalTask(EvalTask&& other) noexcept;
+
+    EvalTask& operator=(EvalTask&& other) noexcept;
+
+    ~EvalTask();
+
+    // Выполняет задачу до следующей уступки; true, если она завершилась.
+    bool Resume();
+
+    bool Done() const;
+
+    // Почему задача остановилась при последнем Resume; по умолчанию — обычная уступка.
+    const EvalSuspend& Suspended() const;
+
+    // Будильник, который увидят ожидания задачи (см. CurrentWaker).
+    void SetWaker(std::shared_ptr<EvalWaker> waker);
+
+    // Результат завершённой задачи; её исключение пробрасывается.
+    std::string Result();
+
+    bool await_ready() const noexcept;
+
+    std::coroutine_handle<> await_suspend(Handle awaiting) noexcept;
+
+    std::string await_resume();
+
+private:
+    Handle handle_;
+};
+
+// Планировщик зелёных потоков: задачи по очереди продвигаются до уступки на
+// нескольких потоках ОС. Приостановленная задача занимает только кадр сопрограммы и
+// стек своей EvalMachine. Задача за раз выполняется одним потоком, но между уступками
+// может перейти на другой; интерпретатор задачи не должен использоваться больше нигде,
+// пока она идёт. Задача, ждущая канала или touch, не занимает поток: она спит, пока её
+// не разбудит другая сторона или не наступит срок её формы.
+class EvalScheduler {
+public:
+    explicit EvalScheduler(size_t threads);
+
+    // Дожидается завершения всех задач.
+    ~EvalScheduler();
+
+    EvalScheduler(const EvalScheduler&) = delete;
+    EvalScheduler& operator=(const EvalScheduler&) = delete;
+
+    std::future<std::string> Spawn(EvalTask task);
+
+    // Ожидающие, спящие и выполняющиеся задачи.
+    size_t Pending() const;
+
+private:
+    class Sleeper;
+
+    struct Entry {
+        EvalTask task;
+        std::promise<std::string> result;
+        std::shared_ptr<Sleeper> sleeper;
+    };
+
+    using Timers = std::multimap<std::chrono::steady_clock::time_point, Sleeper*>;
+
+    struct Parked {
+        Entry entry;
+        Timers::iterator timer;
+    };
+
+    void Run();
+
+    // Усыпляет задачу до Wake или срока; пробуждение, пришедшее раньше, не теряется.
+    void Park(Entry entry, std::chrono::steady_clock::time_point deadline);
+
+    void Wake(Sleeper* sleeper);
+
+    // Возвращает в очередь задачи, чей срок наступил. Вызывается под mutex_.
+    void ExpireTimers();
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable idle_;
+    std::deque<Entry> queue_;
+    std::unordered_map<Sleeper*, Parked> parked_;
+    Timers timers_;
+    size_t pending_ = 0;
+    bool stop_ = false;
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,244 @@
+#include <scheme.h>
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string kProgram = R"EOF(
+    (define (slow-add x y) (if (= x 0) y (slow-add (- x 1) (+ y 1))))
+    (define range (lambda (x) (lambda () (set! x (+ x 1)) x)))
+    (define (pair-sum p) (+ (car p) (cdr p)))
+    (list-tail '(1 2 3 4 5 6 7 8 9 10) 3)
+    (and (< 1 2 3) (>= 3 2 2) (not #f) 'done)
+    (+ 1 (* 2 3) (- 10 4) (/ 100 5) (max 1 2 3) (min 4 5 6) (abs -7))
+)EOF";
+
+// Лямбда в этом диалекте хранит одну область видимости на все вызовы, поэтому
+// хвостовые циклы передают состояние через аргументы в таком порядке, чтобы
+// последовательное связывание не портило ещё не вычисленные значения, а
+// нехвостовая рекурсия открывает новую область внутренней лямбдой.
+const std::vector<std::string> kFib = {
+    "(define fib (lambda (b a n) (if (= n 0) a (fib (+ a b) (- b a) (- n 1)))))"};
+
+const std::vector<std::string> kTak = {
+    R"EOF(
+    (define tak (lambda (x y z)
+      ((lambda (x y z)
+         (if (not (< y x))
+             z
+             ((lambda (a b c) (tak a b c))
+              (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y))))
+       x y z))))EOF"};
+
+const std::vector<std::string> kAckermann = {
+    R"EOF(
+    (define ack (lambda (m n)
+      ((lambda (m n)
+         (if (= m 0)
+             (+ n 1)
+             (if (= n 0)
+                 (ack (- m 1) 1)
+                 ((lambda (r) (ack (- m 1) r)) (ack m (- n 1))))))
+       m n))))EOF"};
+
+// Список из замыканий: (node 0) возвращает значение, (node 1) следующий узел.
+const std::vector<std::string> kSort = {
+    R"EOF(
+    (define make-node (lambda (v next)
+      ((lambda (v next) (lambda (op) (if (= op 0) v next))) v next))))EOF",
+    R"EOF(
+    (define build (lambda (acc seed n)
+      (if (= n 0)
+          acc
+          (build (make-node seed acc)
+                 (- (* seed 75) (* (/ (* seed 75) 65537) 65537))
+                 (- n 1))))))EOF",
+    R"EOF(
+    (define insert (lambda (v lst len)
+      ((lambda (v lst len)
+         (if (= len 0)
+             (make-node v 0)
+             (if (< v (lst 0))
+                 (make-node v lst)
+                 ((lambda (rest) (make-node (lst 0) rest)) (insert v (lst 1) (- len 1))))))
+       v lst len))))EOF",
+    R"EOF(
+    (define sort-loop (lambda (sorted count src len)
+      (if (= len 0)
+          sorted
+          (sort-loop (insert (src 0) sorted count) (+ count 1) (src 1) (- len 1))))))EOF",
+    R"EOF(
+    (define sorted? (lambda (prev lst len)
+      (if (= len 0)
+          #t
+          (if (< (lst 0) prev) #f (sorted? (lst 0) (lst 1) (- len 1)))))))EOF"};
+
+const std::vector<std::string> kDeepRecursion = {
+    "(define sum-to (lambda (n) ((lambda (n) (if (= n 0) 0 (+ n (sum-to (- n 1))))) n)))"};
+
+void Define(Scheme* scheme, const std::vector<std::string>& program) {
+    for (const auto& form : program) {
+        scheme->Evaluate(form);
+    }
+}
+
+void RunExpression(benchmark::State& state, Scheme* scheme, const std::string& expression,
+                   const std::string& expected) {
+    if (scheme->Evaluate(expression) != expected) {
+        state.SkipWithError(("unexpected result of " + expression).c_str());
+        return;
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scheme->Evaluate(expression));
+    }
+}
+
+void BM_TokenizerNext(benchmark::State& state) {
+    size_t tokens = 0;
+    for (auto _ : state) {
+        std::stringstream ss{kProgram};
+        Tokenizer tokenizer{&ss};
+        while (!tokenizer.IsEnd()) {
+            benchmark::DoNotOptimize(tokenizer.GetToken());
+            tokenizer.Next();
+            ++tokens;
+        }
+    }
+    state.SetItemsProcessed(tokens);
+    state.SetBytesProcessed(state.iterations() * kProgram.size());
+}
+BENCHMARK(BM_TokenizerNext);
+
+void BM_Read(benchmark::State& state) {
+    for (auto _ : state) {
+        std::stringstream ss{kProgram};
+        Tokenizer tokenizer{&ss};
+        benchmark::DoNotOptimize(ReadAll(&tokenizer));
+    }
+    state.SetBytesProcessed(state.iterations() * kProgram.size());
+}
+BENCHMARK(BM_Read);
+
+void BM_EvaluateArithmeticLiteral(benchmark::State& state) {
+    Scheme scheme;
+    RunExpression(state, &scheme, "(+ 1 (* 2 3) (- 10 4) (/ 100 5))", "33");
+}
+BENCHMARK(BM_EvaluateArithmeticLiteral);
+
+void BM_EvaluateArithmeticVariables(benchmark::State& state) {
+    Scheme scheme;
+    scheme.Evaluate("(define x 0)");
+    scheme.Evaluate("(set! x 2)");
+    RunExpression(state, &scheme, "(+ x (* x 3) (- 10 x) (/ 100 x))", "66");
+}
+BENCHMARK(BM_EvaluateArithmeticVariables);
+
+void BM_PreparedArithmeticVariables(benchmark::State& state) {
+    Scheme scheme;
+    auto prepared = scheme.Prepare("(+ x (* x 3) (- 10 x) (/ 100 x))", {"x"});
+    if (scheme.Run(prepared, 2).Print() != "66") {
+        state.SkipWithError("unexpected result of prepared expression");
+        return;
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(scheme.Run(prepared, 2));
+    }
+}
+BENCHMARK(BM_PreparedArithmeticVariables);
+
+void BM_LambdaCreate(benchmark::State& state) {
+    Scheme scheme;
+    scheme.Evaluate("(define f 0)");
+    for (auto _ : state) {
+        scheme.Evaluate("(set! f (lambda (x y) (+ x y)))");
+    }
+}
+BENCHMARK(BM_LambdaCreate);
+
+void BM_LambdaApply(benchmark::State& state) {
+    Scheme scheme;
+    scheme.Evaluate("(define add (lambda (x y) (+ x y)))");
+    RunExpression(state, &scheme, "(add 1 2)", "3");
+}
+BENCHMARK(BM_LambdaApply);
+
+void BM_ListBuildAndPrint(benchmark::State& state) {
+    Scheme scheme;
+    RunExpression(state, &scheme, "(list 1 2 3 4 5 6 7 8 9 10)", "(1 2 3 4 5 6 7 8 9 10)");
+}
+BENCHMARK(BM_ListBuildAndPrint);
+
+void BM_ListTail(benchmark::State& state) {
+    Scheme scheme;
+    RunExpression(state, &scheme, "(list-tail '(1 2 3 4 5 6 7 8 9 10) 7)", "(8 9 10)");
+}
+BENCHMARK(BM_ListTail);
+
+void BM_Fib(benchmark::State& state) {
+    Scheme scheme;
+    Define(&scheme, kFib);
+    RunExpression(state, &scheme, "(fib 1 0 80)", "23416728348467685");
+}
+BENCHMARK(BM_Fib);
+
+void BM_Tak(benchmark::State& state) {
+    Scheme scheme;
+    Define(&scheme, kTak);
+    RunExpression(state, &scheme, "(tak 12 8 4)", "5");
+}
+BENCHMARK(BM_Tak)->Unit(benchmark::kMillisecond);
+
+void BM_Ackermann(benchmark::State& state) {
+    Scheme scheme;
+    Define(&scheme, kAckermann);
+    RunExpression(state, &scheme, "(ack 2 9)", "21");
+}
+BENCHMARK(BM_Ackermann)->Unit(benchmark::kMillisecond);
+
+void BM_ListSort(benchmark::State& state) {
+    Scheme scheme;
+    Define(&scheme, kSort);
+    scheme.Evaluate("(define source (build 0 1 " + std::to_string(state.range(0)) + "))");
+    RunExpression(state, &scheme,
+                  "(sorted? 0 (sort-loop 0 0 source " + std::to_string(state.range(0)) + ") " +
+                      std::to_string(state.range(0)) + ")",
+                  "#t");
+}
+BENCHMARK(BM_ListSort)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond);
+
+void BM_DeepRecursion(benchmark::State& state) {
+    Scheme scheme;
+    Define(&scheme, kDeepRecursion);
+    int64_t depth = state.range(0);
+    RunExpression(state, &scheme, "(sum-to " + std::to_string(depth) + ")",
+                  std::to_string(depth * (depth + 1) / 2));
+}
+BENCHMARK(BM_DeepRecursion)->Arg(100)->Arg(500)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+// По умолчанию результаты печатаются в JSON, чтобы их можно было сравнивать
+// между версиями (например, через tools/compare.py из google/benchmark).
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+    std::string format = "--benchmark_format=json";
+    bool has_format = false;
+    for (int i = 1; i < argc; ++i) {
+        has_format |= std::string(argv[i]).rfind("--benchmark_format", 0) == 0;
+    }
+    if (!has_format) {
+        args.push_back(format.data());
+    }
+    int args_count = static_cast<int>(args.size());
+    benchmark::Initialize(&args_count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(args_count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "budget.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "error.h"
+
+int64_t EvalBudget::Remaining() const {
+    if (fuel_ == kUnlimited) {
+        return kUnlimited;
+    }
+    return fuel_ + std::max<int64_t>(slice_, 0);
+}
+
+void EvalBudget::Refill() {
+    if (fuel_ == 0) {
+        slice_ = 0;
+        throw FuelExhausted{"Топливо вычисления кончилось"};
+    }
+    bool has_deadline = deadline_ != Clock::time_point::max();
+    if (has_deadline && Clock::now() >= deadline_) {
+        slice_ = 0;
+        throw DeadlineExceeded{"Истёк срок вычисления"};
+    }
+    int64_t granted = has_deadline ? kSlice : kInfinite;
+    if (preemptive_) {
+        granted = kSlice;
+        preempt_ = std::exchange(granted_, true);
+    }
+    if (fuel_ != kUnlimited) {
+        granted = std::min(granted, fuel_);
+        fuel_ -= granted;
+    }
+    // Одна единица порции уходит на вызов, который сюда привёл.
+    slice_ = granted - 1;
+}
+
+void EvalBudget::ChargeWait() {
+    Charge();
+    if (deadline_ != Clock::time_point::max() && Clock::now() >= deadline_) {
+        slice_ = 0;
+        throw DeadlineExceeded{"Истёк срок вычисления"};
+    }
+}
+
+void EvalBudget::Spend(int64_t fuel) {
+    if (fuel_ == kUnlimited) {
+        return;
+    }
+    int64_t left = Remaining() - fuel;
+    // Следующий вызов возьмёт порцию заново уже из уменьшенного остатка.
+    slice_ = 0;
+    fuel_ = std::max<int64_t>(left, 0);
+    if (left < 0) {
+        throw FuelExhausted{"Топливо вычисления кончилось"};
+    }
+}
+
+EvalBudget::Activation::Activation(int64_t* fuel, std::chrono::nanoseconds timeout)
+    : Activation(fuel, timeout.count() > 0 ? Clock::now() + timeout : Clock::time_point::max()) {
+}
+
+EvalBudget::Activation::Activation(int64_t* fuel, std::chrono::steady_clock::time_point deadline)
+    : fuel_(fuel),
+      budget_(&eval_budget),
+      nested_(budget_->owner_ == fuel),
+      owner_(budget_->owner_),
+      slice_(budget_->slice_),
+      fuel_left_(budget_->fuel_),
+      deadline_(budget_->deadline_),
+      preemptive_(budget_->preemptive_) {
+    if (nested_) {
+        if (deadline < budget_->deadline_) {
+            // Порция могла быть выдана без срока: возвращаем её в остаток, чтобы
+            // следующий вызов сверил часы.
+            if (budget_->fuel_ != kUnlimited) {
+                budget_->fuel_ = budget_->Remaining();
+            }
+            budget_->slice_ = 0;
+            budget_->deadline_ = deadline;
+        }
+        return;
+    }
+    budget_->owner_ = fuel;
+    budget_->fuel_ = *fuel;
+    budget_->deadline_ = deadline;
+    budget_->preemptive_ = false;
+    bool limited = *fuel != kUnlimited || budget_->deadline_ != Clock::time_point::max();
+    budget_->slice_ = limited ? 0 : kInfinite;
+}
+
+EvalBudget::Activation::~Activation() {
+    if (nested_) {
+        budget_->deadline_ = deadline_;
+        return;
+    }
+    *fuel_ = budget_->Remaining();
+    budget_->owner_ = owner_;
+    budget_->slice_ = slice_;
+    budget_->fuel_ = fuel_left_;
+    budget_->deadline_ = deadline_;
+    budget_->preemptive_ = preemptive_;
+}
+
+EvalBudget::Preemption::Preemption() : budget_(&eval_budget), previous_(budget_->preemptive_) {
+    // Текущая порция может быть бесконечной: возвращаем её в остаток, чтобы уже
+    // следующий вызов взял порцию длиной kSlice.
+    if (budget_->fuel_ != kUnlimited) {
+        budget_->fuel_ = budget_->Remaining();
+    }
+    budget_->slice_ = 0;
+    budget_->preemptive_ = true;
+    budget_->granted_ = false;
+    budget_->preempt_ = false;
+}
+
+EvalBudget::Preemption::~Preemption() {
+    budget_->preemptive_ = previous_;
+    budget_->preempt_ = false;
+}
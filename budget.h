@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+// Бюджет вычисления текущего потока. Каждый вызов (Cell::Eval) списывает единицу
+// топлива из текущей порции: это одно уменьшение и ветвление. Когда порция кончается,
+// медленный путь берёт следующую из остатка и сверяет часы со сроком. Без ограничений
+// и вытеснения порция бесконечна и медленный путь не наступает.
+class EvalBudget {
+public:
+    static constexpr int64_t kUnlimited = -1;
+    // Порция при заданном сроке: часы читаются не чаще раза в kSlice вызовов.
+    static constexpr int64_t kSlice = 4096;
+
+    void Charge() {
+        if (--slice_ < 0) {
+            Refill();
+        }
+    }
+
+    // Для ожиданий вне вычислителя (см. Channel): списывает единицу и сразу сверяет
+    // срок, не дожидаясь конца порции.
+    void ChargeWait();
+
+    // Поднимался ли с прошлого вызова флаг вытеснения (см. Preemption); снимает его.
+    bool TakePreemption() {
+        return std::exchange(preempt_, false);
+    }
+
+    // Остаток топлива или kUnlimited.
+    int64_t Remaining() const;
+
+    std::chrono::steady_clock::time_point Deadline() const {
+        return deadline_;
+    }
+
+    // Списывает топливо, израсходованное в другом потоке (см. future); если его не хватает,
+    // остаток обнуляется и бросается FuelExhausted.
+    void Spend(int64_t fuel);
+
+    // Ограничения действуют, пока жив объект; по выходу остаток топлива записывается
+    // обратно в *fuel, а прежние ограничения потока восстанавливаются. Вложенная
+    // активация с тем же *fuel (например, Evaluate из зарегистрированной функции C++)
+    // продолжает внешний бюджет и может только приблизить срок.
+    class Activation {
+    public:
+        Activation(int64_t* fuel, std::chrono::nanoseconds timeout);
+
+        // Срок задан моментом; time_point::max() — без срока.
+        Activation(int64_t* fuel, std::chrono::steady_clock::time_point deadline);
+
+        ~Activation();
+
+        Activation(const Activation&) = delete;
+        Activation& operator=(const Activation&) = delete;
+
+    private:
+        int64_t* fuel_;
+        EvalBudget* budget_;
+        bool nested_;
+        int64_t* owner_;
+        int64_t slice_;
+        int64_t fuel_left_;
+        std::chrono::steady_clock::time_point deadline_;
+        bool preemptive_;
+    };
+
+    // Пока жив объект, медленный путь служит точкой вытеснения (см. EvalMachine):
+    // порции не длиннее kSlice даже без ограничений, и каждая следующая после первой
+    // поднимает флаг, который машина снимает в безопасной точке. Невложенная
+    // активация на время своей жизни вытеснение выключает.
+    class Preemption {
+    public:
+        Preemption();
+
+        ~Preemption();
+
+        Preemption(const Preemption&) = delete;
+        Preemption& operator=(const Preemption&) = delete;
+
+    private:
+        EvalBudget* budget_;
+        bool previous_;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int64_t kInfinite = std::numeric_limits<int64_t>::max();
+
+    void Refill();
+
+    int64_t slice_ = kInfinite;
+    // Топливо за вычетом текущей порции.
+    int64_t fuel_ = kUnlimited;
+    Clock::time_point deadline_ = Clock::time_point::max();
+    // Остаток топлива, который обновит самая внешняя активация.
+    int64_t* owner_ = nullptr;
+    bool preemptive_ = false;
+    // Порция уже выдавалась с начала Preemption: следующая поднимет preempt_.
+    bool granted_ = false;
+    bool preempt_ = false;
+};
+
+inline thread_local EvalBudget eval_budget;
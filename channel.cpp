@@ -0,0 +1,277 @@
+#include "channel.h"
+
+#include <chrono>
+#include <limits>
+#include <thread>
+
+#include "async.h"
+#include "budget.h"
+#include "image.h"
+
+namespace {
+
+const std::string kValue = " value";
+
+constexpr int kSpins = 64;
+constexpr int kYields = 16;
+// Сон ограничен: пробуждение может разминуться с уведомлением, а бюджет потока
+// надо проверять и пока очередь стоит.
+constexpr std::chrono::milliseconds kWaitSlice{1};
+
+void Pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+std::shared_ptr<Channel> ChannelArgument(const Ref<Object>& value, const char* name) {
+    auto channel = As<ChannelObject>(value);
+    if (!channel) {
+        throw RuntimeError{std::string{name} + " ожидает канал"};
+    }
+    return channel->GetChannel();
+}
+
+}  // namespace
+
+Channel::BufferCharge::BufferCharge(HeapAccount* account, size_t bytes)
+    : account_(account), bytes_(bytes) {
+    if (account_) {
+        account_->Charge(bytes_);
+    }
+}
+
+Channel::BufferCharge::~BufferCharge() {
+    if (account_) {
+        account_->Release(bytes_);
+    }
+}
+
+Channel::Channel(size_t capacity, HeapAccount* account)
+    : charge_(account, BufferBytes(capacity)), slots_(capacity) {
+    for (size_t i = 0; i < capacity; ++i) {
+        slots_[i].sequence.store(2 * i, std::memory_order_relaxed);
+    }
+}
+
+size_t Channel::Capacity() const {
+    return slots_.size();
+}
+
+size_t Channel::BufferBytes(size_t capacity) {
+    if (capacity > (std::numeric_limits<size_t>::max() / 2 - sizeof(Channel)) / sizeof(Slot)) {
+        throw RuntimeError{"Слишком большая ёмкость канала"};
+    }
+    return sizeof(Channel) + capacity * sizeof(Slot);
+}
+
+void Channel::Send(const Ref<Object>& value) {
+    Message message = Pack(value);
+    Wait([this, &message] { return TryPush(&message); });
+    Notify();
+}
+
+Ref<Object> Channel::Receive() {
+    Message message;
+    Wait([this, &message] { return TryPop(&message); });
+    Notify();
+    return Unpack(message);
+}
+
+bool Channel::TrySend(const Ref<Object>& value) {
+    Message message = Pack(value);
+    if (!TryPush(&message)) {
+        return false;
+    }
+    Notify();
+    return true;
+}
+
+bool Channel::TryReceive(Ref<Object>* value) {
+    Message message;
+    if (!TryPop(&message)) {
+        return false;
+    }
+    Notify();
+    *value = Unpack(message);
+    return true;
+}
+
+// Сначала крутимся и уступаем процессор: очередь рассчитана на короткие ожидания.
+// Дальше поток спит на условной переменной до уведомления с другой стороны, а
+// вычисление EvalMachine приостанавливается, оставив будильник своей задачи.
+template <class Attempt>
+void Channel::Wait(Attempt attempt) {
+    for (int spins = 0; spins < kSpins + kYields; ++spins) {
+        if (attempt()) {
+            return;
+        }
+        if (spins < kSpins) {
+            Pause();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    if (CanSuspend()) {
+        eval_budget.ChargeWait();
+        // Будильник записывается до последней попытки: уведомление, пришедшее между
+        // ними, его уже застанет.
+        if (auto waker = CurrentWaker()) {
+            std::lock_guard lock{wait_mutex_};
+            sleepers_.push_back(std::move(waker));
+            waiters_.fetch_add(1);
+        }
+        if (attempt()) {
+            return;
+        }
+        throw EvalSuspend{true, eval_budget.Deadline()};
+    }
+    waiters_.fetch_add(1);
+    struct Leave {
+        std::atomic<uint32_t>* waiters;
+        ~Leave() {
+            waiters->fetch_sub(1, std::memory_order_relaxed);
+        }
+    } leave{&waiters_};
+    std::unique_lock lock{wait_mutex_};
+    while (!attempt()) {
+        eval_budget.ChargeWait();
+        changed_.wait_for(lock, kWaitSlice);
+    }
+}
+
+// Вызывается после каждой удачной операции: она могла освободить место или принести
+// сообщение тому, кто ждёт с другой стороны.
+void Channel::Notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    std::vector<std::shared_ptr<EvalWaker>> sleepers;
+    {
+        std::lock_guard lock{wait_mutex_};
+        sleepers.swap(sleepers_);
+        waiters_.fetch_sub(static_cast<uint32_t>(sleepers.size()), std::memory_order_relaxed);
+    }
+    changed_.notify_all();
+    for (const auto& sleeper : sleepers) {
+        sleeper->Wake();
+    }
+}
+
+Channel::Message Channel::Pack(const Ref<Object>& value) {
+    Message message;
+    if (auto number = As<Number>(value)) {
+        message.number = number->GetValue();
+    } else if (auto boolean = As<Boolean>(value)) {
+        message.kind = Message::Kind::BOOLEAN;
+        message.number = boolean->GetBool();
+    } else {
+        message.kind = Message::Kind::IMAGE;
+        message.image = PackBindings({{kValue, value}}, nullptr);
+    }
+    return message;
+}
+
+Ref<Object> Channel::Unpack(const Message& message) {
+    switch (message.kind) {
+        case Message::Kind::NUMBER:
+            return MakeRef<Number>(message.number);
+        case Message::Kind::BOOLEAN:
+            return MakeRef<Boolean>(message.number != 0);
+        case Message::Kind::IMAGE:
+            return UnpackBindings(message.image)->GetElementScope(kValue);
+    }
+    return nullptr;
+}
+
+// Очередь Вьюкова: номер в ячейке говорит, чей сейчас ход — писателя с позицией
+// sequence / 2 (чётный номер) или читателя с этой позицией (нечётный). Номера удвоены,
+// чтобы и очередь из одной ячейки отличала полную от пустой.
+bool Channel::TryPush(Message* message) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots_[pos % slots_.size()];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(2 * pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->message = std::move(*message);
+    slot->sequence.store(2 * pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool Channel::TryPop(Message* message) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots_[pos % slots_.size()];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(2 * pos + 1);
+        if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+    *message = std::move(slot->message);
+    slot->sequence.store(2 * (pos + slots_.size()), std::memory_order_release);
+    return true;
+}
+
+ChannelObject::ChannelObject(std::shared_ptr<Channel> channel) : channel_(std::move(channel)) {
+}
+
+Ref<Object> ChannelObject::Eval(const Ref<Scope>&) {
+    return Ref<Object>(this);
+}
+
+std::string ChannelObject::Print() {
+    return "#<channel>";
+}
+
+const std::shared_ptr<Channel>& ChannelObject::GetChannel() const {
+    return channel_;
+}
+
+Ref<Object> MakeChannel::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto args_list = EvalArguments(args, scope);
+    if (args_list.size() != 1 || !Is<Number>(args_list[0]) ||
+        As<Number>(args_list[0])->GetValue() <= 0) {
+        throw RuntimeError{"make-channel ожидает положительную ёмкость"};
+    }
+    auto capacity = static_cast<size_t>(As<Number>(args_list[0])->GetValue());
+    // Канал может пережить свой объект (см. Scheme::GetChannel), поэтому буфер
+    // записан на счёт самого канала.
+    return MakeRef<ChannelObject>(std::make_shared<Channel>(capacity, heap_account));
+}
+
+Ref<Object> ChannelSend::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto args_list = EvalArguments(args, scope);
+    if (args_list.size() != 2) {
+        throw RuntimeError{"Неверное количество аргументов для channel-send!"};
+    }
+    ChannelArgument(args_list[0], "channel-send!")->Send(args_list[1]);
+    return MakeRef<Boolean>(true);
+}
+
+Ref<Object> ChannelReceive::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto args_list = EvalArguments(args, scope);
+    if (args_list.size() != 1) {
+        throw RuntimeError{"Неверное количество аргументов для channel-receive"};
+    }
+    return ChannelArgument(args_list[0], "channel-receive")->Receive();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+class EvalWaker;
+
+// Ограниченная очередь сообщений между интерпретаторами разных потоков (много
+// писателей, много читателей, без блокировок). Объекты интерпретатора не
+// разделяются: числа и булевы значения передаются как есть, остальное — снимком
+// (см. PackBindings), который получатель восстанавливает в своей куче.
+class Channel {
+public:
+    // С account буфер записывается на этот счёт до выделения и возвращается ему, когда
+    // канал удаляется, даже если к тому времени его держит уже не тот интерпретатор.
+    explicit Channel(size_t capacity, HeapAccount* account = nullptr);
+
+    size_t Capacity() const;
+
+    // Память очереди ёмкостью capacity без самих сообщений.
+    static size_t BufferBytes(size_t capacity);
+
+    // Ждут, пока в очереди появится место или сообщение: недолго крутятся, потом
+    // засыпают. Ожидание тратит бюджет потока (см. EvalBudget::ChargeWait) и
+    // прерывается по его сроку или топливу. Внутри EvalMachine вместо сна вычисление
+    // приостанавливается (EvalSuspend), а задачу будит другая сторона канала.
+    void Send(const Ref<Object>& value);
+
+    Ref<Object> Receive();
+
+    bool TrySend(const Ref<Object>& value);
+
+    bool TryReceive(Ref<Object>* value);
+
+private:
+    struct Message {
+        enum class Kind { NUMBER, BOOLEAN, IMAGE };
+
+        Kind kind = Kind::NUMBER;
+        int64_t number = 0;
+        std::string image;
+    };
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Message message;
+    };
+
+    class BufferCharge {
+    public:
+        BufferCharge(HeapAccount* account, size_t bytes);
+
+        ~BufferCharge();
+
+        BufferCharge(const BufferCharge&) = delete;
+        BufferCharge& operator=(const BufferCharge&) = delete;
+
+    private:
+        HeapAccount* account_;
+        size_t bytes_;
+    };
+
+    static Message Pack(const Ref<Object>& value);
+
+    static Ref<Object> Unpack(const Message& message);
+
+    bool TryPush(Message* message);
+
+    bool TryPop(Message* message);
+
+    template <class Attempt>
+    void Wait(Attempt attempt);
+
+    void Notify();
+
+    // Объявлен до slots_: жёсткий предел отказывает раньше, чем придёт огромный запрос.
+    BufferCharge charge_;
+    std::vector<Slot> slots_;
+    alignas(64) std::atomic<size_t> enqueue_pos_ = 0;
+    alignas(64) std::atomic<size_t> dequeue_pos_ = 0;
+    alignas(64) std::atomic<uint32_t> waiters_ = 0;
+    std::mutex wait_mutex_;
+    std::condition_variable changed_;
+    // Приостановленные задачи; каждая учтена и в waiters_.
+    std::vector<std::shared_ptr<EvalWaker>> sleepers_;
+};
+
+class ChannelObject : public Object {
+public:
+    explicit ChannelObject(std::shared_ptr<Channel> channel);
+
+    Ref<Object> Eval(const Ref<Scope>&) override;
+
+    std::string Print() override;
+
+    const std::shared_ptr<Channel>& GetChannel() const;
+
+private:
+    std::shared_ptr<Channel> channel_;
+};
+
+class MakeChannel : public Object {
+public:
+    MakeChannel() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+class ChannelSend : public Object {
+public:
+    ChannelSend() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+class ChannelReceive : public Object {
+public:
+    ChannelReceive() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
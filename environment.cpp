@@ -0,0 +1,212 @@
+#include "environment.h"
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <limits>
+#include <shared_mutex>
+
+#include "scheme.h"
+
+namespace {
+
+constexpr size_t kMaxReaders = 256;
+
+// Цепочка образов начинается заново, когда в ней столько образов или когда они весят
+// вдвое больше полного образа (с запасом для маленького окружения).
+constexpr size_t kMaxJournalLength = 4096;
+constexpr size_t kJournalSlack = 1 << 16;
+
+// Ноль в epoch означает, что поток сейчас не читает снимок.
+struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch = 0;
+    std::atomic<bool> used = false;
+};
+
+std::array<ReaderSlot, kMaxReaders> reader_slots;
+std::atomic<uint64_t> global_epoch = 1;
+
+// Потоки сверх kMaxReaders читают под разделяемой блокировкой, а освобождение
+// снимков берёт её исключительно.
+std::shared_mutex overflow_mutex;
+
+class ReaderRegistration {
+public:
+    ReaderRegistration() {
+        for (auto& slot : reader_slots) {
+            bool expected = false;
+            if (slot.used.compare_exchange_strong(expected, true)) {
+                slot_ = &slot;
+                return;
+            }
+        }
+    }
+
+    ~ReaderRegistration() {
+        if (slot_) {
+            slot_->used.store(false, std::memory_order_release);
+        }
+    }
+
+    ReaderSlot* Slot() const {
+        return slot_;
+    }
+
+private:
+    ReaderSlot* slot_ = nullptr;
+};
+
+thread_local ReaderRegistration registration;
+
+// Пока объект жив, снимки, которые поток мог увидеть, не освобождаются.
+class EpochGuard {
+public:
+    EpochGuard() : slot_(registration.Slot()) {
+        if (slot_) {
+            slot_->epoch.store(global_epoch.load());
+        } else {
+            overflow_mutex.lock_shared();
+        }
+    }
+
+    ~EpochGuard() {
+        if (slot_) {
+            slot_->epoch.store(0, std::memory_order_release);
+        } else {
+            overflow_mutex.unlock_shared();
+        }
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+private:
+    ReaderSlot* slot_;
+};
+
+}  // namespace
+
+SharedEnvironment::Replica::Replica() : scope_(MakeRef<Scope>()), reader_(scope_) {
+    AddBuiltins(scope_);
+    scope_->Freeze();
+}
+
+const Ref<Scope>& SharedEnvironment::Replica::GetScope() const {
+    return scope_;
+}
+
+void SharedEnvironment::Replica::Refresh(const SharedEnvironment& environment) {
+    uint64_t version = version_;
+    std::shared_ptr<const Journal> head;
+    if (!environment.ReadIfNewer(&version, &head)) {
+        return;
+    }
+    std::vector<const Journal*> pending;
+    for (auto journal = head.get(); journal && journal->version > version_;
+         journal = journal->previous.get()) {
+        pending.push_back(journal);
+    }
+    Scope::Thaw thaw{scope_.get()};
+    if (!pending.empty() && !pending.back()->previous) {
+        // Журнал начат заново: номера прежних объектов в нём ничего не значат.
+        scope_->Clear();
+        AddBuiltins(scope_);
+        reader_ = ImageJournalReader{scope_};
+    }
+    for (auto it = pending.rbegin(); it != pending.rend(); ++it) {
+        reader_.Read((*it)->image);
+    }
+    version_ = version;
+}
+
+SharedEnvironment::SharedEnvironment()
+    : writer_(std::make_unique<Scheme>()), journal_(writer_->scope_) {
+    Publish();
+}
+
+SharedEnvironment::~SharedEnvironment() {
+    delete current_.load();
+    for (const auto& [epoch, snapshot] : retired_) {
+        delete snapshot;
+    }
+}
+
+std::string SharedEnvironment::Evaluate(const std::string& expression) {
+    std::lock_guard lock{writer_mutex_};
+    std::string result;
+    std::exception_ptr error;
+    {
+        ChangeObserver::Activation changes{&journal_};
+        try {
+            result = writer_->Evaluate(expression);
+        } catch (...) {
+            // Изменения, сделанные до ошибки, остаются у писателя.
+            error = std::current_exception();
+        }
+    }
+    Publish();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return result;
+}
+
+bool SharedEnvironment::ReadIfNewer(uint64_t* version,
+                                    std::shared_ptr<const Journal>* journal) const {
+    if (version_.load(std::memory_order_acquire) == *version) {
+        return false;
+    }
+    EpochGuard guard;
+    const Snapshot* snapshot = current_.load();
+    *version = snapshot->version;
+    *journal = snapshot->journal;
+    return true;
+}
+
+void SharedEnvironment::Publish() {
+    const Snapshot* current = current_.load(std::memory_order_relaxed);
+    if (!current || journal_length_ >= kMaxJournalLength ||
+        journal_size_ > 2 * complete_size_ + kJournalSlack) {
+        journal_.Reset();
+        current = nullptr;
+    }
+    auto image = journal_.Write();
+    if (current) {
+        journal_size_ += image.size();
+        ++journal_length_;
+    } else {
+        complete_size_ = image.size();
+        journal_size_ = 0;
+        journal_length_ = 0;
+    }
+    uint64_t version = version_.load(std::memory_order_relaxed) + 1;
+    auto journal = std::make_shared<const Journal>(
+        Journal{version, std::move(image), current ? current->journal : nullptr});
+    Snapshot* previous = current_.exchange(new Snapshot{version, std::move(journal)});
+    version_.store(version, std::memory_order_release);
+    if (previous) {
+        retired_.emplace_back(global_epoch.fetch_add(1), previous);
+    }
+    Reclaim();
+}
+
+// Снимок, снятый с публикации в эпоху e, мог увидеть только читатель, объявивший
+// эпоху не больше e.
+void SharedEnvironment::Reclaim() {
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const auto& slot : reader_slots) {
+        if (uint64_t epoch = slot.epoch.load()) {
+            oldest = std::min(oldest, epoch);
+        }
+    }
+    std::unique_lock overflow{overflow_mutex};
+    auto reclaimable = [oldest](const std::pair<uint64_t, Snapshot*>& retired) {
+        return retired.first < oldest;
+    };
+    for (const auto& retired : retired_) {
+        if (reclaimable(retired)) {
+            delete retired.second;
+        }
+    }
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(), reclaimable), retired_.end());
+}
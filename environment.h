@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "image.h"
+
+class Scheme;
+
+// Общий набор глобальных определений для многих интерпретаторов (см. Scheme::Attach).
+// Писатель меняет его через Evaluate и публикует образ журнала (см. ImageJournalWriter)
+// только с тем, что вычисление изменило, поэтому цена публикации не растёт с размером
+// окружения. Образы связаны в цепочку от полного образа; когда она становится длиннее
+// или тяжелее, чем полный образ, журнал начинается заново. Читатели забирают голову
+// цепочки без блокировок и ожидания писателя. Старые снимки освобождаются, когда их
+// не может читать ни один поток (эпохи).
+class SharedEnvironment {
+public:
+    // Образ журнала; без previous это полный образ, с которого начинается цепочка.
+    struct Journal {
+        uint64_t version;
+        std::string image;
+        std::shared_ptr<const Journal> previous;
+    };
+
+    // Копия окружения у читателя, общая для его клонов. Область заморожена, поэтому
+    // define, set! и set-car! читателя уходят в его собственную глобальную область и
+    // не расходятся с писателем при следующих образах.
+    class Replica {
+    public:
+        Replica();
+
+        const Ref<Scope>& GetScope() const;
+
+        // Применяет образы, опубликованные после прошлого обновления.
+        void Refresh(const SharedEnvironment& environment);
+
+    private:
+        uint64_t version_ = 0;
+        Ref<Scope> scope_;
+        ImageJournalReader reader_;
+    };
+
+    SharedEnvironment();
+
+    ~SharedEnvironment();
+
+    SharedEnvironment(const SharedEnvironment&) = delete;
+    SharedEnvironment& operator=(const SharedEnvironment&) = delete;
+
+    // Вычисляет выражение в интерпретаторе писателя и публикует его изменения, даже
+    // если вычисление прервалось ошибкой. Писатели выполняются по одному.
+    std::string Evaluate(const std::string& expression);
+
+    uint64_t Version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    // Если опубликован снимок новее *version, отдаёт голову цепочки в journal и
+    // обновляет *version. Когда версия не менялась, стоит одного атомарного чтения.
+    bool ReadIfNewer(uint64_t* version, std::shared_ptr<const Journal>* journal) const;
+
+private:
+    struct Snapshot {
+        uint64_t version;
+        std::shared_ptr<const Journal> journal;
+    };
+
+    void Publish();
+
+    void Reclaim();
+
+    std::mutex writer_mutex_;
+    std::unique_ptr<Scheme> writer_;
+    ImageJournalWriter journal_;
+    // Размер полного образа в начале цепочки и всех образов после него.
+    size_t complete_size_ = 0;
+    size_t journal_size_ = 0;
+    size_t journal_length_ = 0;
+    std::atomic<Snapshot*> current_ = nullptr;
+    std::atomic<uint64_t> version_ = 0;
+    std::vector<std::pair<uint64_t, Snapshot*>> retired_;
+};
@@ -1,17 +1,62 @@
 #pragma once
 
+#include <memory>
 #include <stdexcept>
+#include <string>
+
+#include "trace.h"
 
 class SyntaxError : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-class RuntimeError : public std::runtime_error {
-    using std::runtime_error::runtime_error;
+// Ошибка вычисления. Если в потоке включена трассировка, запоминает последние
+// вызовы на момент броска.
+class EvalError : public std::runtime_error {
+public:
+    explicit EvalError(const std::string& message) : std::runtime_error{message} {
+        if (eval_trace.enabled) {
+            trace_ = std::make_shared<const std::string>(eval_trace.Dump());
+        }
+    }
+
+    // Пустая строка, если трассировка была выключена.
+    const std::string& Trace() const {
+        static const std::string kEmpty;
+        return trace_ ? *trace_ : kEmpty;
+    }
+
+private:
+    std::shared_ptr<const std::string> trace_;
+};
+
+class RuntimeError : public EvalError {
+    using EvalError::EvalError;
 };
 
-class NameError : public std::runtime_error {
+class NameError : public EvalError {
 public:
-    explicit NameError(const std::string& name) : std::runtime_error{"Name not found: " + name} {
+    explicit NameError(const std::string& name) : EvalError{"Name not found: " + name} {
     }
 };
+
+// Вычисление прервано ограничением интерпретатора; сам интерпретатор остаётся
+// пригодным, следующее Evaluate работает с тем, что осталось от ограничения.
+class LimitError : public EvalError {
+    using EvalError::EvalError;
+};
+
+// Кончилось топливо (см. Scheme::SetFuel).
+class FuelExhausted : public LimitError {
+    using LimitError::LimitError;
+};
+
+// Истёк срок одного вычисления (см. Scheme::SetTimeout).
+class DeadlineExceeded : public LimitError {
+    using LimitError::LimitError;
+};
+
+// Превышен жёсткий предел памяти интерпретатора (см. Scheme::SetHeapLimits).
+class HeapLimitExceeded : public LimitError {
+    using LimitError::LimitError;
+};
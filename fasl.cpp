@@ -0,0 +1,214 @@
+#include "fasl.h"
+
+#include <iterator>
+#include <unordered_map>
+
+#include "parser.h"
+
+namespace {
+
+const std::string kFaslMagic = "SFSL\x01";
+
+enum class FaslTag : uint8_t { NUMBER, TRUE, FALSE, SYMBOL, CELL };
+
+class FaslWriter {
+public:
+    // Возвращает индекс объекта + 1, ноль означает пустой указатель.
+    uint64_t Emit(const Ref<Object>& obj) {
+        if (!obj) {
+            return 0;
+        }
+        if (!Is<Cell>(obj)) {
+            return EmitAtom(obj);
+        }
+        std::vector<Ref<Cell>> spine;
+        Ref<Object> curent = obj;
+        while (Is<Cell>(curent)) {
+            spine.push_back(As<Cell>(curent));
+            curent = spine.back()->GetSecond();
+        }
+        uint64_t second = Emit(curent);
+        for (auto it = spine.rbegin(); it != spine.rend(); ++it) {
+            uint64_t first = Emit((*it)->GetFirst());
+            objects_ += static_cast<char>(FaslTag::CELL);
+            WriteVarint(Relative(first), &objects_);
+            WriteVarint(Relative(second), &objects_);
+            second = ++object_count_;
+        }
+        return second;
+    }
+
+    void Finish(const std::vector<uint64_t>& roots, std::ostream* out) {
+        std::string result = kFaslMagic;
+        WriteVarint(symbols_.size(), &result);
+        for (const auto& name : symbols_) {
+            WriteVarint(name.size(), &result);
+            result += name;
+        }
+        WriteVarint(object_count_, &result);
+        result += objects_;
+        WriteVarint(roots.size(), &result);
+        for (auto root : roots) {
+            WriteVarint(root, &result);
+        }
+        out->write(result.data(), result.size());
+    }
+
+private:
+    uint64_t EmitAtom(const Ref<Object>& obj) {
+        if (Is<Number>(obj)) {
+            objects_ += static_cast<char>(FaslTag::NUMBER);
+            WriteVarint(ZigZag(As<Number>(obj)->GetValue()), &objects_);
+        } else if (Is<Boolean>(obj)) {
+            objects_ += static_cast<char>(As<Boolean>(obj)->GetBool() ? FaslTag::TRUE
+                                                                       : FaslTag::FALSE);
+        } else if (Is<Symbol>(obj)) {
+            objects_ += static_cast<char>(FaslTag::SYMBOL);
+            WriteVarint(SymbolIndex(As<Symbol>(obj)->GetName()), &objects_);
+        } else {
+            throw RuntimeError{"Объект нельзя записать в fasl"};
+        }
+        return ++object_count_;
+    }
+
+    uint64_t SymbolIndex(const std::string& name) {
+        auto it = symbol_index_.find(name);
+        if (it != symbol_index_.end()) {
+            return it->second;
+        }
+        symbol_index_[name] = symbols_.size();
+        symbols_.push_back(name);
+        return symbols_.size() - 1;
+    }
+
+    // Ссылка на уже записанный объект хранится как расстояние до него.
+    uint64_t Relative(uint64_t target) const {
+        if (!target) {
+            return 0;
+        }
+        return object_count_ - (target - 1);
+    }
+
+    std::vector<std::string> symbols_;
+    std::unordered_map<std::string, uint64_t> symbol_index_;
+    std::string objects_;
+    uint64_t object_count_ = 0;
+};
+
+}  // namespace
+
+uint64_t ZigZag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void WriteVarint(uint64_t value, std::string* out) {
+    while (value >= 0x80) {
+        *out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    *out += static_cast<char>(value);
+}
+
+uint64_t ReadVarint(const std::string& buffer, size_t* pos) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= buffer.size()) {
+            throw RuntimeError{"Некорректный fasl: неожиданный конец"};
+        }
+        uint8_t byte = buffer[(*pos)++];
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return result;
+        }
+    }
+    throw RuntimeError{"Некорректный fasl: слишком длинное число"};
+}
+
+void WriteFasl(const std::vector<Ref<Object>>& forms, std::ostream* out) {
+    FaslWriter writer;
+    std::vector<uint64_t> roots;
+    for (const auto& form : forms) {
+        roots.push_back(writer.Emit(form));
+    }
+    writer.Finish(roots, out);
+}
+
+std::vector<Ref<Object>> ReadFasl(std::istream* in) {
+    std::string buffer{std::istreambuf_iterator<char>(*in), std::istreambuf_iterator<char>()};
+    if (buffer.compare(0, kFaslMagic.size(), kFaslMagic) != 0) {
+        throw RuntimeError{"Некорректный fasl: неверная сигнатура"};
+    }
+    size_t pos = kFaslMagic.size();
+    auto read_count = [&buffer, &pos] {
+        uint64_t count = ReadVarint(buffer, &pos);
+        if (count > buffer.size() - pos) {
+            throw RuntimeError{"Некорректный fasl: неверный размер секции"};
+        }
+        return count;
+    };
+
+    std::vector<std::string> symbols(read_count());
+    for (auto& name : symbols) {
+        uint64_t size = ReadVarint(buffer, &pos);
+        if (size > buffer.size() - pos) {
+            throw RuntimeError{"Некорректный fasl: неожиданный конец"};
+        }
+        name = buffer.substr(pos, size);
+        pos += size;
+    }
+
+    uint64_t object_count = read_count();
+    std::vector<Ref<Object>> objects;
+    objects.reserve(object_count);
+    auto resolve = [&objects](uint64_t relative) -> Ref<Object> {
+        if (!relative) {
+            return nullptr;
+        }
+        if (relative > objects.size()) {
+            throw RuntimeError{"Некорректный fasl: ссылка вперёд"};
+        }
+        return objects[objects.size() - relative];
+    };
+    for (uint64_t i = 0; i < object_count; ++i) {
+        if (pos >= buffer.size()) {
+            throw RuntimeError{"Некорректный fasl: неожиданный конец"};
+        }
+        auto tag = static_cast<FaslTag>(buffer[pos++]);
+        if (tag == FaslTag::NUMBER) {
+            objects.push_back(MakeRef<Number>(UnZigZag(ReadVarint(buffer, &pos))));
+        } else if (tag == FaslTag::TRUE || tag == FaslTag::FALSE) {
+            objects.push_back(MakeRef<Boolean>(tag == FaslTag::TRUE));
+        } else if (tag == FaslTag::SYMBOL) {
+            uint64_t index = ReadVarint(buffer, &pos);
+            if (index >= symbols.size()) {
+                throw RuntimeError{"Некорректный fasl: неизвестный символ"};
+            }
+            objects.push_back(MakeRef<Symbol>(symbols[index]));
+        } else if (tag == FaslTag::CELL) {
+            auto first = resolve(ReadVarint(buffer, &pos));
+            auto second = resolve(ReadVarint(buffer, &pos));
+            objects.push_back(MakeRef<Cell>(first, second));
+        } else {
+            throw RuntimeError{"Некорректный fasl: неизвестный тег"};
+        }
+    }
+
+    std::vector<Ref<Object>> forms(read_count());
+    for (auto& form : forms) {
+        uint64_t index = ReadVarint(buffer, &pos);
+        if (index > objects.size()) {
+            throw RuntimeError{"Некорректный fasl: неверный корень"};
+        }
+        form = index ? objects[index - 1] : nullptr;
+    }
+    return forms;
+}
+
+void CompileFasl(std::istream* source, std::ostream* out) {
+    Tokenizer tokenizer{source};
+    WriteFasl(ReadAll(&tokenizer), out);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "object.h"
+
+// Бинарный формат разобранного кода (fasl): секция символов и секция объектов,
+// в которой ячейки ссылаются на ранее записанные объекты относительными индексами.
+void WriteFasl(const std::vector<Ref<Object>>& forms, std::ostream* out);
+
+std::vector<Ref<Object>> ReadFasl(std::istream* in);
+
+void CompileFasl(std::istream* source, std::ostream* out);
+
+uint64_t ZigZag(int64_t value);
+
+int64_t UnZigZag(uint64_t value);
+
+void WriteVarint(uint64_t value, std::string* out);
+
+uint64_t ReadVarint(const std::string& buffer, size_t* pos);
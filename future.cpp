@@ -0,0 +1,424 @@
+#include "future.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "async.h"
+#include "budget.h"
+#include "image.h"
+#include "profiler.h"
+
+namespace {
+
+struct WorkerSlot {
+    TaskPool* pool = nullptr;
+    size_t index = 0;
+};
+
+thread_local WorkerSlot current_worker;
+
+std::mutex default_pool_mutex;
+
+// Статическая переменная функции уничтожается раньше созданных до неё таблиц
+// встроенных функций, поэтому при выходе пул дорабатывает, пока таблицы ещё живы.
+std::shared_ptr<TaskPool>& DefaultPool() {
+    BuiltinName(typeid(Object));
+    static std::shared_ptr<TaskPool> pool;
+    return pool;
+}
+
+// Последним прежний пул может отпустить его же исполнитель (future внутри задачи).
+// Свой поток он не дождётся, поэтому пул разрушает отдельный поток.
+std::shared_ptr<TaskPool> MakePool(size_t size) {
+    return std::shared_ptr<TaskPool>(new TaskPool(size), [](TaskPool* pool) {
+        if (current_worker.pool == pool) {
+            std::thread([pool] { delete pool; }).detach();
+        } else {
+            delete pool;
+        }
+    });
+}
+
+// Имена с пробелом нельзя написать в программе, поэтому они не пересекаются с
+// пользовательскими.
+const std::string kExpression = " expression";
+const std::string kFunction = " function";
+const std::string kItems = " items";
+const std::string kResult = " result";
+
+using TaskBody = std::function<Ref<Object>(const Ref<Scope>& root)>;
+
+// Ограничения интерпретатора, запустившего задачу: задача пишет память на его счёт,
+// получает остаток его топлива и его срок.
+struct TaskLimits {
+    HeapAccount::Owner account;
+    int64_t fuel = EvalBudget::kUnlimited;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    static TaskLimits Current() {
+        return {heap_account ? heap_account->Share() : nullptr, eval_budget.Remaining(),
+                eval_budget.Deadline()};
+    }
+};
+
+// Состояние потока на время задачи. Задача, которую выполняет ждущий поток (см. Await),
+// не должна видеть его глобальную область, счёт, бюджет и профилировщик и не может
+// приостановить его EvalMachine.
+class TaskContext {
+public:
+    explicit TaskContext(const TaskLimits& limits)
+        : suspend_(false),
+          globals_(nullptr),
+          heap_(limits.account.get()),
+          fuel_(limits.fuel),
+          budget_(&fuel_, limits.deadline),
+          profiler_(Profiler::Activate(nullptr)) {
+    }
+
+    ~TaskContext() {
+        Profiler::Activate(profiler_);
+    }
+
+    TaskContext(const TaskContext&) = delete;
+    TaskContext& operator=(const TaskContext&) = delete;
+
+    // Топливо, израсходованное с начала задачи.
+    int64_t Spent() const {
+        return fuel_ == EvalBudget::kUnlimited ? 0 : fuel_ - eval_budget.Remaining();
+    }
+
+private:
+    SuspendGuard suspend_;
+    Scope::ActiveGlobals globals_;
+    HeapAccount::Activation heap_;
+    int64_t fuel_;
+    EvalBudget::Activation budget_;
+    Profiler* profiler_;
+};
+
+// Выполняет body на исполнителе пула в окружении, восстановленном из image, с
+// ограничениями вызывающего потока. Тело не должно захватывать объекты вызывающего
+// потока.
+std::shared_ptr<TaskResult> Spawn(TaskPool* pool, std::shared_ptr<const std::string> image,
+                                  TaskBody body) {
+    auto result = std::make_shared<TaskResult>();
+    auto limits = std::make_shared<const TaskLimits>(TaskLimits::Current());
+    pool->Submit([result, image, body, limits] {
+        std::string packed;
+        std::exception_ptr error;
+        int64_t spent = 0;
+        {
+            TaskContext context{*limits};
+            Ref<Scope> root;
+            try {
+                root = UnpackBindings(*image);
+                Ref<Object> value;
+                {
+                    Scope::ActiveGlobals globals{root.get()};
+                    value = body(root);
+                }
+                packed = PackBindings({{kResult, value}}, nullptr);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // Иначе память копии окружения так и осталась бы на счёте интерпретатора.
+            if (root) {
+                ClearBindings(root);
+            }
+            spent = context.Spent();
+        }
+        std::vector<std::shared_ptr<EvalWaker>> sleepers;
+        {
+            std::lock_guard lock{result->mutex};
+            result->image = std::move(packed);
+            result->error = error;
+            result->fuel_spent = spent;
+            result->ready = true;
+            sleepers.swap(result->sleepers);
+        }
+        result->done.notify_all();
+        for (const auto& sleeper : sleepers) {
+            sleeper->Wake();
+        }
+    });
+    return result;
+}
+
+// Пока результата нет, выполняет чужие задачи, чтобы ожидание не простаивало. Когда
+// их нет, вычисление EvalMachine приостанавливается, а не спит. Топливо задачи
+// списывается с бюджета ждущего потока.
+Ref<Object> Await(TaskPool* pool, TaskResult* result) {
+    bool suspendable = CanSuspend();
+    bool suspend = false;
+    {
+        TaskContext detached{TaskLimits{}};
+        while (true) {
+            {
+                std::lock_guard lock{result->mutex};
+                if (result->ready) {
+                    break;
+                }
+            }
+            if (!pool->RunOne()) {
+                std::unique_lock lock{result->mutex};
+                if (suspendable && !result->ready) {
+                    if (auto waker = CurrentWaker()) {
+                        result->sleepers.push_back(std::move(waker));
+                    }
+                    suspend = true;
+                    break;
+                }
+                result->done.wait_for(lock, std::chrono::milliseconds{1},
+                                      [result] { return result->ready; });
+            }
+        }
+    }
+    if (suspend) {
+        eval_budget.ChargeWait();
+        throw EvalSuspend{true, eval_budget.Deadline()};
+    }
+    eval_budget.Spend(result->fuel_spent);
+    if (result->error) {
+        std::rethrow_exception(result->error);
+    }
+    return UnpackBindings(result->image)->GetElementScope(kResult);
+}
+
+// Аргументы Apply вычисляются, поэтому всё, кроме чисел и булевых значений, цитируется.
+Ref<Object> Argument(const Ref<Object>& value) {
+    Ref<Object> argument = value;
+    if (!Is<Number>(value) && !Is<Boolean>(value)) {
+        argument = MakeRef<Cell>(MakeRef<Symbol>("quote"), MakeRef<Cell>(value, nullptr));
+    }
+    return MakeRef<Cell>(argument, nullptr);
+}
+
+std::vector<Ref<Object>> Elements(const Ref<Object>& list) {
+    if (auto elements = As<ListObj>(list)) {
+        return elements->GetElements();
+    }
+    std::vector<Ref<Object>> result;
+    if (auto quoted = As<Cell>(list)) {
+        for (auto cell = As<Cell>(quoted->GetFirst()); cell && cell->GetFirst();
+             cell = As<Cell>(cell->GetSecond())) {
+            result.push_back(cell->GetFirst());
+        }
+        return result;
+    }
+    if (Is<Symbol>(list) && As<Symbol>(list)->GetName() == "()") {
+        return result;
+    }
+    throw RuntimeError{"parallel-map ожидает список"};
+}
+
+}  // namespace
+
+TaskPool::TaskPool(size_t size) {
+    size = std::max<size_t>(size, 1);
+    for (size_t i = 0; i < size; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    if (size > 1) {
+        for (size_t i = 0; i < size; ++i) {
+            threads_.emplace_back([this, i] { Run(i); });
+        }
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard lock{idle_mutex_};
+        stop_ = true;
+    }
+    idle_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t TaskPool::Size() const {
+    return queues_.size();
+}
+
+void TaskPool::Submit(Task task) {
+    size_t index = current_worker.pool == this
+                       ? current_worker.index
+                       : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+        std::lock_guard lock{queues_[index]->mutex};
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    pending_.fetch_add(1);
+    {
+        std::lock_guard lock{idle_mutex_};
+    }
+    idle_.notify_one();
+}
+
+bool TaskPool::RunOne() {
+    size_t index = current_worker.pool == this ? current_worker.index : queues_.size();
+    Task task;
+    if ((index < queues_.size() && Pop(index, &task)) || Steal(index, &task)) {
+        task();
+        return true;
+    }
+    return false;
+}
+
+bool TaskPool::Pop(size_t index, Task* task) {
+    Queue& queue = *queues_[index];
+    std::lock_guard lock{queue.mutex};
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    *task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    pending_.fetch_sub(1);
+    return true;
+}
+
+bool TaskPool::Steal(size_t thief, Task* task) {
+    for (size_t i = 1; i <= queues_.size(); ++i) {
+        Queue& queue = *queues_[(thief + i) % queues_.size()];
+        std::lock_guard lock{queue.mutex};
+        if (!queue.tasks.empty()) {
+            *task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::Run(size_t index) {
+    current_worker = {this, index};
+    while (true) {
+        Task task;
+        if (Pop(index, &task) || Steal(index, &task)) {
+            task();
+            continue;
+        }
+        std::unique_lock lock{idle_mutex_};
+        if (stop_ && pending_.load() == 0) {
+            return;
+        }
+        idle_.wait(lock, [this] { return stop_ || pending_.load() > 0; });
+    }
+}
+
+std::shared_ptr<TaskPool> TaskPool::Default() {
+    std::lock_guard lock{default_pool_mutex};
+    auto& pool = DefaultPool();
+    if (!pool) {
+        pool = MakePool(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    return pool;
+}
+
+void TaskPool::SetDefaultSize(size_t size) {
+    auto pool = MakePool(size);
+    std::lock_guard lock{default_pool_mutex};
+    // Прежний пул разрушается после снятия блокировки, когда его отпустит последний
+    // владелец.
+    DefaultPool().swap(pool);
+}
+
+Future::Future(std::shared_ptr<TaskPool> pool, std::shared_ptr<TaskResult> result)
+    : pool_(std::move(pool)), result_(std::move(result)) {
+}
+
+Ref<Object> Future::Eval(const Ref<Scope>&) {
+    return Ref<Object>(this);
+}
+
+std::string Future::Print() {
+    return "#<future>";
+}
+
+Ref<Object> Future::Touch() {
+    if (result_) {
+        value_ = Await(pool_.get(), result_.get());
+        result_.reset();
+        pool_.reset();
+    }
+    return value_;
+}
+
+Ref<Object> FutureSpecForm::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    if (NumberOfArguments(args) != 1) {
+        throw RuntimeError{"Неверное количество аргументов для future"};
+    }
+    auto expression = As<Cell>(args)->GetFirst();
+    auto pool = TaskPool::Default();
+    auto image =
+        std::make_shared<const std::string>(PackBindings({{kExpression, expression}}, scope));
+    auto result = Spawn(pool.get(), image, [](const Ref<Scope>& root) {
+        return root->GetElementScope(kExpression)->Eval(root);
+    });
+    return MakeRef<Future>(std::move(pool), std::move(result));
+}
+
+Ref<Object> Touch::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto args_list = EvalArguments(args, scope);
+    if (args_list.size() != 1) {
+        throw RuntimeError{"Неверное количество аргументов для touch"};
+    }
+    if (auto future = As<Future>(args_list[0])) {
+        return future->Touch();
+    }
+    return args_list[0];
+}
+
+Ref<Object> ParallelMap::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto args_list = EvalArguments(args, scope);
+    if (args_list.size() != 2) {
+        throw RuntimeError{"Неверное количество аргументов для parallel-map"};
+    }
+    Ref<Object> function = args_list[0];
+    std::vector<Ref<Object>> items = Elements(args_list[1]);
+    std::vector<Ref<Object>> results;
+    if (items.empty()) {
+        return MakeRef<ListObj>(results);
+    }
+
+    // Окружение снимается один раз и при любом размере пула, чтобы функция видела
+    // одну и ту же копию; куски списка раздаются исполнителям, по несколько на каждого,
+    // чтобы неравные по времени куски выровнялись кражей задач.
+    auto pool = TaskPool::Default();
+    size_t chunks = std::min(items.size(), 4 * pool->Size());
+    auto image = std::make_shared<const std::string>(PackBindings(
+        {{kFunction, function}, {kItems, MakeRef<ListObj>(items)}}, scope));
+    std::vector<std::shared_ptr<TaskResult>> parts;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        size_t begin = items.size() * chunk / chunks;
+        size_t end = items.size() * (chunk + 1) / chunks;
+        parts.push_back(Spawn(pool.get(), image, [begin, end](const Ref<Scope>& root) {
+            auto function = root->GetElementScope(kFunction);
+            auto items = As<ListObj>(root->GetElementScope(kItems));
+            std::vector<Ref<Object>> results;
+            for (size_t i = begin; i < end; ++i) {
+                results.push_back(function->Apply(Argument(items->GetElements()[i]), root));
+            }
+            return Ref<Object>(MakeRef<ListObj>(results));
+        }));
+    }
+    // Ошибка пробрасывается после того, как закончатся все куски: задачи не должны
+    // переживать вызов.
+    std::exception_ptr error;
+    for (const auto& part : parts) {
+        try {
+            auto chunk = As<ListObj>(Await(pool.get(), part.get()));
+            results.insert(results.end(), chunk->GetElements().begin(),
+                           chunk->GetElements().end());
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return MakeRef<ListObj>(results);
+}
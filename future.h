@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "object.h"
+
+class EvalWaker;
+
+// Пул потоков с собственной очередью у каждого исполнителя: свои задачи исполнитель
+// берёт с конца очереди, а когда она пуста, крадёт чужие с начала. Поток, который
+// ждёт результата, тоже выполняет задачи (RunOne), поэтому вложенные future не
+// занимают исполнителей впустую.
+class TaskPool {
+public:
+    using Task = std::function<void()>;
+
+    // Пул размера 1 не создаёт потоков: задачи выполняет поток, который ждёт их
+    // результата (см. RunOne).
+    explicit TaskPool(size_t size);
+
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    size_t Size() const;
+
+    void Submit(Task task);
+
+    // Выполняет одну задачу из любой очереди; false, если задач нет.
+    bool RunOne();
+
+    // Общий пул встроенных функций, по умолчанию по потоку на ядро.
+    static std::shared_ptr<TaskPool> Default();
+
+    // Заменяет общий пул новым. Прежний живёт, пока его держат вызовы и future,
+    // и дорабатывает их задачи.
+    static void SetDefaultSize(size_t size);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool Pop(size_t index, Task* task);
+
+    bool Steal(size_t thief, Task* task);
+
+    void Run(size_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_queue_ = 0;
+    std::atomic<size_t> pending_ = 0;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_;
+    bool stop_ = false;
+};
+
+// Результат задачи: снимок значения (см. PackBindings) или исключение и топливо,
+// которое задача израсходовала.
+struct TaskResult {
+    std::mutex mutex;
+    std::condition_variable done;
+    bool ready = false;
+    std::string image;
+    std::exception_ptr error;
+    int64_t fuel_spent = 0;
+    // Приостановленные на touch задачи EvalScheduler; будятся по готовности.
+    std::vector<std::shared_ptr<EvalWaker>> sleepers;
+};
+
+// Значение (future expr). Выражение вычисляется на исполнителе пула в копии
+// окружения, поэтому set! внутри future не меняет переменные вызывающего, а ошибка
+// выражения пробрасывается из touch. Так же и у пула размера 1, только вычисляет
+// выражение поток, вызвавший touch.
+class Future : public Object {
+public:
+    Future(std::shared_ptr<TaskPool> pool, std::shared_ptr<TaskResult> result);
+
+    Ref<Object> Eval(const Ref<Scope>&) override;
+
+    std::string Print() override;
+
+    // Дожидается результата; исключение задачи пробрасывается вызывающему. Внутри
+    // EvalMachine вместо ожидания вычисление приостанавливается до готовности.
+    Ref<Object> Touch();
+
+private:
+    std::shared_ptr<TaskPool> pool_;
+    std::shared_ptr<TaskResult> result_;
+    Ref<Object> value_;
+};
+
+class FutureSpecForm : public Object {
+public:
+    FutureSpecForm() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+class Touch : public Object {
+public:
+    Touch() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+class ParallelMap : public Object {
+public:
+    ParallelMap() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
@@ -0,0 +1,50 @@
+#include "heap.h"
+
+#include <algorithm>
+
+#include "error.h"
+
+void HeapAccount::Disown::operator()(HeapAccount* account) const {
+    account->owners_.fetch_sub(kOwnerBias, std::memory_order_relaxed);
+    account->Release(kOwnerBias);
+}
+
+HeapAccount::Owner HeapAccount::Create() {
+    return Owner{new HeapAccount};
+}
+
+HeapAccount::Owner HeapAccount::Share() {
+    balance_.fetch_add(kOwnerBias, std::memory_order_relaxed);
+    owners_.fetch_add(kOwnerBias, std::memory_order_relaxed);
+    return Owner{this};
+}
+
+void HeapAccount::SetLimits(size_t soft, size_t hard) {
+    hard_limit_.store(hard, std::memory_order_relaxed);
+    soft_limit_.store(std::min(soft, hard), std::memory_order_relaxed);
+    soft_reported_.store(Used() > std::min(soft, hard), std::memory_order_relaxed);
+}
+
+void HeapAccount::SetSoftLimitHandler(std::function<void(size_t used)> handler) {
+    soft_limit_handler_ = std::move(handler);
+}
+
+void HeapAccount::OnLimit(size_t bytes, size_t used) {
+    size_t hard_limit = hard_limit_.load(std::memory_order_relaxed);
+    if (used > hard_limit) {
+        balance_.fetch_sub(bytes, std::memory_order_relaxed);
+        throw HeapLimitExceeded{"Превышен предел памяти интерпретатора: " +
+                                std::to_string(hard_limit) + " байт"};
+    }
+    if (!soft_reported_.exchange(true, std::memory_order_relaxed) && soft_limit_handler_) {
+        soft_limit_handler_(used);
+    }
+}
+
+HeapAccount::Activation::Activation(HeapAccount* account) : previous_(heap_account) {
+    heap_account = account;
+}
+
+HeapAccount::Activation::~Activation() {
+    heap_account = previous_;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Счёт памяти интерпретатора. Пока счёт активен в потоке (см. Activation), каждый
+// объект, созданный через MakeRef, записывается на него и запоминает его; новые
+// привязки области пишутся на счёт самой области. При удалении объекта байты
+// возвращаются тому счёту, на который он записан, в каком бы потоке и при каком бы
+// активном счёте это ни произошло. Мягкий предел вызывает обработчик, жёсткий
+// прерывает выделение, которое его нарушило, исключением HeapLimitExceeded.
+class HeapAccount {
+public:
+    static constexpr size_t kNoLimit = SIZE_MAX;
+
+    struct Disown {
+        void operator()(HeapAccount* account) const;
+    };
+
+    // Счёт живёт, пока жив владелец или на нём записан хотя бы один объект: значения,
+    // отданные наружу, и объекты, общие с клонами, могут пережить интерпретатор.
+    using Owner = std::unique_ptr<HeapAccount, Disown>;
+
+    static Owner Create();
+
+    // Ещё один владелец того же счёта, например у задачи пула, которая может пережить
+    // запустивший её интерпретатор.
+    Owner Share();
+
+    HeapAccount(const HeapAccount&) = delete;
+    HeapAccount& operator=(const HeapAccount&) = delete;
+
+    void Charge(size_t bytes) {
+        size_t used = UsedOf(balance_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        if (used > soft_limit_.load(std::memory_order_relaxed)) {
+            OnLimit(bytes, used);
+        }
+    }
+
+    void Release(size_t bytes) {
+        size_t balance = balance_.fetch_sub(bytes, std::memory_order_acq_rel) - bytes;
+        if (balance == 0) {
+            delete this;
+            return;
+        }
+        if (UsedOf(balance) <= soft_limit_.load(std::memory_order_relaxed)) {
+            soft_reported_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Used() const {
+        return UsedOf(balance_.load(std::memory_order_relaxed));
+    }
+
+    // hard не меньше soft; kNoLimit снимает предел.
+    void SetLimits(size_t soft, size_t hard);
+
+    size_t SoftLimit() const {
+        return soft_limit_.load(std::memory_order_relaxed);
+    }
+
+    size_t HardLimit() const {
+        return hard_limit_.load(std::memory_order_relaxed);
+    }
+
+    // Вызывается один раз при переходе через мягкий предел, снова — только после того,
+    // как занятая память опустится ниже него; в том потоке, где предел перейдён.
+    // Обработчик не должен вычислять код Scheme; он может, например, освободить кэши
+    // приложения или отметить тенанта. Задаётся до начала вычислений.
+    void SetSoftLimitHandler(std::function<void(size_t used)> handler);
+
+    // Пока жив объект, выделения потока пишутся на account.
+    class Activation {
+    public:
+        explicit Activation(HeapAccount* account);
+
+        ~Activation();
+
+        Activation(const Activation&) = delete;
+        Activation& operator=(const Activation&) = delete;
+
+    private:
+        HeapAccount* previous_;
+    };
+
+private:
+    // Каждый владелец держит в балансе один лишний байт, поэтому баланс обнуляется,
+    // только когда ушли и владельцы, и все записанные объекты.
+    static constexpr size_t kOwnerBias = 1;
+
+    HeapAccount() = default;
+
+    // Пока владелец добавляется или уходит, баланс и owners_ могут на миг разойтись
+    // на его байт; занятая память при этом не опускается ниже нуля.
+    size_t UsedOf(size_t balance) const {
+        size_t owners = owners_.load(std::memory_order_relaxed);
+        return balance > owners ? balance - owners : 0;
+    }
+
+    void OnLimit(size_t bytes, size_t used);
+
+    std::atomic<size_t> balance_ = kOwnerBias;
+    std::atomic<size_t> owners_ = kOwnerBias;
+    std::atomic<size_t> soft_limit_ = kNoLimit;
+    std::atomic<size_t> hard_limit_ = kNoLimit;
+    std::atomic<bool> soft_reported_ = false;
+    std::function<void(size_t)> soft_limit_handler_;
+};
+
+inline thread_local HeapAccount* heap_account = nullptr;
+
+// Память строки вне самого объекта; короткие строки живут внутри него.
+inline size_t StringHeapBytes(const std::string& string) {
+    return string.capacity() > std::string{}.capacity() ? string.capacity() + 1 : 0;
+}
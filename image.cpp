@@ -0,0 +1,724 @@
+#include "image.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "fasl.h"
+
+namespace {
+
+const std::string kImageMagic = "SIMG\x01";
+const std::string kJournalMagic = "SJNL\x01";
+
+enum class ImageTag : uint8_t {
+    NUMBER,
+    TRUE,
+    FALSE,
+    SYMBOL,
+    CELL,
+    PAIR,
+    LIST,
+    BUILTIN,
+    LAMBDA,
+    SCOPE
+};
+
+// Привязка, которую образ журнала записывает в известную читателю область.
+struct JournalBinding {
+    uint64_t scope;
+    std::string name;
+    Ref<Object> value;
+};
+
+class ImageWriter {
+public:
+    // С pack записывается снимок PackBindings: привязки к объектам, которые нельзя
+    // записать (например, future), пропускаются, а не приводят к ошибке, кроме привязок
+    // самой global; из её предков берутся только привязки имён, встречающихся в
+    // записанных символах (в выражениях, телах лямбд, цитатах). Так остаются свободные
+    // переменные и, с запасом, одноимённые им связанные.
+    explicit ImageWriter(const Ref<Scope>& global, bool pack = false) : pack_(pack) {
+        if (pack_) {
+            for (auto scope = global->GetParentScope(); scope; scope = scope->GetParentScope()) {
+                ancestors_.push_back(scope);
+            }
+        }
+        Visit(global);
+        // Обход в ширину: nodes_ растёт по ходу, поэтому узел копируется.
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            VisitChildren(ImageNode{nodes_[i]});
+        }
+    }
+
+    // Образ журнала: объекты из known уже есть у читателя под своими номерами, а новые,
+    // достижимые из roots, нумеруются с first_id.
+    ImageWriter(const std::unordered_map<const void*, uint64_t>* known, uint64_t first_id,
+                const std::vector<Ref<Object>>& roots)
+        : pack_(false), known_(known), first_id_(first_id) {
+        for (const auto& root : roots) {
+            Visit(root);
+        }
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            VisitChildren(ImageNode{nodes_[i]});
+        }
+    }
+
+    void Write(std::ostream* out) {
+        std::string records = Records();
+        std::string result = kImageMagic;
+        WriteSymbols(&result);
+        WriteVarint(nodes_.size(), &result);
+        result += records;
+        out->write(result.data(), result.size());
+    }
+
+    // После новых объектов идут привязки, записанные в известные области, и новые
+    // значения известных пар.
+    std::string WriteJournal(const std::vector<JournalBinding>& bindings,
+                             const std::vector<Ref<Pair>>& pairs) {
+        std::string records = Records();
+        for (const auto& binding : bindings) {
+            SymbolIndex(binding.name);
+        }
+        std::string result = kJournalMagic;
+        WriteSymbols(&result);
+        WriteVarint(first_id_, &result);
+        WriteVarint(nodes_.size(), &result);
+        result += records;
+        WriteVarint(bindings.size(), &result);
+        for (const auto& binding : bindings) {
+            WriteVarint(binding.scope, &result);
+            WriteVarint(SymbolIndex(binding.name), &result);
+            WriteVarint(Id(binding.value.get()), &result);
+        }
+        WriteVarint(pairs.size(), &result);
+        for (const auto& pair : pairs) {
+            WriteVarint(Id(pair.get()), &result);
+            WriteVarint(ZigZag(pair->GetElementOne()), &result);
+            WriteVarint(ZigZag(pair->GetElementTwo()), &result);
+        }
+        return result;
+    }
+
+    const std::vector<ImageNode>& Nodes() const {
+        return nodes_;
+    }
+
+    void ClearScopes() {
+        for (const auto& node : nodes_) {
+            if (node.scope) {
+                node.scope->Discard();
+            }
+        }
+    }
+
+private:
+    std::string Records() {
+        std::string records;
+        for (const auto& node : nodes_) {
+            if (node.scope) {
+                EmitScope(node.scope, &records);
+            } else {
+                EmitObject(node.object, &records);
+            }
+        }
+        return records;
+    }
+
+    void WriteSymbols(std::string* out) const {
+        WriteVarint(symbols_.size(), out);
+        for (const auto& name : symbols_) {
+            WriteVarint(name.size(), out);
+            *out += name;
+        }
+    }
+
+    bool IsKnown(const void* ptr) const {
+        return known_ && known_->count(ptr);
+    }
+
+    // Ссылки в образе абсолютные: номер узла + 1, ноль означает пустой указатель.
+    uint64_t Id(const void* ptr) const {
+        if (!ptr) {
+            return 0;
+        }
+        if (known_) {
+            if (auto it = known_->find(ptr); it != known_->end()) {
+                return it->second;
+            }
+        }
+        return ids_.at(ptr);
+    }
+
+    template <class T>
+    void Visit(const Ref<T>& ptr) {
+        if (!ptr || ids_.count(ptr.get()) || IsKnown(ptr.get())) {
+            return;
+        }
+        ids_[ptr.get()] = first_id_ + nodes_.size();
+        if constexpr (std::is_same_v<T, Scope>) {
+            nodes_.push_back({nullptr, ptr});
+        } else {
+            nodes_.push_back({ptr, nullptr});
+        }
+    }
+
+    void VisitChildren(const ImageNode& node) {
+        if (node.scope) {
+            Visit(node.scope->GetParentScope());
+            if (IsAncestor(node.scope)) {
+                // Привязки предка обходятся, когда встречается их имя (см. Require).
+                return;
+            }
+            for (const auto& [name, value] : node.scope->GetElements()) {
+                if (IsStored(node.scope, name, value)) {
+                    Visit(value);
+                }
+            }
+            return;
+        }
+        const auto& obj = node.object;
+        if (Is<Symbol>(obj)) {
+            Require(As<Symbol>(obj)->GetName());
+        } else if (Is<Cell>(obj)) {
+            Visit(As<Cell>(obj)->GetFirst());
+            Visit(As<Cell>(obj)->GetSecond());
+        } else if (Is<ListObj>(obj)) {
+            for (const auto& element : As<ListObj>(obj)->GetElements()) {
+                Visit(element);
+            }
+        } else if (Is<Lambda>(obj)) {
+            Visit(As<Lambda>(obj)->GetScope());
+            for (const auto& expression : As<Lambda>(obj)->GetExpressions()) {
+                Visit(expression);
+            }
+        }
+    }
+
+    // Встроенные функции под своими именами есть в каждой области после AddBuiltins.
+    static bool IsImplicitBuiltin(const std::string& name, const Ref<Object>& value) {
+        return BuiltinName(value) == name;
+    }
+
+    static bool IsWritable(const Ref<Object>& value) {
+        return !value || !BuiltinName(value).empty() || Is<Number>(value) ||
+               Is<Boolean>(value) || Is<Symbol>(value) || Is<Cell>(value) || Is<Pair>(value) ||
+               Is<ListObj>(value) || Is<Lambda>(value);
+    }
+
+    // Имя встретилось в записываемом значении: его привязки у предков global
+    // записываются вместе со всем, что из них достижимо.
+    void Require(const std::string& name) {
+        if (!pack_ || !names_.insert(name).second) {
+            return;
+        }
+        for (const auto& scope : ancestors_) {
+            const auto& elements = scope->GetElements();
+            auto it = elements.find(name);
+            if (it != elements.end() && IsStored(scope, name, it->second)) {
+                Visit(it->second);
+            }
+        }
+    }
+
+    bool IsAncestor(const Ref<Scope>& scope) const {
+        return std::find(ancestors_.begin(), ancestors_.end(), scope) != ancestors_.end();
+    }
+
+    bool IsStored(const Ref<Scope>& scope, const std::string& name,
+                  const Ref<Object>& value) const {
+        if (IsImplicitBuiltin(name, value)) {
+            return false;
+        }
+        if (!pack_ || scope.get() == nodes_[0].scope.get()) {
+            return true;
+        }
+        return IsWritable(value) && (!IsAncestor(scope) || names_.count(name));
+    }
+
+    void EmitScope(const Ref<Scope>& scope, std::string* out) {
+        *out += static_cast<char>(ImageTag::SCOPE);
+        WriteVarint(Id(scope->GetParentScope().get()), out);
+        std::vector<std::pair<std::string, Ref<Object>>> entries;
+        for (const auto& [name, value] : scope->GetElements()) {
+            if (IsStored(scope, name, value)) {
+                entries.emplace_back(name, value);
+            }
+        }
+        WriteVarint(entries.size(), out);
+        for (const auto& [name, value] : entries) {
+            WriteVarint(SymbolIndex(name), out);
+            WriteVarint(Id(value.get()), out);
+        }
+    }
+
+    void EmitObject(const Ref<Object>& obj, std::string* out) {
+        if (auto name = BuiltinName(obj); !name.empty()) {
+            *out += static_cast<char>(ImageTag::BUILTIN);
+            WriteVarint(SymbolIndex(name), out);
+        } else if (Is<Number>(obj)) {
+            *out += static_cast<char>(ImageTag::NUMBER);
+            WriteVarint(ZigZag(As<Number>(obj)->GetValue()), out);
+        } else if (Is<Boolean>(obj)) {
+            *out += static_cast<char>(As<Boolean>(obj)->GetBool() ? ImageTag::TRUE
+                                                                   : ImageTag::FALSE);
+        } else if (Is<Symbol>(obj)) {
+            *out += static_cast<char>(ImageTag::SYMBOL);
+            WriteVarint(SymbolIndex(As<Symbol>(obj)->GetName()), out);
+        } else if (Is<Cell>(obj)) {
+            *out += static_cast<char>(ImageTag::CELL);
+            WriteVarint(Id(As<Cell>(obj)->GetFirst().get()), out);
+            WriteVarint(Id(As<Cell>(obj)->GetSecond().get()), out);
+        } else if (Is<Pair>(obj)) {
+            *out += static_cast<char>(ImageTag::PAIR);
+            WriteVarint(ZigZag(As<Pair>(obj)->GetElementOne()), out);
+            WriteVarint(ZigZag(As<Pair>(obj)->GetElementTwo()), out);
+        } else if (Is<ListObj>(obj)) {
+            *out += static_cast<char>(ImageTag::LIST);
+            const auto& elements = As<ListObj>(obj)->GetElements();
+            WriteVarint(elements.size(), out);
+            for (const auto& element : elements) {
+                WriteVarint(Id(element.get()), out);
+            }
+        } else if (Is<Lambda>(obj)) {
+            auto lambda = As<Lambda>(obj);
+            *out += static_cast<char>(ImageTag::LAMBDA);
+            WriteVarint(SymbolIndex(lambda->GetFlag()), out);
+            WriteVarint(lambda->GetArguments().size(), out);
+            for (const auto& argument : lambda->GetArguments()) {
+                WriteVarint(SymbolIndex(argument), out);
+            }
+            WriteVarint(Id(lambda->GetScope().get()), out);
+            WriteVarint(lambda->GetExpressions().size(), out);
+            for (const auto& expression : lambda->GetExpressions()) {
+                WriteVarint(Id(expression.get()), out);
+            }
+        } else {
+            throw RuntimeError{"Объект нельзя записать в образ"};
+        }
+    }
+
+    uint64_t SymbolIndex(const std::string& name) {
+        auto it = symbol_index_.find(name);
+        if (it != symbol_index_.end()) {
+            return it->second;
+        }
+        symbol_index_[name] = symbols_.size();
+        symbols_.push_back(name);
+        return symbols_.size() - 1;
+    }
+
+    bool pack_;
+    const std::unordered_map<const void*, uint64_t>* known_ = nullptr;
+    uint64_t first_id_ = 1;
+    std::vector<Ref<Scope>> ancestors_;
+    std::unordered_set<std::string> names_;
+    std::vector<ImageNode> nodes_;
+    std::unordered_map<const void*, uint64_t> ids_;
+    std::vector<std::string> symbols_;
+    std::unordered_map<std::string, uint64_t> symbol_index_;
+};
+
+struct ImageRecord {
+    ImageTag tag;
+    std::vector<uint64_t> fields;
+};
+
+class ImageReader {
+public:
+    explicit ImageReader(std::string buffer, bool journal = false)
+        : buffer_(std::move(buffer)) {
+        const std::string& magic = journal ? kJournalMagic : kImageMagic;
+        if (buffer_.compare(0, magic.size(), magic) != 0) {
+            throw RuntimeError{"Некорректный образ: неверная сигнатура"};
+        }
+        pos_ = magic.size();
+        symbols_.resize(ReadCount());
+        for (auto& name : symbols_) {
+            uint64_t size = ReadCount();
+            name = buffer_.substr(pos_, size);
+            pos_ += size;
+        }
+        if (journal) {
+            first_id_ = ReadVarint(buffer_, &pos_);
+        }
+        records_.resize(ReadCount());
+        for (auto& record : records_) {
+            ReadRecord(&record);
+        }
+        if (journal) {
+            ReadFields(3 * ReadCount(), &bindings_);
+            ReadFields(3 * ReadCount(), &pairs_);
+        }
+    }
+
+    void Load(const Ref<Scope>& global) {
+        if (records_.empty() || records_[0].tag != ImageTag::SCOPE) {
+            throw RuntimeError{"Некорректный образ: нет глобальной области"};
+        }
+        nodes_.resize(records_.size());
+        for (size_t i = 0; i < records_.size(); ++i) {
+            if (records_[i].tag == ImageTag::SCOPE) {
+                nodes_[i].scope = i ? MakeRef<Scope>() : global;
+                if (i) {
+                    AddBuiltins(nodes_[i].scope);
+                }
+            }
+        }
+        for (size_t i = 0; i < records_.size(); ++i) {
+            if (records_[i].tag != ImageTag::SCOPE) {
+                nodes_[i].object = MakeShell(records_[i]);
+            }
+        }
+        for (size_t i = 0; i < records_.size(); ++i) {
+            Link(records_[i], nodes_[i]);
+        }
+        LinkParents(0);
+    }
+
+    // Дописывает новые объекты образа журнала в table, где уже лежат объекты прошлых
+    // образов, и применяет изменения привязок и пар.
+    void LoadJournal(std::vector<ImageNode>* table) {
+        if (first_id_ != table->size() + 1) {
+            throw RuntimeError{"Некорректный образ: пропущен образ журнала"};
+        }
+        size_t base = table->size();
+        nodes_ = std::move(*table);
+        try {
+            nodes_.resize(base + records_.size());
+            for (size_t i = 0; i < records_.size(); ++i) {
+                if (records_[i].tag == ImageTag::SCOPE) {
+                    nodes_[base + i].scope = MakeRef<Scope>();
+                    AddBuiltins(nodes_[base + i].scope);
+                }
+            }
+            for (size_t i = 0; i < records_.size(); ++i) {
+                if (records_[i].tag != ImageTag::SCOPE) {
+                    nodes_[base + i].object = MakeShell(records_[i]);
+                }
+            }
+            for (size_t i = 0; i < records_.size(); ++i) {
+                Link(records_[i], nodes_[base + i]);
+            }
+            LinkParents(base);
+            const auto& bindings = bindings_.fields;
+            for (size_t i = 0; i < bindings.size(); i += 3) {
+                auto scope = ScopeAt(bindings[i]);
+                if (!scope) {
+                    throw RuntimeError{"Некорректный образ: неверная ссылка на область"};
+                }
+                Bind(scope, SymbolAt(bindings[i + 1]), ObjectAt(bindings[i + 2]));
+            }
+            const auto& pairs = pairs_.fields;
+            for (size_t i = 0; i < pairs.size(); i += 3) {
+                auto pair = As<Pair>(ObjectAt(pairs[i]));
+                if (!pair) {
+                    throw RuntimeError{"Некорректный образ: неверная ссылка на пару"};
+                }
+                pair->SetElementOne(UnZigZag(pairs[i + 1]));
+                pair->SetElementTwo(UnZigZag(pairs[i + 2]));
+            }
+        } catch (...) {
+            nodes_.resize(base);
+            *table = std::move(nodes_);
+            throw;
+        }
+        *table = std::move(nodes_);
+    }
+
+private:
+    uint64_t ReadCount() {
+        uint64_t count = ReadVarint(buffer_, &pos_);
+        if (count > buffer_.size() - pos_) {
+            throw RuntimeError{"Некорректный образ: неверный размер"};
+        }
+        return count;
+    }
+
+    void ReadFields(size_t count, ImageRecord* record) {
+        for (size_t i = 0; i < count; ++i) {
+            record->fields.push_back(ReadVarint(buffer_, &pos_));
+        }
+    }
+
+    void ReadList(ImageRecord* record) {
+        uint64_t count = ReadCount();
+        record->fields.push_back(count);
+        ReadFields(count, record);
+    }
+
+    void ReadRecord(ImageRecord* record) {
+        if (pos_ >= buffer_.size()) {
+            throw RuntimeError{"Некорректный образ: неожиданный конец"};
+        }
+        record->tag = static_cast<ImageTag>(buffer_[pos_++]);
+        switch (record->tag) {
+            case ImageTag::TRUE:
+            case ImageTag::FALSE:
+                break;
+            case ImageTag::NUMBER:
+            case ImageTag::SYMBOL:
+            case ImageTag::BUILTIN:
+                ReadFields(1, record);
+                break;
+            case ImageTag::CELL:
+            case ImageTag::PAIR:
+                ReadFields(2, record);
+                break;
+            case ImageTag::LIST:
+                ReadList(record);
+                break;
+            case ImageTag::LAMBDA:
+                ReadFields(1, record);
+                ReadList(record);
+                ReadFields(1, record);
+                ReadList(record);
+                break;
+            case ImageTag::SCOPE: {
+                ReadFields(1, record);
+                uint64_t count = ReadCount();
+                record->fields.push_back(count);
+                ReadFields(2 * count, record);
+                break;
+            }
+            default:
+                throw RuntimeError{"Некорректный образ: неизвестный тег"};
+        }
+    }
+
+    const std::string& SymbolAt(uint64_t index) const {
+        if (index >= symbols_.size()) {
+            throw RuntimeError{"Некорректный образ: неизвестный символ"};
+        }
+        return symbols_[index];
+    }
+
+    Ref<Object> ObjectAt(uint64_t ref) const {
+        if (!ref) {
+            return nullptr;
+        }
+        if (ref > nodes_.size() || !nodes_[ref - 1].object) {
+            throw RuntimeError{"Некорректный образ: неверная ссылка на объект"};
+        }
+        return nodes_[ref - 1].object;
+    }
+
+    Ref<Scope> ScopeAt(uint64_t ref) const {
+        if (!ref) {
+            return nullptr;
+        }
+        if (ref > nodes_.size() || !nodes_[ref - 1].scope) {
+            throw RuntimeError{"Некорректный образ: неверная ссылка на область"};
+        }
+        return nodes_[ref - 1].scope;
+    }
+
+    Ref<Object> MakeShell(const ImageRecord& record) const {
+        const auto& fields = record.fields;
+        switch (record.tag) {
+            case ImageTag::NUMBER:
+                return MakeRef<Number>(UnZigZag(fields[0]));
+            case ImageTag::TRUE:
+            case ImageTag::FALSE:
+                return MakeRef<Boolean>(record.tag == ImageTag::TRUE);
+            case ImageTag::SYMBOL:
+                return MakeRef<Symbol>(SymbolAt(fields[0]));
+            case ImageTag::BUILTIN: {
+                auto builtin = MakeBuiltin(SymbolAt(fields[0]));
+                if (!builtin) {
+                    throw RuntimeError{"Некорректный образ: неизвестная встроенная функция"};
+                }
+                return builtin;
+            }
+            case ImageTag::CELL:
+                return MakeRef<Cell>();
+            case ImageTag::PAIR:
+                return MakeRef<Pair>(UnZigZag(fields[0]), UnZigZag(fields[1]));
+            case ImageTag::LIST:
+                return MakeRef<ListObj>(std::vector<Ref<Object>>{});
+            case ImageTag::LAMBDA: {
+                uint64_t scope_ref = fields[2 + fields[1]];
+                auto scope = ScopeAt(scope_ref);
+                if (!scope) {
+                    throw RuntimeError{"Некорректный образ: лямбда без области"};
+                }
+                return MakeRef<Lambda>(scope);
+            }
+            default:
+                throw RuntimeError{"Некорректный образ: неизвестный тег"};
+        }
+    }
+
+    void Link(const ImageRecord& record, const ImageNode& node) const {
+        const auto& fields = record.fields;
+        if (record.tag == ImageTag::SCOPE) {
+            for (uint64_t i = 0; i < fields[1]; ++i) {
+                Bind(node.scope, SymbolAt(fields[2 + 2 * i]), ObjectAt(fields[3 + 2 * i]));
+            }
+        } else if (record.tag == ImageTag::CELL) {
+            As<Cell>(node.object)->SetFirst(ObjectAt(fields[0]));
+            As<Cell>(node.object)->SetSecond(ObjectAt(fields[1]));
+        } else if (record.tag == ImageTag::LIST) {
+            std::vector<Ref<Object>> elements;
+            for (uint64_t i = 0; i < fields[0]; ++i) {
+                elements.push_back(ObjectAt(fields[1 + i]));
+            }
+            As<ListObj>(node.object)->SetElements(elements);
+        } else if (record.tag == ImageTag::LAMBDA) {
+            std::vector<std::string> arguments;
+            for (uint64_t i = 0; i < fields[1]; ++i) {
+                arguments.push_back(SymbolAt(fields[2 + i]));
+            }
+            size_t expressions_pos = 3 + fields[1];
+            std::vector<Ref<Object>> expressions;
+            for (uint64_t i = 0; i < fields[expressions_pos]; ++i) {
+                expressions.push_back(ObjectAt(fields[expressions_pos + 1 + i]));
+            }
+            As<Lambda>(node.object)->Restore(arguments, expressions, SymbolAt(fields[0]));
+        }
+    }
+
+    // Области образа связываются с родителями после привязок и родитель раньше потомков.
+    // Тогда ни одна новая область не получает родителя или привязку, уже имея потомков,
+    // и загрузка не сбрасывает кэши символов всех потоков (см. Scope::Epoch).
+    void LinkParents(size_t base) const {
+        std::vector<bool> visited(records_.size());
+        std::vector<size_t> chain;
+        for (size_t i = 0; i < records_.size(); ++i) {
+            for (size_t j = i; j < records_.size() && !visited[j] &&
+                               records_[j].tag == ImageTag::SCOPE;) {
+                visited[j] = true;
+                chain.push_back(j);
+                uint64_t parent = records_[j].fields[0];
+                j = parent > base ? parent - 1 - base : records_.size();
+            }
+            for (; !chain.empty(); chain.pop_back()) {
+                nodes_[base + chain.back()].scope->SetParentScope(
+                    ScopeAt(records_[chain.back()].fields[0]));
+            }
+        }
+    }
+
+    static void Bind(const Ref<Scope>& scope, const std::string& name, const Ref<Object>& value) {
+        if (auto lambda = As<Lambda>(value); lambda && lambda->GetName().empty()) {
+            lambda->SetName(name);
+        }
+        scope->SetElementScope(name, value);
+    }
+
+    std::string buffer_;
+    size_t pos_ = 0;
+    std::vector<std::string> symbols_;
+    std::vector<ImageRecord> records_;
+    uint64_t first_id_ = 1;
+    // Тройки (область, имя, значение) и (пара, первый, второй) образа журнала.
+    ImageRecord bindings_;
+    ImageRecord pairs_;
+    std::vector<ImageNode> nodes_;
+};
+
+}  // namespace
+
+void WriteImage(const Ref<Scope>& global, std::ostream* out) {
+    ImageWriter{global}.Write(out);
+}
+
+void ReadImage(std::istream* in, const Ref<Scope>& global) {
+    std::string buffer{std::istreambuf_iterator<char>(*in), std::istreambuf_iterator<char>()};
+    ImageReader{std::move(buffer)}.Load(global);
+}
+
+ImageJournalWriter::ImageJournalWriter(const Ref<Scope>& global) : global_(global) {
+    Reset();
+}
+
+std::string ImageJournalWriter::Write() {
+    std::vector<JournalBinding> bindings;
+    if (complete_) {
+        for (const auto& [name, value] : global_->GetElements()) {
+            if (BuiltinName(value) != name) {
+                bindings.push_back({1, name, value});
+            }
+        }
+    } else {
+        for (const auto& [id, name] : bindings_) {
+            const auto& elements = nodes_[id - 1].scope->GetElements();
+            if (auto it = elements.find(name); it != elements.end()) {
+                bindings.push_back({id, name, it->second});
+            }
+        }
+    }
+    std::vector<Ref<Pair>> pairs;
+    for (uint64_t id : objects_) {
+        pairs.push_back(As<Pair>(nodes_[id - 1].object));
+    }
+    std::vector<Ref<Object>> roots;
+    for (const auto& binding : bindings) {
+        roots.push_back(binding.value);
+    }
+    ImageWriter writer{&ids_, nodes_.size() + 1, roots};
+    auto image = writer.WriteJournal(bindings, pairs);
+    for (const auto& node : writer.Nodes()) {
+        const void* ptr = node.scope ? static_cast<const void*>(node.scope.get())
+                                     : static_cast<const void*>(node.object.get());
+        ids_.emplace(ptr, nodes_.size() + 1);
+        nodes_.push_back(node);
+    }
+    bindings_.clear();
+    objects_.clear();
+    complete_ = false;
+    return image;
+}
+
+void ImageJournalWriter::Reset() {
+    nodes_ = {{nullptr, global_}};
+    ids_ = {{global_.get(), 1}};
+    bindings_.clear();
+    objects_.clear();
+    complete_ = true;
+}
+
+void ImageJournalWriter::BindingChanged(Scope* scope, const std::string& name) {
+    if (auto it = ids_.find(scope); it != ids_.end()) {
+        bindings_.emplace(it->second, name);
+    }
+}
+
+void ImageJournalWriter::ObjectChanged(Object* object) {
+    if (auto it = ids_.find(object); it != ids_.end()) {
+        objects_.insert(it->second);
+    }
+}
+
+ImageJournalReader::ImageJournalReader(const Ref<Scope>& global) : nodes_{{nullptr, global}} {
+}
+
+void ImageJournalReader::Read(const std::string& image) {
+    ImageReader{image, true}.LoadJournal(&nodes_);
+}
+
+std::string PackBindings(const std::vector<std::pair<std::string, Ref<Object>>>& bindings,
+                         const Ref<Scope>& parent) {
+    auto root = MakeRef<Scope>();
+    root->SetParentScope(parent);
+    for (const auto& [name, value] : bindings) {
+        root->SetElementScope(name, value);
+    }
+    std::stringstream out;
+    ImageWriter{root, true}.Write(&out);
+    return out.str();
+}
+
+Ref<Scope> UnpackBindings(const std::string& image) {
+    auto root = MakeRef<Scope>();
+    AddBuiltins(root);
+    ImageReader{image}.Load(root);
+    return root;
+}
+
+void ClearBindings(const Ref<Scope>& root) {
+    ImageWriter{root}.ClearScopes();
+}
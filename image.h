@@ -0,0 +1,80 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "object.h"
+
+// Образ кучи: все объекты и области видимости, достижимые из глобальной области.
+// Встроенные функции записываются по имени и пересоздаются при загрузке.
+void WriteImage(const Ref<Scope>& global, std::ostream* out);
+
+void ReadImage(std::istream* in, const Ref<Scope>& global);
+
+// Объект или область в таблице ImageJournalReader; номер узла в журнале — индекс + 1.
+struct ImageNode {
+    Ref<Object> object;
+    Ref<Scope> scope;
+};
+
+// Журнал образов глобальной области: каждый образ несёт изменения с предыдущего.
+// Записанные объекты получают постоянные номера, и следующие образы ссылаются на них,
+// а не копируют, поэтому объекты, общие у нескольких привязок, у читателя тоже общие.
+// Изменения замечаются, пока журнал активен (см. ChangeObserver::Activation):
+// привязки известных областей записываются заново, а пары обновляются на месте.
+class ImageJournalWriter : public ChangeObserver {
+public:
+    explicit ImageJournalWriter(const Ref<Scope>& global);
+
+    // Образ изменений с прошлого вызова; первый после Reset содержит все привязки global.
+    // Если объект нельзя записать, бросает RuntimeError и ничего не забывает.
+    std::string Write();
+
+    // Начинает журнал заново и отпускает объекты, которые он держал.
+    void Reset();
+
+    void BindingChanged(Scope* scope, const std::string& name) override;
+
+    void ObjectChanged(Object* object) override;
+
+private:
+    Ref<Scope> global_;
+    bool complete_ = true;
+    std::vector<ImageNode> nodes_;
+    std::unordered_map<const void*, uint64_t> ids_;
+    std::set<std::pair<uint64_t, std::string>> bindings_;
+    std::set<uint64_t> objects_;
+};
+
+// Применяет к global образы ImageJournalWriter по порядку, начиная с первого после Reset.
+class ImageJournalReader {
+public:
+    explicit ImageJournalReader(const Ref<Scope>& global);
+
+    void Read(const std::string& image);
+
+private:
+    std::vector<ImageNode> nodes_;
+};
+
+// Снимок привязок вместе со всем, что из них достижимо. Из области parent и её предков
+// берутся только привязки имён, которые встречаются в записанных значениях, то есть
+// свободные переменные выражений и лямбд. Так значения передаются интерпретатору
+// другого потока: объекты не разделяются, а копируются.
+// Привязки областей к объектам, которые нельзя записать в образ, пропускаются;
+// если такой объект среди самих bindings, бросается RuntimeError.
+std::string PackBindings(const std::vector<std::pair<std::string, Ref<Object>>>& bindings,
+                         const Ref<Scope>& parent);
+
+// Восстанавливает снимок PackBindings в новой области со встроенными функциями.
+Ref<Scope> UnpackBindings(const std::string& image);
+
+// Очищает root и все области, достижимые из неё, когда снимок больше не нужен: лямбда,
+// записанная в свою же область, образует с ней цикл, который счётчики ссылок не
+// освобождают. Кэши символов не сбрасываются: области снимка после этого не вычисляются.
+void ClearBindings(const Ref<Scope>& root);
@@ -0,0 +1,241 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+std::atomic<uint64_t> next_histogram_id = 1;
+
+struct CachedShard {
+    uint64_t id = 0;
+    void* shard = nullptr;
+};
+
+// Гистограммы фаз Evaluate получают соседние id и не вытесняют друг друга.
+constexpr size_t kShardCacheSize = 16;
+thread_local std::array<CachedShard, kShardCacheSize> shard_cache;
+
+// Живые гистограммы по id: поток при завершении возвращает срезы только им.
+std::mutex histograms_mutex;
+std::unordered_map<uint64_t, LatencyHistogram*>& Histograms() {
+    static auto* histograms = new std::unordered_map<uint64_t, LatencyHistogram*>;
+    return *histograms;
+}
+
+}  // namespace
+
+// Срезы, которые взял поток; при его завершении возвращаются гистограммам.
+class ShardOwnership {
+public:
+    ~ShardOwnership() {
+        std::lock_guard lock{histograms_mutex};
+        for (const auto& [id, shard] : shards_) {
+            auto it = Histograms().find(id);
+            if (it != Histograms().end()) {
+                it->second->ReleaseShard(shard);
+            }
+        }
+    }
+
+    void Add(uint64_t id, LatencyHistogram::Shard* shard) {
+        shards_.emplace_back(id, shard);
+    }
+
+private:
+    std::vector<std::pair<uint64_t, LatencyHistogram::Shard*>> shards_;
+};
+
+namespace {
+
+thread_local ShardOwnership shard_ownership;
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : id_(next_histogram_id.fetch_add(1, std::memory_order_relaxed)) {
+    std::lock_guard lock{histograms_mutex};
+    Histograms().emplace(id_, this);
+}
+
+LatencyHistogram::~LatencyHistogram() {
+    std::lock_guard lock{histograms_mutex};
+    Histograms().erase(id_);
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+        return value;
+    }
+    size_t exponent = std::bit_width(value) - 1;
+    if (exponent > kMaxExponent) {
+        return kBuckets - 1;
+    }
+    size_t sub_bucket = (value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    size_t exponent = index / kSubBuckets + kSubBucketBits - 1;
+    uint64_t sub_bucket = index % kSubBuckets;
+    uint64_t width = uint64_t{1} << (exponent - kSubBucketBits);
+    return (uint64_t{1} << exponent) + (sub_bucket + 1) * width - 1;
+}
+
+LatencyHistogram::Shard& LatencyHistogram::LocalShard() {
+    CachedShard& cached = shard_cache[id_ % kShardCacheSize];
+    if (cached.id != id_) {
+        cached.shard = &AddShard();
+        cached.id = id_;
+    }
+    return *static_cast<Shard*>(cached.shard);
+}
+
+LatencyHistogram::Shard& LatencyHistogram::AddShard() {
+    std::lock_guard lock{mutex_};
+    auto& shard = owners_[std::this_thread::get_id()];
+    if (shard) {
+        return *shard;
+    }
+    if (free_shards_.empty()) {
+        shards_.push_back(std::make_unique<Shard>());
+        shard = shards_.back().get();
+    } else {
+        shard = free_shards_.back();
+        free_shards_.pop_back();
+    }
+    shard_ownership.Add(id_, shard);
+    return *shard;
+}
+
+// Записи среза остаются: следующий владелец продолжает их счёт.
+void LatencyHistogram::ReleaseShard(Shard* shard) {
+    std::lock_guard lock{mutex_};
+    owners_.erase(std::this_thread::get_id());
+    free_shards_.push_back(shard);
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds duration) {
+    uint64_t value = duration.count() > 0 ? duration.count() : 0;
+    Shard& shard = LocalShard();
+    auto& bucket = shard.buckets[BucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    shard.count.store(shard.count.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    if (value > shard.max.load(std::memory_order_relaxed)) {
+        shard.max.store(value, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::Totals LatencyHistogram::Merge() const {
+    Totals totals;
+    std::lock_guard lock{mutex_};
+    for (const auto& shard : shards_) {
+        for (size_t i = 0; i < kBuckets; ++i) {
+            uint64_t bucket = shard->buckets[i].load(std::memory_order_relaxed);
+            totals.buckets[i] += bucket;
+            totals.count += bucket;
+        }
+        totals.max = std::max(totals.max, shard->max.load(std::memory_order_relaxed));
+    }
+    return totals;
+}
+
+uint64_t LatencyHistogram::Count() const {
+    uint64_t count = 0;
+    std::lock_guard lock{mutex_};
+    for (const auto& shard : shards_) {
+        count += shard->count.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Percentile(double p) const {
+    return Percentile(Merge(), p);
+}
+
+// Ранг считается по тем же корзинам, что и обход, даже если записи идут параллельно.
+std::chrono::nanoseconds LatencyHistogram::Percentile(const Totals& totals, double p) {
+    if (totals.count == 0) {
+        return std::chrono::nanoseconds{0};
+    }
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(totals.count) + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += totals.buckets[i];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds{std::min(BucketUpperBound(i), totals.max)};
+        }
+    }
+    return std::chrono::nanoseconds{totals.max};
+}
+
+std::chrono::nanoseconds LatencyHistogram::Max() const {
+    uint64_t max = 0;
+    std::lock_guard lock{mutex_};
+    for (const auto& shard : shards_) {
+        max = std::max(max, shard->max.load(std::memory_order_relaxed));
+    }
+    return std::chrono::nanoseconds{max};
+}
+
+LatencyHistogram::Summary LatencyHistogram::Summarize() const {
+    Totals totals = Merge();
+    return {totals.count, Percentile(totals, 0.5), Percentile(totals, 0.9),
+            Percentile(totals, 0.99), std::chrono::nanoseconds{totals.max}};
+}
+
+void LatencyHistogram::Reset() {
+    std::lock_guard lock{mutex_};
+    for (auto& shard : shards_) {
+        for (auto& bucket : shard->buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shard->count.store(0, std::memory_order_relaxed);
+        shard->max.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::ShardCount() const {
+    std::lock_guard lock{mutex_};
+    return shards_.size();
+}
+
+std::string EvaluateLatencies::Report() const {
+    auto micros = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration<double, std::micro>(time).count();
+    };
+    std::stringstream ss;
+    ss << std::left << std::setw(10) << "phase" << std::right << std::setw(12) << "count"
+       << std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us"
+       << std::setw(12) << "max us" << '\n';
+    ss << std::fixed << std::setprecision(2);
+    std::pair<const char*, const LatencyHistogram*> phases[] = {
+        {"read", &read}, {"optimize", &optimize}, {"eval", &eval}, {"print", &print}};
+    for (const auto& [name, histogram] : phases) {
+        auto summary = histogram->Summarize();
+        ss << std::left << std::setw(10) << name << std::right << std::setw(12)
+           << summary.count << std::setw(12) << micros(summary.p50) << std::setw(12)
+           << micros(summary.p90) << std::setw(12) << micros(summary.p99) << std::setw(12)
+           << micros(summary.max) << '\n';
+    }
+    return ss.str();
+}
+
+void EvaluateLatencies::Reset() {
+    read.Reset();
+    optimize.Reset();
+    eval.Reset();
+    print.Reset();
+}
+
+EvaluateLatencies& GlobalEvaluateLatencies() {
+    static EvaluateLatencies latencies;
+    return latencies;
+}
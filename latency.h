@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Лог-линейная гистограмма длительностей в наносекундах: на каждую степень двойки
+// приходится 16 корзин, поэтому относительная погрешность не больше 1/16. У каждого
+// пишущего потока свой срез: запись не делит строки кэша с другими потоками и обходится
+// без атомарных read-modify-write. Чтение сводит срезы. Срез завершившегося потока
+// вместе с его записями достаётся следующему новому, поэтому срезов не больше, чем
+// потоков, писавших одновременно.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    ~LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void Record(std::chrono::nanoseconds duration);
+
+    uint64_t Count() const;
+
+    // Верхняя граница корзины, в которую попадает доля p (от 0 до 1) значений.
+    std::chrono::nanoseconds Percentile(double p) const;
+
+    std::chrono::nanoseconds Max() const;
+
+    struct Summary {
+        uint64_t count = 0;
+        std::chrono::nanoseconds p50{0};
+        std::chrono::nanoseconds p90{0};
+        std::chrono::nanoseconds p99{0};
+        std::chrono::nanoseconds max{0};
+    };
+
+    // Все показатели по одному сведению срезов.
+    Summary Summarize() const;
+
+    // Запись, идущая одновременно со сбросом, может пережить его.
+    void Reset();
+
+    // Сколько срезов выделено: не больше, чем потоков писало одновременно.
+    size_t ShardCount() const;
+
+    static size_t BucketIndex(uint64_t value);
+
+    static uint64_t BucketUpperBound(size_t index);
+
+private:
+    static constexpr size_t kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr size_t kMaxExponent = 48;
+    static constexpr size_t kBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+    // Пишет только поток-владелец, читают все: поля атомарные, но обновляются
+    // загрузкой и записью.
+    struct Shard {
+        std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+        std::atomic<uint64_t> count = 0;
+        std::atomic<uint64_t> max = 0;
+    };
+
+    struct Totals {
+        std::array<uint64_t, kBuckets> buckets{};
+        uint64_t count = 0;
+        uint64_t max = 0;
+    };
+
+    Shard& LocalShard();
+
+    Shard& AddShard();
+
+    // Вызывается при завершении потока, который писал в shard.
+    void ReleaseShard(Shard* shard);
+
+    Totals Merge() const;
+
+    static std::chrono::nanoseconds Percentile(const Totals& totals, double p);
+
+    // Гистограммы различаются по id_, а не по адресу: кэш срезов в потоке переживает
+    // удалённые гистограммы.
+    const uint64_t id_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::unordered_map<std::thread::id, Shard*> owners_;
+    std::vector<Shard*> free_shards_;
+
+    friend class ShardOwnership;
+};
+
+// Длительности фаз Scheme::Evaluate. Токенизатор ленивый и работает внутри Read,
+// поэтому его время входит в фазу read.
+struct EvaluateLatencies {
+    LatencyHistogram read;
+    LatencyHistogram optimize;
+    LatencyHistogram eval;
+    LatencyHistogram print;
+
+    // Таблица "phase count p50 p90 p99 max" в микросекундах.
+    std::string Report() const;
+
+    void Reset();
+};
+
+// Общие для всех интерпретаторов процесса гистограммы; их можно читать из другого
+// потока, пока идут вычисления.
+EvaluateLatencies& GlobalEvaluateLatencies();
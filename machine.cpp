@@ -0,0 +1,477 @@
+#include "machine.h"
+
+#include <optional>
+#include <typeindex>
+#include <unordered_map>
+
+#include "budget.h"
+#include "channel.h"
+#include "future.h"
+#include "native.h"
+#include "optimizer.h"
+#include "profiler.h"
+#include "trace.h"
+
+namespace {
+
+// Как встроенная функция вычисляет аргументы: EvalList — только формы, символы
+// передаются как есть; EvalArguments и EvalNumber — все, кроме чисел и булевых значений.
+enum class ArgumentMode { FORMS, ALL };
+
+// Встроенные функции, чей Apply можно повторить после приостановки: до последнего
+// аргумента у них нет побочных эффектов, а ждут они только в самом конце.
+std::optional<ArgumentMode> ReplayMode(const Ref<Object>& function, const Ref<Object>& args) {
+    static const std::unordered_map<std::type_index, ArgumentMode> kModes = {
+        {typeid(NumberQ), ArgumentMode::FORMS},
+        {typeid(SymbolQ), ArgumentMode::FORMS},
+        {typeid(BooleanQ), ArgumentMode::FORMS},
+        {typeid(Not), ArgumentMode::FORMS},
+        {typeid(Define), ArgumentMode::FORMS},
+        {typeid(Set), ArgumentMode::FORMS},
+        {typeid(Cons), ArgumentMode::FORMS},
+        {typeid(Car), ArgumentMode::FORMS},
+        {typeid(Cdr), ArgumentMode::FORMS},
+        {typeid(SetCar), ArgumentMode::FORMS},
+        {typeid(SetCdr), ArgumentMode::FORMS},
+        {typeid(List), ArgumentMode::FORMS},
+
+        {typeid(Plus), ArgumentMode::ALL},
+        {typeid(Minus), ArgumentMode::ALL},
+        {typeid(Multiplication), ArgumentMode::ALL},
+        {typeid(Division), ArgumentMode::ALL},
+        {typeid(Max), ArgumentMode::ALL},
+        {typeid(Min), ArgumentMode::ALL},
+        {typeid(Abs), ArgumentMode::ALL},
+        {typeid(Equal), ArgumentMode::ALL},
+        {typeid(Less), ArgumentMode::ALL},
+        {typeid(LessEquals), ArgumentMode::ALL},
+        {typeid(More), ArgumentMode::ALL},
+        {typeid(MoreEquals), ArgumentMode::ALL},
+        {typeid(Touch), ArgumentMode::ALL},
+        {typeid(MakeChannel), ArgumentMode::ALL},
+        {typeid(ChannelSend), ArgumentMode::ALL},
+        {typeid(ChannelReceive), ArgumentMode::ALL},
+        {typeid(NativeFunction), ArgumentMode::ALL},
+    };
+    const std::type_info& type = typeid(*function);
+    auto it = kModes.find(type);
+    if (it == kModes.end()) {
+        return std::nullopt;
+    }
+    // (define (f x) ...) аргументы не вычисляет: его форма — не выражение.
+    if (type == typeid(Define) && args && Is<Cell>(As<Cell>(args)->GetFirst())) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+// Составные формы вычисляются кадрами; заглушки аргументов и прочие объекты — сразу.
+bool IsForm(const Ref<Object>& expression) {
+    if (!expression) {
+        return false;
+    }
+    const std::type_info& type = typeid(*expression);
+    return type == typeid(Cell) || type == typeid(FoldedCell);
+}
+
+Ref<Cell> AsForm(const Ref<Object>& expression) {
+    return Ref<Cell>(static_cast<Cell*>(expression.get()));
+}
+
+// Вызов (f args...): голова, затем переход в кадр процедуры. Повторяет Cell::Eval.
+class FormFrame : public EvalMachine::Frame {
+public:
+    FormFrame(Ref<Cell> cell, Ref<Scope> scope) : cell_(std::move(cell)), scope_(std::move(scope)) {
+    }
+
+    void Step(EvalMachine* machine) override;
+
+    void Receive(Ref<Object> value) override {
+        head_ = std::move(value);
+    }
+
+private:
+    void Dispatch(EvalMachine* machine);
+
+    Ref<Cell> cell_;
+    Ref<Scope> scope_;
+    Ref<Object> head_;
+    bool started_ = false;
+};
+
+// Значение expression становится значением верхнего кадра, который при этом снимается.
+void Tail(EvalMachine* machine, Ref<Object> expression, Ref<Scope> scope) {
+    if (IsForm(expression)) {
+        machine->Replace(std::make_unique<FormFrame>(AsForm(expression), std::move(scope)));
+    } else {
+        machine->Finish(expression->Eval(scope));
+    }
+}
+
+// Вызов определённой лямбды: аргументы по одному связываются в её области, как в
+// Lambda::DefinitionOfArguments, затем по порядку вычисляется тело.
+class LambdaFrame : public EvalMachine::Frame {
+public:
+    LambdaFrame(Ref<Lambda> lambda, Ref<Object> args, Ref<Scope> scope)
+        : lambda_(std::move(lambda)), args_(std::move(args)), scope_(std::move(scope)) {
+    }
+
+    void Step(EvalMachine* machine) override {
+        const auto& arguments = lambda_->GetArguments();
+        if (bound_ < arguments.size()) {
+            auto cell = As<Cell>(args_);
+            if (!cell) {
+                throw SyntaxError{"Неверное количество аргументов для Lambda"};
+            }
+            args_ = cell->GetSecond();
+            machine->Evaluate(this, cell->GetFirst(), scope_);
+            return;
+        }
+        if (!entered_) {
+            entered_ = true;
+            machine->EnterBody(&lambda_->GetName());
+        }
+        const auto& body = lambda_->GetExpressions();
+        if (body.empty()) {
+            machine->Finish(lambda_);
+        } else if (next_ == body.size()) {
+            machine->Finish(std::move(value_));
+        } else {
+            machine->Evaluate(this, body[next_], lambda_->GetScope());
+        }
+    }
+
+    void Receive(Ref<Object> value) override {
+        const auto& arguments = lambda_->GetArguments();
+        if (bound_ < arguments.size()) {
+            lambda_->GetScope()->SetElementScope(arguments[bound_++], value);
+            return;
+        }
+        ++next_;
+        value_ = std::move(value);
+    }
+
+private:
+    Ref<Lambda> lambda_;
+    Ref<Object> args_;
+    Ref<Scope> scope_;
+    size_t bound_ = 0;
+    bool entered_ = false;
+    size_t next_ = 0;
+    Ref<Object> value_;
+};
+
+class IfFrame : public EvalMachine::Frame {
+public:
+    IfFrame(Ref<Object> args, Ref<Scope> scope) : args_(std::move(args)), scope_(std::move(scope)) {
+    }
+
+    void Step(EvalMachine* machine) override {
+        if (!arguments_) {
+            arguments_ = NumberOfArguments(args_);
+            if (arguments_ != 2 && arguments_ != 3) {
+                throw SyntaxError{"Неверное количество аргументов для If"};
+            }
+            machine->Evaluate(this, As<Cell>(args_)->GetFirst(), scope_);
+            return;
+        }
+        auto branches = As<Cell>(As<Cell>(args_)->GetSecond());
+        if (Is<Boolean>(condition_) && !As<Boolean>(condition_)->GetBool()) {
+            if (arguments_ == 2) {
+                machine->Finish(MakeRef<Symbol>("()"));
+                return;
+            }
+            Tail(machine, As<Cell>(branches->GetSecond())->GetFirst(), scope_);
+        } else {
+            Tail(machine, branches->GetFirst(), scope_);
+        }
+    }
+
+    void Receive(Ref<Object> value) override {
+        condition_ = std::move(value);
+    }
+
+private:
+    Ref<Object> args_;
+    Ref<Scope> scope_;
+    int arguments_ = 0;
+    Ref<Object> condition_;
+};
+
+// and (kStop = false) и or (kStop = true): операнды-формы вычисляются по порядку, пока
+// не встретится булево kStop.
+template <bool kStop>
+class LogicFrame : public EvalMachine::Frame {
+public:
+    LogicFrame(const Ref<Object>& args, Ref<Scope> scope)
+        : empty_(!args), current_(As<Cell>(args)), scope_(std::move(scope)) {
+    }
+
+    void Step(EvalMachine* machine) override {
+        if (empty_ || stopped_) {
+            machine->Finish(MakeRef<Boolean>(empty_ ? !kStop : kStop));
+        } else if (!current_) {
+            machine->Finish(std::move(operand_));
+        } else if (auto operand = current_->GetFirst(); Is<Cell>(operand)) {
+            machine->Evaluate(this, operand, scope_);
+        } else {
+            Receive(operand);
+        }
+    }
+
+    void Receive(Ref<Object> value) override {
+        operand_ = std::move(value);
+        if (Is<Boolean>(operand_) && As<Boolean>(operand_)->GetBool() == kStop) {
+            stopped_ = true;
+            return;
+        }
+        current_ = current_->GetSecond() ? As<Cell>(current_->GetSecond()) : nullptr;
+    }
+
+private:
+    bool empty_;
+    bool stopped_ = false;
+    Ref<Cell> current_;
+    Ref<Scope> scope_;
+    Ref<Object> operand_;
+};
+
+// Вызов встроенной функции из ReplayMode. Аргументы, которые она вычислила бы сама,
+// заменены заглушками; каждый вычисляется один раз, сколько бы раз ни повторялся Apply.
+class BuiltinFrame : public EvalMachine::Frame {
+public:
+    BuiltinFrame(EvalMachine* machine, Ref<Object> function, const Ref<Object>& args,
+                 Ref<Scope> scope, ArgumentMode mode);
+
+    void Step(EvalMachine* machine) override {
+        machine->Finish(function_->Apply(args_, scope_));
+    }
+
+    void Receive(Ref<Object> value) override {
+        values_[pending_] = std::move(value);
+        ready_[pending_] = true;
+    }
+
+    Ref<Object> Argument(size_t index) {
+        if (!ready_[index]) {
+            pending_ = index;
+            machine_->EvaluateNested(this, sources_[index], scope_);
+        }
+        return values_[index];
+    }
+
+private:
+    EvalMachine* machine_;
+    Ref<Object> function_;
+    Ref<Object> args_;
+    Ref<Scope> scope_;
+    std::vector<Ref<Object>> sources_;
+    std::vector<Ref<Object>> values_;
+    std::vector<bool> ready_;
+    size_t pending_ = 0;
+};
+
+// Заглушка аргумента: встроенная функция видит форму и вычисляет её через Eval.
+class PendingArgument : public Cell {
+public:
+    PendingArgument(BuiltinFrame* frame, size_t index) : frame_(frame), index_(index) {
+    }
+
+    Ref<Object> Eval(const Ref<Scope>&) override {
+        return frame_->Argument(index_);
+    }
+
+private:
+    BuiltinFrame* frame_;
+    size_t index_;
+};
+
+BuiltinFrame::BuiltinFrame(EvalMachine* machine, Ref<Object> function, const Ref<Object>& args,
+                           Ref<Scope> scope, ArgumentMode mode)
+    : machine_(machine), function_(std::move(function)), scope_(std::move(scope)) {
+    std::vector<Ref<Object>> elements;
+    Ref<Object> rest = args;
+    for (auto cell = As<Cell>(rest); cell; cell = As<Cell>(rest)) {
+        Ref<Object> element = cell->GetFirst();
+        bool pending = mode == ArgumentMode::FORMS
+                           ? Is<Cell>(element)
+                           : element && !Is<Number>(element) && !Is<Boolean>(element);
+        if (pending) {
+            sources_.push_back(element);
+            element = MakeRef<PendingArgument>(this, sources_.size() - 1);
+        }
+        elements.push_back(element);
+        rest = cell->GetSecond();
+    }
+    values_.resize(sources_.size());
+    ready_.resize(sources_.size());
+    args_ = rest;
+    for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+        args_ = MakeRef<Cell>(*it, args_);
+    }
+}
+
+void FormFrame::Step(EvalMachine* machine) {
+    if (started_) {
+        Dispatch(machine);
+        return;
+    }
+    started_ = true;
+    RuntimeStats& stats = runtime_stats;
+    if (auto folded = As<FoldedCell>(cell_); folded && folded->GuardsHold(scope_)) {
+        ++stats.evals;
+        Tail(machine, folded->GetReplacement(), scope_);
+        return;
+    }
+    ++stats.evals;
+    eval_budget.Charge();
+    const auto& first = cell_->GetFirst();
+    if (Is<Symbol>(first) && As<Symbol>(first)->GetName() == "lambda") {
+        auto f = MakeRef<Lambda>();
+        machine->Finish(f->Apply(cell_->GetSecond(), scope_));
+        return;
+    }
+    machine->Evaluate(this, first, scope_);
+}
+
+void FormFrame::Dispatch(EvalMachine* machine) {
+    Ref<Object> f = std::move(head_);
+    Ref<Object> args = cell_->GetSecond();
+    if (EvalTrace& trace = eval_trace; trace.enabled) {
+        const std::string* name = nullptr;
+        if (typeid(*f) == typeid(Lambda)) {
+            const std::string& lambda_name = static_cast<Lambda*>(f.get())->GetName();
+            name = lambda_name.empty() ? nullptr : &lambda_name;
+        }
+        trace.Push(&typeid(*f), name, cell_->GetPosition());
+    }
+    ++runtime_stats.applies;
+    if (Profiler* profiler = Profiler::Active()) {
+        SuspendGuard suspend{false};
+        Profiler::Call call{profiler, f};
+        machine->Finish(f->Apply(args, scope_));
+        return;
+    }
+    const std::type_info& type = typeid(*f);
+    if (type == typeid(Lambda) && static_cast<Lambda*>(f.get())->GetFlag() == "defined") {
+        machine->Replace(std::make_unique<LambdaFrame>(As<Lambda>(f), args, scope_));
+    } else if (type == typeid(If)) {
+        machine->Replace(std::make_unique<IfFrame>(args, scope_));
+    } else if (type == typeid(And)) {
+        machine->Replace(std::make_unique<LogicFrame<false>>(args, scope_));
+    } else if (type == typeid(Or)) {
+        machine->Replace(std::make_unique<LogicFrame<true>>(args, scope_));
+    } else if (auto mode = ReplayMode(f, args)) {
+        machine->Replace(std::make_unique<BuiltinFrame>(machine, f, args, scope_, *mode));
+    } else {
+        SuspendGuard suspend{false};
+        machine->Finish(f->Apply(args, scope_));
+    }
+}
+
+}  // namespace
+
+EvalMachine::EvalMachine(const Ref<Object>& expression, const Ref<Scope>& scope)
+    : expression_(expression), scope_(scope) {
+}
+
+EvalMachine::~EvalMachine() = default;
+
+bool EvalMachine::Run() {
+    SuspendGuard suspend{true};
+    EvalBudget::Preemption preemption;
+    // Тела процедур, прерванные прошлой приостановкой, снова видны профилировщику.
+    for (const auto& frame : stack_) {
+        if (frame->in_body_) {
+            shadow_.emplace_back(frame->shadow_name_);
+        }
+    }
+    struct ClearShadow {
+        std::deque<ShadowFrame>* shadow;
+        ~ClearShadow() {
+            shadow->clear();
+        }
+    } clear{&shadow_};
+    try {
+        if (!started_) {
+            started_ = true;
+            if (!IsForm(expression_)) {
+                result_ = expression_->Eval(scope_);
+                return true;
+            }
+            Push(std::make_unique<FormFrame>(AsForm(expression_), scope_));
+        }
+        RunTo(0);
+    } catch (const EvalSuspend& suspend) {
+        suspended_ = suspend;
+        return false;
+    }
+    return true;
+}
+
+const EvalSuspend& EvalMachine::Suspended() const {
+    return suspended_;
+}
+
+const Ref<Object>& EvalMachine::Result() const {
+    return result_;
+}
+
+void EvalMachine::Evaluate(Frame* frame, const Ref<Object>& expression,
+                           const Ref<Scope>& scope) {
+    if (IsForm(expression)) {
+        Push(std::make_unique<FormFrame>(AsForm(expression), scope));
+    } else {
+        frame->Receive(expression->Eval(scope));
+    }
+}
+
+void EvalMachine::EvaluateNested(Frame* frame, const Ref<Object>& expression,
+                                 const Ref<Scope>& scope) {
+    size_t depth = stack_.size();
+    Evaluate(frame, expression, scope);
+    RunTo(depth);
+}
+
+void EvalMachine::Finish(Ref<Object> value) {
+    auto frame = Pop();
+    if (stack_.empty()) {
+        result_ = std::move(value);
+    } else {
+        stack_.back()->Receive(std::move(value));
+    }
+}
+
+void EvalMachine::Replace(std::unique_ptr<Frame> frame) {
+    auto previous = Pop();
+    Push(std::move(frame));
+}
+
+void EvalMachine::EnterBody(const std::string* name) {
+    Frame* frame = stack_.back().get();
+    frame->in_body_ = true;
+    frame->shadow_name_ = name;
+    shadow_.emplace_back(name);
+}
+
+void EvalMachine::Push(std::unique_ptr<Frame> frame) {
+    stack_.push_back(std::move(frame));
+}
+
+std::unique_ptr<EvalMachine::Frame> EvalMachine::Pop() {
+    auto frame = std::move(stack_.back());
+    stack_.pop_back();
+    if (frame->in_body_) {
+        shadow_.pop_back();
+    }
+    return frame;
+}
+
+void EvalMachine::RunTo(size_t depth) {
+    while (stack_.size() > depth) {
+        if (eval_budget.TakePreemption() && CanSuspend()) {
+            throw EvalSuspend{};
+        }
+        stack_.back()->Step(this);
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "async.h"
+#include "object.h"
+#include "sampler.h"
+
+// Вычислитель с явным стеком для Scheme::EvaluateAsync. Вызовы лямбд, if, and, or и
+// аргументы встроенных функций лежат в кадрах на куче, а не на стеке C++, поэтому
+// вычисление можно приостановить посреди формы и продолжить на другом потоке ОС.
+// Точки приостановки — медленный путь бюджета (раз в EvalBudget::kSlice вызовов) и
+// ожидания channel-send!, channel-receive и touch.
+//
+// Встроенная функция, которая вычисляет аргументы только через их Eval (EvalList,
+// EvalArguments, EvalNumber), получает вместо аргументов-форм заглушки; заглушка
+// вычисляет форму вложенным циклом машины и запоминает значение. Если вычисление
+// приостановилось, после возобновления Apply встроенной функции вызывается заново и
+// берёт уже готовые значения. Остальные встроенные функции, вызовы под профилировщиком
+// (см. Profiler::Call) и функции C++ выполняются целиком, без приостановки.
+class EvalMachine {
+public:
+    class Frame;
+
+    EvalMachine(const Ref<Object>& expression, const Ref<Scope>& scope);
+
+    ~EvalMachine();
+
+    EvalMachine(const EvalMachine&) = delete;
+    EvalMachine& operator=(const EvalMachine&) = delete;
+
+    // Продвигает вычисление; true, если оно закончилось. Иначе оно приостановлено по
+    // причине Suspended(). Ошибки вычисления пробрасываются, машина после них не годна.
+    bool Run();
+
+    const EvalSuspend& Suspended() const;
+
+    const Ref<Object>& Result() const;
+
+    // Дальше — для кадров.
+
+    // Вычисляет expression для frame: форму — новым кадром, остальное — сразу; значение
+    // приходит во frame->Receive.
+    void Evaluate(Frame* frame, const Ref<Object>& expression, const Ref<Scope>& scope);
+
+    // То же, но не возвращается, пока значение не придёт (см. заглушки аргументов).
+    void EvaluateNested(Frame* frame, const Ref<Object>& expression, const Ref<Scope>& scope);
+
+    // Снимает верхний кадр и отдаёт value тому, кто его ждал.
+    void Finish(Ref<Object> value);
+
+    // Заменяет верхний кадр на frame: значение frame достанется ждавшему верхний.
+    void Replace(std::unique_ptr<Frame> frame);
+
+    // Верхний кадр — тело процедуры name: с этого момента он виден семплирующему
+    // профилировщику (см. ShadowFrame).
+    void EnterBody(const std::string* name);
+
+private:
+    void Push(std::unique_ptr<Frame> frame);
+
+    std::unique_ptr<Frame> Pop();
+
+    // Шагает верхние кадры, пока стек выше depth.
+    void RunTo(size_t depth);
+
+    Ref<Object> expression_;
+    Ref<Scope> scope_;
+    bool started_ = false;
+    std::vector<std::unique_ptr<Frame>> stack_;
+    // Кадры теневого стека; живут только внутри Run.
+    std::deque<ShadowFrame> shadow_;
+    Ref<Object> result_;
+    EvalSuspend suspended_;
+};
+
+class EvalMachine::Frame {
+public:
+    virtual ~Frame() = default;
+
+    // Один шаг кадра: вычислить следующее подвыражение или закончить (Finish, Replace).
+    virtual void Step(EvalMachine* machine) = 0;
+
+    // Значение подвыражения, запрошенного через Evaluate.
+    virtual void Receive(Ref<Object> value) = 0;
+
+private:
+    friend class EvalMachine;
+
+    // Имя тела процедуры для теневого стека; nullptr, пока кадр не в теле.
+    const std::string* shadow_name_ = nullptr;
+    bool in_body_ = false;
+};
@@ -0,0 +1,87 @@
+#include "native.h"
+
+#include "async.h"
+
+Value::Value(Ref<Object> object) : object_(std::move(object)) {
+}
+
+std::string Value::Print() const {
+    return object_->Print();
+}
+
+const Ref<Object>& Value::Get() const {
+    return object_;
+}
+
+int64_t NumberValue(const Ref<Object>& object) {
+    auto number = As<Number>(object);
+    if (!number) {
+        throw RuntimeError{"Ожидалось число"};
+    }
+    return number->GetValue();
+}
+
+bool BooleanValue(const Ref<Object>& object) {
+    auto boolean = As<Boolean>(object);
+    if (!boolean) {
+        throw RuntimeError{"Ожидалось булево значение"};
+    }
+    return boolean->GetBool();
+}
+
+std::vector<Ref<Object>> ListElements(const Ref<Object>& object) {
+    if (auto list = As<ListObj>(object)) {
+        return list->GetElements();
+    }
+    std::vector<Ref<Object>> elements;
+    if (auto quoted = As<Cell>(object)) {
+        for (auto cell = As<Cell>(quoted->GetFirst()); cell && cell->GetFirst();
+             cell = As<Cell>(cell->GetSecond())) {
+            elements.push_back(cell->GetFirst());
+        }
+        return elements;
+    }
+    if (Is<Symbol>(object) && As<Symbol>(object)->GetName() == "()") {
+        return elements;
+    }
+    throw RuntimeError{"Ожидался список"};
+}
+
+std::pair<int64_t, int64_t> Marshal<std::pair<int64_t, int64_t>>::FromScheme(
+    const Ref<Object>& object) {
+    auto pair = As<Pair>(object);
+    if (!pair) {
+        throw RuntimeError{"Ожидалась пара"};
+    }
+    return {pair->GetElementOne(), pair->GetElementTwo()};
+}
+
+Ref<Object> MakeArguments(const std::vector<Ref<Object>>& values) {
+    Ref<Object> args = nullptr;
+    for (auto it = values.rbegin(); it != values.rend(); ++it) {
+        Ref<Object> argument = *it;
+        if (!Is<Number>(argument) && !Is<Boolean>(argument)) {
+            argument = MakeRef<Cell>(MakeRef<Symbol>("quote"), MakeRef<Cell>(argument, nullptr));
+        }
+        args = MakeRef<Cell>(argument, args);
+    }
+    return args;
+}
+
+NativeFunction::NativeFunction(std::string name, size_t arity, Body body)
+    : name_(std::move(name)), arity_(arity), body_(std::move(body)) {
+}
+
+Ref<Object> NativeFunction::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto values = EvalArguments(args, scope);
+    if (values.size() != arity_) {
+        throw RuntimeError{"Неверное количество аргументов для " + name_};
+    }
+    // Функция C++ держит своё состояние на стеке и приостановиться не может.
+    SuspendGuard suspend{false};
+    return body_(values);
+}
+
+std::string NativeFunction::Print() {
+    return "#<native " + name_ + ">";
+}
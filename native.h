@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "object.h"
+
+// Значение Scheme для встраивающего кода (см. Scheme::Call). Держит объект
+// интерпретатора, поэтому используется в том же потоке, что и интерпретатор.
+class Value {
+public:
+    Value() = default;
+
+    explicit Value(Ref<Object> object);
+
+    // Преобразование в тип C++ по правилам Marshal; при несовпадении типа
+    // бросает RuntimeError.
+    template <class T>
+    T As() const;
+
+    std::string Print() const;
+
+    const Ref<Object>& Get() const;
+
+private:
+    Ref<Object> object_;
+};
+
+int64_t NumberValue(const Ref<Object>& object);
+
+bool BooleanValue(const Ref<Object>& object);
+
+// Элементы списка в любом из представлений: результат list, цитированный список, ().
+std::vector<Ref<Object>> ListElements(const Ref<Object>& object);
+
+// Преобразования между типами C++ и объектами Scheme: целые числа, bool, строки
+// (как символы), std::pair целых (как пары), std::vector (как списки) и Value.
+template <class T>
+struct Marshal;
+
+template <class T>
+    requires std::is_integral_v<T> && (!std::is_same_v<T, bool>)
+struct Marshal<T> {
+    static Ref<Object> ToScheme(T value) {
+        if (!std::in_range<int64_t>(value)) {
+            throw RuntimeError{"Число не помещается в int64_t"};
+        }
+        return MakeRef<Number>(static_cast<int64_t>(value));
+    }
+
+    // Число вне диапазона T не усекается, а считается ошибкой типа.
+    static T FromScheme(const Ref<Object>& object) {
+        int64_t value = NumberValue(object);
+        if (!std::in_range<T>(value)) {
+            throw RuntimeError{"Число " + std::to_string(value) + " вне диапазона [" +
+                               std::to_string(std::numeric_limits<T>::min()) + ", " +
+                               std::to_string(std::numeric_limits<T>::max()) + "]"};
+        }
+        return static_cast<T>(value);
+    }
+};
+
+template <>
+struct Marshal<bool> {
+    static Ref<Object> ToScheme(bool value) {
+        return MakeRef<Boolean>(value);
+    }
+
+    static bool FromScheme(const Ref<Object>& object) {
+        return BooleanValue(object);
+    }
+};
+
+template <>
+struct Marshal<std::string> {
+    static Ref<Object> ToScheme(const std::string& value) {
+        return MakeRef<Symbol>(value);
+    }
+
+    static std::string FromScheme(const Ref<Object>& object) {
+        return object->Print();
+    }
+};
+
+template <>
+struct Marshal<std::pair<int64_t, int64_t>> {
+    static Ref<Object> ToScheme(const std::pair<int64_t, int64_t>& value) {
+        return MakeRef<Pair>(value.first, value.second);
+    }
+
+    static std::pair<int64_t, int64_t> FromScheme(const Ref<Object>& object);
+};
+
+template <class T>
+struct Marshal<std::vector<T>> {
+    static Ref<Object> ToScheme(const std::vector<T>& values) {
+        std::vector<Ref<Object>> elements;
+        elements.reserve(values.size());
+        for (const auto& value : values) {
+            elements.push_back(Marshal<T>::ToScheme(value));
+        }
+        return MakeRef<ListObj>(std::move(elements));
+    }
+
+    static std::vector<T> FromScheme(const Ref<Object>& object) {
+        std::vector<T> values;
+        for (const auto& element : ListElements(object)) {
+            values.push_back(Marshal<T>::FromScheme(element));
+        }
+        return values;
+    }
+};
+
+template <>
+struct Marshal<Value> {
+    static Ref<Object> ToScheme(const Value& value) {
+        return value.Get();
+    }
+
+    static Value FromScheme(const Ref<Object>& object) {
+        return Value{object};
+    }
+};
+
+template <class T>
+using MarshalOf = Marshal<std::remove_cvref_t<T>>;
+
+template <class T>
+T Value::As() const {
+    return Marshal<T>::FromScheme(object_);
+}
+
+// Список аргументов для Apply. Аргументы Apply вычисляются, поэтому всё, кроме чисел
+// и булевых значений, цитируется.
+Ref<Object> MakeArguments(const std::vector<Ref<Object>>& values);
+
+// Функция C++, зарегистрированная через Scheme::Register. Аргументы вычисляются и
+// проверяются по числу до вызова.
+class NativeFunction : public Object {
+public:
+    using Body = std::function<Ref<Object>(const std::vector<Ref<Object>>& args)>;
+
+    NativeFunction(std::string name, size_t arity, Body body);
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+
+    std::string Print() override;
+
+private:
+    std::string name_;
+    size_t arity_;
+    Body body_;
+};
+
+namespace native {
+
+template <class Signature>
+struct Traits;
+
+template <class R, class... Args>
+struct Traits<R(Args...)> {
+    using Result = R;
+    using Arguments = std::tuple<std::remove_cvref_t<Args>...>;
+    static constexpr size_t kArity = sizeof...(Args);
+};
+
+template <class R, class... Args>
+struct Traits<R (*)(Args...)> : Traits<R(Args...)> {};
+
+template <class C, class R, class... Args>
+struct Traits<R (C::*)(Args...)> : Traits<R(Args...)> {};
+
+template <class C, class R, class... Args>
+struct Traits<R (C::*)(Args...) const> : Traits<R(Args...)> {};
+
+template <class F>
+struct Callable : Traits<decltype(&F::operator())> {};
+
+template <class R, class... Args>
+struct Callable<R (*)(Args...)> : Traits<R(Args...)> {};
+
+template <class F, size_t... I>
+Ref<Object> Invoke(F& function, const std::vector<Ref<Object>>& args,
+                   std::index_sequence<I...>) {
+    using Arguments = typename Callable<F>::Arguments;
+    using Result = typename Callable<F>::Result;
+    if constexpr (std::is_void_v<Result>) {
+        function(Marshal<std::tuple_element_t<I, Arguments>>::FromScheme(args[I])...);
+        return MakeRef<Boolean>(true);
+    } else {
+        return MarshalOf<Result>::ToScheme(
+            function(Marshal<std::tuple_element_t<I, Arguments>>::FromScheme(args[I])...));
+    }
+}
+
+}  // namespace native
+
+// Оборачивает функцию или лямбду C++ с фиксированной сигнатурой: преобразования
+// аргументов и результата выбираются при компиляции.
+template <class F>
+Ref<NativeFunction> MakeNative(std::string name, F function) {
+    using Function = std::decay_t<F>;
+    constexpr size_t kArity = native::Callable<Function>::kArity;
+    return MakeRef<NativeFunction>(
+        std::move(name), kArity,
+        [function = Function(std::move(function))](
+            const std::vector<Ref<Object>>& args) mutable {
+            return native::Invoke(function, args, std::make_index_sequence<kArity>{});
+        });
+}
@@ -1,30 +1,208 @@
 #include "object.h"
 
+#include <limits>
 #include <stdexcept>
+#include <typeindex>
 
-void Scope::SetParentScope(std::shared_ptr<Scope> parent_scope) {
+#include "budget.h"
+#include "channel.h"
+#include "future.h"
+#include "profiler.h"
+#include "sampler.h"
+
+std::atomic<uint64_t> Scope::epoch_ = 1;
+std::atomic<uint64_t> Scope::next_version_ = 1;
+thread_local ChangeObserver* ChangeObserver::active = nullptr;
+thread_local Scope* Scope::active_globals = nullptr;
+thread_local uint64_t Scope::active_globals_id = 0;
+
+ChangeObserver::Activation::Activation(ChangeObserver* observer) : previous_(active) {
+    active = observer;
+}
+
+ChangeObserver::Activation::~Activation() {
+    active = previous_;
+}
+
+Scope::~Scope() = default;
+
+// Версии раздаются потокам блоками, чтобы создание областей не упиралось в общий счётчик.
+uint64_t Scope::NextVersion() {
+    constexpr uint64_t kBlock = 1024;
+    thread_local uint64_t next = 0;
+    thread_local uint64_t end = 0;
+    if (next == end) {
+        next = next_version_.fetch_add(kBlock, std::memory_order_relaxed);
+        end = next + kBlock;
+    }
+    return next++;
+}
+
+void Scope::SetParentScope(const Ref<Scope>& parent_scope) {
     parent_scope_ = parent_scope;
+    version_ = NextVersion();
+    if (has_children_) {
+        Invalidate();
+    }
+    // Замороженную область делят потоки, а новых привязок в ней не бывает.
+    if (parent_scope && !parent_scope->frozen_) {
+        parent_scope->has_children_ = true;
+    }
 }
 
-void Scope::SetElementScope(std::string symbol, std::shared_ptr<Object> object) {
-    scope_[symbol] = object;
+void Scope::Clear() {
+    Discard();
+    if (has_children_) {
+        Invalidate();
+    }
 }
 
-std::shared_ptr<Object> Scope::GetElementScope(std::string symbol) {
-    if (scope_.find(symbol) == scope_.end()) {
-        if (parent_scope_) {
-            return parent_scope_->GetElementScope(symbol);
+void Scope::Discard() {
+    // Значения освобождаются после того, как область уже пуста.
+    auto elements = std::move(scope_);
+    scope_.clear();
+    version_ = NextVersion();
+}
+
+const Ref<Scope>& Scope::GetParentScope() const {
+    return parent_scope_;
+}
+
+const std::unordered_map<std::string, Ref<Object>>& Scope::GetElements() const {
+    return scope_;
+}
+
+void Scope::SetElementScope(const std::string& symbol, const Ref<Object>& object) {
+    if (frozen_) {
+        if (!active_globals || active_globals == this) {
+            throw RuntimeError{"Запись в замороженную область " + symbol};
         }
+        active_globals->SetElementScope(symbol, object);
+        return;
+    }
+    if (ChangeObserver* observer = ChangeObserver::Active()) {
+        observer->BindingChanged(this, symbol);
+    }
+    auto it = scope_.find(symbol);
+    if (it != scope_.end()) {
+        it->second = object;
+        return;
+    }
+    if (HeapAccount* account = HeapOwner()) {
+        // Узел хеш-таблицы: пара, указатель на следующий узел и сохранённый хеш.
+        size_t bytes = sizeof(std::pair<const std::string, Ref<Object>>) + 2 * sizeof(void*) +
+                       StringHeapBytes(symbol);
+        account->Charge(bytes);
+        AddCharge(account, bytes);
+    }
+    // Кэши потомков могли разрешить это имя выше по цепочке; без потомков достаточно
+    // новой версии этой области.
+    if (has_children_ && parent_scope_ && parent_scope_->FindCell(symbol)) {
+        Invalidate();
+    }
+    scope_.emplace(symbol, object);
+    version_ = NextVersion();
+}
+
+Ref<Object> Scope::GetElementScope(const std::string& symbol) {
+    auto cell = FindCell(symbol);
+    if (!cell) {
         throw NameError{symbol + " такого элемента нет!"};
     }
-    return scope_[symbol];
+    return *cell;
+}
+
+Ref<Object>* Scope::FindCell(const std::string& symbol) {
+    return FindCell(symbol, nullptr);
+}
+
+Ref<Object>* Scope::FindCell(const std::string& symbol, Scope** owner) {
+    RuntimeStats& stats = runtime_stats;
+    ++stats.scope_lookups;
+    Scope* globals = active_globals;
+    Scope* frozen = nullptr;
+    for (Scope* scope = this; scope; scope = scope->parent_scope_.get()) {
+        if (scope == globals) {
+            globals = nullptr;
+        } else if (scope->frozen_ && globals) {
+            frozen = scope;
+            scope = std::exchange(globals, nullptr);
+        }
+        ++stats.scope_depth;
+        auto it = scope->scope_.find(symbol);
+        if (it != scope->scope_.end()) {
+            if (owner) {
+                *owner = scope;
+            }
+            return &it->second;
+        }
+    }
+    // Замороженная область могла не входить в цепочку текущего интерпретатора.
+    for (Scope* scope = frozen; scope; scope = scope->parent_scope_.get()) {
+        ++stats.scope_depth;
+        auto it = scope->scope_.find(symbol);
+        if (it != scope->scope_.end()) {
+            if (owner) {
+                *owner = scope;
+            }
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
+Ref<Object>* Scope::FindCellForUpdate(const std::string& symbol) {
+    Scope* owner = nullptr;
+    auto cell = FindCell(symbol, &owner);
+    if (!cell || !owner->frozen_ || !active_globals || !Is<Pair>(*cell)) {
+        return cell;
+    }
+    auto pair = As<Pair>(*cell);
+    active_globals->SetElementScope(
+        symbol, MakeRef<Pair>(pair->GetElementOne(), pair->GetElementTwo()));
+    return active_globals->FindCell(symbol);
+}
+
+void Scope::Freeze() {
+    frozen_ = true;
+    Invalidate();
+}
+
+bool Scope::IsFrozen() const {
+    return frozen_;
+}
+
+// Потомков замороженная область не отмечает (см. SetParentScope), поэтому размороженная
+// считается их имеющей: её привязки могут пропасть при Clear.
+Scope::Thaw::Thaw(Scope* scope) : scope_(scope), frozen_(scope->frozen_) {
+    scope_->frozen_ = false;
+    scope_->has_children_ = true;
+}
+
+Scope::Thaw::~Thaw() {
+    scope_->frozen_ = frozen_;
+}
+
+// Смена интерпретатора не трогает общую эпоху: кэши символов сверяют ActiveGlobalsId(),
+// поэтому кэши других интерпретаторов и потоков переживают переключение.
+Scope::ActiveGlobals::ActiveGlobals(Scope* globals) : previous_(active_globals) {
+    active_globals = globals;
+    active_globals_id = globals ? globals->id_ : 0;
+    if (globals) {
+        globals->has_children_ = true;
+    }
+}
+
+Scope::ActiveGlobals::~ActiveGlobals() {
+    active_globals = previous_;
+    active_globals_id = previous_ ? previous_->id_ : 0;
 }
 
-std::shared_ptr<Object> Object::Eval(std::shared_ptr<Scope>) {
+Ref<Object> Object::Eval(const Ref<Scope>&) {
     throw RuntimeError("Don't use Eval");
 }
 
-std::shared_ptr<Object> Object::Apply(std::shared_ptr<Object>, std::shared_ptr<Scope>) {
+Ref<Object> Object::Apply(const Ref<Object>&, const Ref<Scope>&) {
     throw RuntimeError("Don't use Apply");
 };
 
@@ -32,26 +210,42 @@ std::string Object::Print() {
     throw RuntimeError("Don't use Print");
 };
 
-Number::Number(int value) : value_(value) {
+Number::Number(int64_t value) : value_(value) {
 }
 
-std::shared_ptr<Object> Number::Eval(std::shared_ptr<Scope>) {
-    return shared_from_this();
+Ref<Object> Number::Eval(const Ref<Scope>&) {
+    return Ref<Object>(this);
 }
 
 std::string Number::Print() {
     return std::to_string(value_);
 }
 
-int Number::GetValue() const {
+int64_t Number::GetValue() const {
     return value_;
 }
 
-Symbol::Symbol(std::string name) : name_(name) {
+Symbol::Symbol(const std::string& name) : name_(name) {
 }
 
-std::shared_ptr<Object> Symbol::Eval(std::shared_ptr<Scope> scope) {
-    return scope->GetElementScope(name_);
+Ref<Object> Symbol::Eval(const Ref<Scope>& scope) {
+    uint64_t epoch = Scope::Epoch();
+    uint64_t globals = Scope::ActiveGlobalsId();
+    if (cached_scope_ != scope.get() || cached_version_ != scope->Version() ||
+        cached_epoch_ != epoch || cached_globals_ != globals) {
+        cached_cell_ = scope->FindCell(name_);
+        if (!cached_cell_) {
+            cached_scope_ = nullptr;
+            throw NameError{name_ + " такого элемента нет!"};
+        }
+        cached_scope_ = scope.get();
+        cached_version_ = scope->Version();
+        cached_epoch_ = epoch;
+        cached_globals_ = globals;
+    } else {
+        ++runtime_stats.symbol_cache_hits;
+    }
+    return *cached_cell_;
 }
 
 std::string Symbol::Print() {
@@ -62,11 +256,15 @@ const std::string& Symbol::GetName() const {
     return name_;
 }
 
+size_t Symbol::HeapExtraBytes() const {
+    return StringHeapBytes(name_);
+}
+
 Boolean::Boolean(bool name) : bool_(name) {
 }
 
-std::shared_ptr<Object> Boolean::Eval(std::shared_ptr<Scope>) {
-    return shared_from_this();
+Ref<Object> Boolean::Eval(const Ref<Scope>&) {
+    return Ref<Object>(this);
 }
 
 const bool& Boolean::GetBool() const {
@@ -80,7 +278,7 @@ std::string Boolean::Print() {
     return "#f";
 }
 
-Pair::Pair(int element_one, int element_two)
+Pair::Pair(int64_t element_one, int64_t element_two)
     : element_one_(element_one), element_two_(element_two) {
 }
 
@@ -88,59 +286,90 @@ std::string Pair::Print() {
     return "(" + std::to_string(element_one_) + " . " + std::to_string(element_two_) + ")";
 }
 
-void Pair::SetElementOne(int element_one) {
+void Pair::SetElementOne(int64_t element_one) {
+    if (ChangeObserver* observer = ChangeObserver::Active()) {
+        observer->ObjectChanged(this);
+    }
     element_one_ = element_one;
 }
 
-void Pair::SetElementTwo(int element_two) {
+void Pair::SetElementTwo(int64_t element_two) {
+    if (ChangeObserver* observer = ChangeObserver::Active()) {
+        observer->ObjectChanged(this);
+    }
     element_two_ = element_two;
 }
 
-const int& Pair::GetElementOne() const {
+const int64_t& Pair::GetElementOne() const {
     return element_one_;
 }
 
-const int& Pair::GetElementTwo() const {
+const int64_t& Pair::GetElementTwo() const {
     return element_two_;
 }
 
-ListObj::ListObj(std::vector<std::shared_ptr<Object>> object_shared_ptr)
+ListObj::ListObj(std::vector<Ref<Object>> object_shared_ptr)
     : object_shared_ptr_(object_shared_ptr) {
 }
 
+const std::vector<Ref<Object>>& ListObj::GetElements() const {
+    return object_shared_ptr_;
+}
+
+void ListObj::SetElements(std::vector<Ref<Object>> object_shared_ptr) {
+    object_shared_ptr_ = object_shared_ptr;
+}
+
+size_t ListObj::HeapExtraBytes() const {
+    return object_shared_ptr_.capacity() * sizeof(Ref<Object>);
+}
+
 std::string ListObj::Print() {
     std::string result = "(";
     for (size_t i = 0; i < object_shared_ptr_.size(); ++i) {
-        if (i == object_shared_ptr_.size() - 1) {
-            result += std::to_string(As<Number>(object_shared_ptr_[i])->GetValue());
-            result += ")";
-            return result;
+        if (i > 0) {
+            result += " ";
         }
-        result += std::to_string(As<Number>(object_shared_ptr_[i])->GetValue());
-        result += " ";
+        result += object_shared_ptr_[i]->Print();
     }
-    return result;
+    return result + ")";
 }
 
 Cell::Cell() : first_(nullptr), second_(nullptr) {
 }
 
-Cell::Cell(std::shared_ptr<Object> first, std::shared_ptr<Object> second)
+Cell::Cell(const Ref<Object>& first, const Ref<Object>& second)
     : first_(first), second_(second) {
 }
 
-std::shared_ptr<Object> Cell::Eval(std::shared_ptr<Scope> scope) {
+Ref<Object> Cell::Eval(const Ref<Scope>& scope) {
+    RuntimeStats& stats = runtime_stats;
+    ++stats.evals;
+    eval_budget.Charge();
     if (Is<Symbol>(first_) && As<Symbol>(first_)->GetName() == "lambda") {
-        auto f = std::make_shared<Lambda>();
+        auto f = MakeRef<Lambda>();
         return f->Apply(second_, scope);
     }
     auto f = first_->Eval(scope);
+    if (EvalTrace& trace = eval_trace; trace.enabled) {
+        const std::string* name = nullptr;
+        if (typeid(*f) == typeid(Lambda)) {
+            const std::string& lambda_name = static_cast<Lambda*>(f.get())->GetName();
+            name = lambda_name.empty() ? nullptr : &lambda_name;
+        }
+        trace.Push(&typeid(*f), name, position_);
+    }
+    ++stats.applies;
+    if (Profiler* profiler = Profiler::Active()) {
+        Profiler::Call call{profiler, f};
+        return f->Apply(second_, scope);
+    }
     return f->Apply(second_, scope);
 }
 
 std::string Cell::Print() {
     std::string result = "(";
-    std::shared_ptr<Cell> curent = As<Cell>(first_);
+    Ref<Cell> curent = As<Cell>(first_);
     if (!curent) {
         throw RuntimeError{"Cell null"};
     }
@@ -163,70 +392,77 @@ std::string Cell::Print() {
     return "()";
 }
 
-std::shared_ptr<Object> Cell::GetFirst() const {
+SourcePosition Cell::GetPosition() const {
+    return position_;
+}
+
+void Cell::SetPosition(SourcePosition position) {
+    position_ = position;
+}
+
+const Ref<Object>& Cell::GetFirst() const {
     return first_;
 }
 
-std::shared_ptr<Object> Cell::GetSecond() const {
+const Ref<Object>& Cell::GetSecond() const {
     return second_;
 }
 
-void Cell::SetFirst(std::shared_ptr<Object> first) {
+void Cell::SetFirst(const Ref<Object>& first) {
     first_ = first;
 }
 
-void Cell::SetSecond(std::shared_ptr<Object> second) {
+void Cell::SetSecond(const Ref<Object>& second) {
     second_ = second;
 }
 
-std::shared_ptr<Object> QuoteSpecForm::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) {
+Ref<Object> QuoteSpecForm::Apply(const Ref<Object>& args, const Ref<Scope>&) {
     if (!Is<Cell>(As<Cell>(args)->GetFirst())) {
         return As<Cell>(args)->GetFirst();
     }
     return args;
 }
 
-std::shared_ptr<Object> NumberQ::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> NumberQ::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
     if (args_list.size() != 1) {
         throw RuntimeError{"Неверное количество аргументов для number?"};
     }
 
     if (Is<Number>(args_list[0])) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
-    return std::make_shared<Boolean>(false);
+    return MakeRef<Boolean>(false);
 }
 
-std::shared_ptr<Object> SymbolQ::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> SymbolQ::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
     if (args_list.size() != 1) {
         throw RuntimeError{"Неверное количество аргументов для symbol?"};
     }
 
     if (Is<Symbol>(args_list[0])) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
-    return std::make_shared<Boolean>(false);
+    return MakeRef<Boolean>(false);
 }
 
-std::shared_ptr<Object> BooleanQ::Apply(std::shared_ptr<Object> args,
-                                        std::shared_ptr<Scope> scope) {
+Ref<Object> BooleanQ::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
 
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+    ArgumentList args_list = EvalList(args, scope);
     if (args_list.size() != 1) {
         throw RuntimeError{"Неверное количество аргументов для boolean?"};
     }
 
     if (Is<Boolean>(args_list[0])) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
-    return std::make_shared<Boolean>(false);
+    return MakeRef<Boolean>(false);
 }
 
-std::shared_ptr<Object> PairQ::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) {
-    std::shared_ptr<Object> curent = As<Cell>(args)->GetFirst();
-    std::shared_ptr<Object> is_quote = As<Cell>(curent)->GetFirst();
+Ref<Object> PairQ::Apply(const Ref<Object>& args, const Ref<Scope>&) {
+    Ref<Object> curent = As<Cell>(args)->GetFirst();
+    Ref<Object> is_quote = As<Cell>(curent)->GetFirst();
     if (Is<Symbol>(is_quote) && As<Symbol>(is_quote)->GetName() != "quote") {
         throw SyntaxError{"Неверные аргументы"};
     }
@@ -234,21 +470,21 @@ std::shared_ptr<Object> PairQ::Apply(std::shared_ptr<Object> args, std::shared_p
     curent = As<Cell>(curent)->GetFirst();
 
     if (!As<Cell>(curent)->GetFirst() || !As<Cell>(curent)->GetSecond()) {
-        return std::make_shared<Boolean>(false);
+        return MakeRef<Boolean>(false);
     } else if (Is<Number>(As<Cell>(curent)->GetFirst()) &&
                Is<Number>(As<Cell>(curent)->GetSecond())) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     } else if (!Is<Cell>(As<Cell>(curent)->GetFirst()) &&
                !Is<Cell>(As<Cell>(As<Cell>(curent)->GetSecond())->GetFirst())) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
 
-    return std::make_shared<Boolean>(false);
+    return MakeRef<Boolean>(false);
 }
 
-std::shared_ptr<Object> NullQ::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) {
+Ref<Object> NullQ::Apply(const Ref<Object>& args, const Ref<Scope>&) {
     auto curent = As<Cell>(args)->GetFirst();
-    std::shared_ptr<Object> is_quote = As<Cell>(curent)->GetFirst();
+    Ref<Object> is_quote = As<Cell>(curent)->GetFirst();
     if (Is<Symbol>(is_quote) && As<Symbol>(is_quote)->GetName() != "quote") {
         throw SyntaxError{"Неверные аргументы"};
     }
@@ -256,14 +492,14 @@ std::shared_ptr<Object> NullQ::Apply(std::shared_ptr<Object> args, std::shared_p
     curent = As<Cell>(curent)->GetFirst();
 
     if (!As<Cell>(curent)->GetFirst() && !As<Cell>(curent)->GetSecond()) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
-    return std::make_shared<Boolean>(false);
+    return MakeRef<Boolean>(false);
 }
 
-std::shared_ptr<Object> ListQ::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) {
+Ref<Object> ListQ::Apply(const Ref<Object>& args, const Ref<Scope>&) {
     auto curent = As<Cell>(args)->GetFirst();
-    std::shared_ptr<Object> is_quote = As<Cell>(curent)->GetFirst();
+    Ref<Object> is_quote = As<Cell>(curent)->GetFirst();
     if (Is<Symbol>(is_quote) && As<Symbol>(is_quote)->GetName() != "quote") {
         throw SyntaxError{"Неверные аргументы"};
     }
@@ -271,343 +507,293 @@ std::shared_ptr<Object> ListQ::Apply(std::shared_ptr<Object> args, std::shared_p
     curent = As<Cell>(curent)->GetFirst();
 
     if (!As<Cell>(curent)->GetFirst() && !As<Cell>(curent)->GetSecond()) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
     while (curent) {
         if (!Is<Cell>(As<Cell>(curent)->GetFirst()) && Is<Cell>(As<Cell>(curent)->GetSecond())) {
             curent = As<Cell>(curent)->GetSecond();
         } else if (!As<Cell>(curent)->GetSecond()) {
-            return std::make_shared<Boolean>(true);
+            return MakeRef<Boolean>(true);
         } else {
-            return std::make_shared<Boolean>(false);
+            return MakeRef<Boolean>(false);
         }
     }
-    return std::make_shared<Boolean>(true);
+    return MakeRef<Boolean>(true);
 }
 
-std::shared_ptr<Object> Plus::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Number>(0);
-    }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    int64_t result = 0;
-    for (size_t i = 0; i < args_list.size(); ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        if (Is<Number>(args_list[i])) {
-            if (Is<Number>(args_list[i])) {
-                result += As<Number>(args_list[i])->GetValue();
-            }
-        } else {
-            throw RuntimeError{"Plus не работает с символами"};
-        }
-    }
-    return std::make_shared<Number>(result);
+Ref<Object> NumericBuiltin::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    return MakeRef<Number>(Compute(args, scope));
 }
 
-std::shared_ptr<Object> Minus::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        throw RuntimeError{"Нет аргументов для Minus"};
+int64_t EvalNumber(const Ref<Object>& arg, const Ref<Scope>& scope, const char* name) {
+    Object* raw = arg.get();
+    if (auto number = dynamic_cast<Number*>(raw)) {
+        return number->GetValue();
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    int64_t result = 0;
-    args_list[0] = args_list[0]->Eval(scope);
-    if (Is<Number>(args_list[0])) {
-        result = As<Number>(args_list[0])->GetValue();
-    } else {
-        throw RuntimeError{"Minus не работает с символами"};
+    if (!raw) {
+        throw RuntimeError{std::string{name} + " не работает с символами"};
     }
-
-    for (size_t i = 1; i < args_list.size(); ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        if (Is<Number>(args_list[i])) {
-            result -= As<Number>(args_list[i])->GetValue();
+    Ref<Object> value;
+    // Под профилировщиком и трассировкой вызов идёт через Cell::Eval, чтобы его можно
+    // было учесть.
+    if (typeid(*raw) == typeid(Cell) && !Profiler::Active() && !eval_trace.enabled) {
+        auto cell = static_cast<Cell*>(raw);
+        auto head = As<Symbol>(cell->GetFirst());
+        if (head && head->GetName() != "lambda") {
+            auto function = head->Eval(scope);
+            RuntimeStats& stats = runtime_stats;
+            ++stats.evals;
+            ++stats.applies;
+            eval_budget.Charge();
+            if (auto numeric = dynamic_cast<NumericBuiltin*>(function.get())) {
+                return numeric->Compute(cell->GetSecond(), scope);
+            }
+            value = function->Apply(cell->GetSecond(), scope);
         } else {
-            throw RuntimeError{"Minus не работает с символами"};
+            value = cell->Eval(scope);
         }
-    }
-    return std::make_shared<Number>(result);
-}
-
-std::shared_ptr<Object> Multiplication::Apply(std::shared_ptr<Object> args,
-                                              std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Number>(1);
-    }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    int64_t result = 0;
-    args_list[0] = args_list[0]->Eval(scope);
-    if (Is<Number>(args_list[0])) {
-        result = As<Number>(args_list[0])->GetValue();
     } else {
-        throw RuntimeError{"Multiplication не работает с символами"};
+        value = arg->Eval(scope);
     }
-
-    for (size_t i = 1; i < args_list.size(); ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        if (Is<Number>(args_list[i])) {
-            result *= As<Number>(args_list[i])->GetValue();
-        } else {
-            throw RuntimeError{"Multiplication не работает с символами"};
-        }
+    if (!Is<Number>(value) && Is<Cell>(arg) && Is<Symbol>(value)) {
+        value = value->Eval(scope);
     }
-    return std::make_shared<Number>(result);
+    if (!Is<Number>(value)) {
+        throw RuntimeError{std::string{name} + " не работает с символами"};
+    }
+    return As<Number>(value)->GetValue();
 }
 
-std::shared_ptr<Object> Division::Apply(std::shared_ptr<Object> args,
-                                        std::shared_ptr<Scope> scope) {
-    if (!args) {
-        throw RuntimeError{"Нет аргументов для Division"};
-    }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    int64_t result = 0;
-    args_list[0] = args_list[0]->Eval(scope);
-    if (Is<Number>(args_list[0])) {
-        result = As<Number>(args_list[0])->GetValue();
-    } else {
-        throw RuntimeError{"Division не работает с символами"};
+struct WrapOverflow {
+    static void OnOverflow(const char*) {
     }
+};
 
-    for (size_t i = 1; i < args_list.size(); ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        if (Is<Number>(args_list[i])) {
-            result /= As<Number>(args_list[i])->GetValue();
-        } else {
-            throw RuntimeError{"Division не работает с символами"};
-        }
-    }
-    return std::make_shared<Number>(result);
-}
+struct AddOp {
+    static constexpr const char* kName = "Plus";
+    static constexpr bool kHasIdentity = true;
+    static constexpr int64_t kIdentity = 0;
 
-std::shared_ptr<Object> Max::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        throw RuntimeError{"Нет аргументов для max"};
-    }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    int64_t result = 0;
-    args_list[0] = args_list[0]->Eval(scope);
-    if (Is<Number>(args_list[0])) {
-        result = As<Number>(args_list[0])->GetValue();
-    } else {
-        throw RuntimeError{"max не работает для символов"};
+    static bool Combine(int64_t lhs, int64_t rhs, int64_t* result) {
+        return !__builtin_add_overflow(lhs, rhs, result);
     }
+};
 
-    for (size_t i = 1; i < args_list.size(); ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        if (Is<Number>(args_list[i])) {
-            result = std::max<int64_t>(result, As<Number>(args_list[i])->GetValue());
-        } else {
-            throw RuntimeError{"max не работает для символов"};
-        }
-    }
-    return std::make_shared<Number>(result);
-}
+struct SubtractOp {
+    static constexpr const char* kName = "Minus";
+    static constexpr bool kHasIdentity = false;
+    static constexpr int64_t kIdentity = 0;
 
-std::shared_ptr<Object> Min::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        throw RuntimeError{"Нет аргументов для min"};
+    static bool Combine(int64_t lhs, int64_t rhs, int64_t* result) {
+        return !__builtin_sub_overflow(lhs, rhs, result);
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    int64_t result = 0;
-    args_list[0] = args_list[0]->Eval(scope);
-    if (Is<Number>(args_list[0])) {
-        result = As<Number>(args_list[0])->GetValue();
-    } else {
-        throw RuntimeError{"min не работает для символов"};
+};
+
+struct MultiplyOp {
+    static constexpr const char* kName = "Multiplication";
+    static constexpr bool kHasIdentity = true;
+    static constexpr int64_t kIdentity = 1;
+
+    static bool Combine(int64_t lhs, int64_t rhs, int64_t* result) {
+        return !__builtin_mul_overflow(lhs, rhs, result);
     }
+};
 
-    for (size_t i = 1; i < args_list.size(); ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        if (Is<Number>(args_list[i])) {
-            result = std::min<int64_t>(result, As<Number>(args_list[i])->GetValue());
-        } else {
-            throw RuntimeError{"min не работает для символов"};
+struct DivideOp {
+    static constexpr const char* kName = "Division";
+    static constexpr bool kHasIdentity = false;
+    static constexpr int64_t kIdentity = 0;
+
+    static bool Combine(int64_t lhs, int64_t rhs, int64_t* result) {
+        if (rhs == 0) {
+            throw RuntimeError{"Деление на ноль"};
         }
+        if (lhs == std::numeric_limits<int64_t>::min() && rhs == -1) {
+            *result = lhs;
+            return false;
+        }
+        *result = lhs / rhs;
+        return true;
     }
-    return std::make_shared<Number>(result);
-}
+};
 
-std::shared_ptr<Object> Abs::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        throw RuntimeError{"Нет аргументов для abs"};
-    }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    if (args_list.size() != 1) {
-        std::string error_message = "Неверное количество аргументов для abs";
-        throw RuntimeError{error_message};
-    }
-    int64_t result;
-    args_list[0] = args_list[0]->Eval(scope);
-    if (Is<Number>(args_list[0])) {
-        result = std::abs(As<Number>(args_list[0])->GetValue());
-    } else {
-        throw RuntimeError{"abs не применим к символам"};
+struct MaxOp {
+    static constexpr const char* kName = "max";
+    static constexpr bool kHasIdentity = false;
+    static constexpr int64_t kIdentity = 0;
+
+    static bool Combine(int64_t lhs, int64_t rhs, int64_t* result) {
+        *result = std::max(lhs, rhs);
+        return true;
     }
-    return std::make_shared<Number>(result);
-}
+};
 
-std::shared_ptr<Object> Equal::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Boolean>(true);
+struct MinOp {
+    static constexpr const char* kName = "min";
+    static constexpr bool kHasIdentity = false;
+    static constexpr int64_t kIdentity = 0;
+
+    static bool Combine(int64_t lhs, int64_t rhs, int64_t* result) {
+        *result = std::min(lhs, rhs);
+        return true;
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    if (args_list.size() == 1) {
-        args_list[0] = args_list[0]->Eval(scope);
-        if (Is<Number>(args_list[0])) {
-            return std::make_shared<Boolean>(true);
-        } else {
-            throw RuntimeError{"Equal не работает с символами"};
+};
+
+template <class Op, class OverflowPolicy>
+int64_t ArithmeticFold<Op, OverflowPolicy>::Compute(const Ref<Object>& args,
+                                                    const Ref<Scope>& scope) {
+    auto combine = [](int64_t lhs, int64_t rhs) {
+        int64_t result;
+        if (!Op::Combine(lhs, rhs, &result)) {
+            OverflowPolicy::OnOverflow(Op::kName);
         }
-    }
-    for (size_t i = 0; i < args_list.size() - 1; ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        args_list[i + 1] = args_list[i + 1]->Eval(scope);
-        if (Is<Number>(args_list[i]) && Is<Number>(args_list[i + 1])) {
-            if (As<Number>(args_list[i])->GetValue() != As<Number>(args_list[i + 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
+        return result;
+    };
+
+    auto first = dynamic_cast<Cell*>(args.get());
+    if (!first) {
+        if constexpr (Op::kHasIdentity) {
+            return Op::kIdentity;
         } else {
-            throw RuntimeError{"Equal не работает с символами"};
+            throw RuntimeError{std::string{"Нет аргументов для "} + Op::kName};
         }
     }
-    return std::make_shared<Boolean>(true);
-}
-
-std::shared_ptr<Object> Less::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Boolean>(true);
+    int64_t result = EvalNumber(first->GetFirst(), scope, Op::kName);
+    Ref<Object> rest = first->GetSecond();
+    if (!rest) {
+        return result;
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    if (args_list.size() == 1) {
-        args_list[0] = args_list[0]->Eval(scope);
-        if (Is<Number>(args_list[0])) {
-            return std::make_shared<Boolean>(true);
-        } else {
-            throw RuntimeError{"Less не работает с символами"};
-        }
+    auto second = dynamic_cast<Cell*>(rest.get());
+    if (second && !second->GetSecond()) {
+        return combine(result, EvalNumber(second->GetFirst(), scope, Op::kName));
     }
-    for (size_t i = 0; i < args_list.size() - 1; ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        args_list[i + 1] = args_list[i + 1]->Eval(scope);
-        if (Is<Number>(args_list[i]) && Is<Number>(args_list[i + 1])) {
-            if (As<Number>(args_list[i])->GetValue() >= As<Number>(args_list[i + 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError{"Less не работает с символами"};
+    while (rest) {
+        auto cell = dynamic_cast<Cell*>(rest.get());
+        if (!cell) {
+            return combine(result, EvalNumber(rest, scope, Op::kName));
         }
+        result = combine(result, EvalNumber(cell->GetFirst(), scope, Op::kName));
+        rest = cell->GetSecond();
     }
-    return std::make_shared<Boolean>(true);
+    return result;
 }
 
-std::shared_ptr<Object> LessEquals::Apply(std::shared_ptr<Object> args,
-                                          std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Boolean>(true);
-    }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    if (args_list.size() == 1) {
-        args_list[0] = args_list[0]->Eval(scope);
-        if (Is<Number>(args_list[0])) {
-            return std::make_shared<Boolean>(true);
-        } else {
-            throw RuntimeError{"LessEquals не работает с символами"};
-        }
+template class ArithmeticFold<AddOp, WrapOverflow>;
+template class ArithmeticFold<SubtractOp, WrapOverflow>;
+template class ArithmeticFold<MultiplyOp, WrapOverflow>;
+template class ArithmeticFold<DivideOp, WrapOverflow>;
+template class ArithmeticFold<MaxOp, WrapOverflow>;
+template class ArithmeticFold<MinOp, WrapOverflow>;
+
+int64_t Abs::Compute(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto cell = dynamic_cast<Cell*>(args.get());
+    if (!cell) {
+        throw RuntimeError{"Нет аргументов для abs"};
     }
-    for (size_t i = 0; i < args_list.size() - 1; ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        args_list[i + 1] = args_list[i + 1]->Eval(scope);
-        if (Is<Number>(args_list[i]) && Is<Number>(args_list[i + 1])) {
-            if (As<Number>(args_list[i])->GetValue() > As<Number>(args_list[i + 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError{"LessEquals не работает с символами"};
-        }
+    if (cell->GetSecond()) {
+        throw RuntimeError{"Неверное количество аргументов для abs"};
     }
-    return std::make_shared<Boolean>(true);
+    return std::abs(EvalNumber(cell->GetFirst(), scope, "abs"));
 }
 
-std::shared_ptr<Object> More::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Boolean>(true);
+struct EqualOp {
+    static constexpr const char* kName = "Equal";
+
+    static bool Test(int64_t lhs, int64_t rhs) {
+        return lhs == rhs;
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    if (args_list.size() == 1) {
-        args_list[0] = args_list[0]->Eval(scope);
-        if (Is<Number>(args_list[0])) {
+};
 
-            return std::make_shared<Boolean>(true);
-        } else {
-            throw RuntimeError{"More не работает с символами"};
-        }
+struct LessOp {
+    static constexpr const char* kName = "Less";
+
+    static bool Test(int64_t lhs, int64_t rhs) {
+        return lhs < rhs;
     }
-    for (size_t i = 0; i < args_list.size() - 1; ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        args_list[i + 1] = args_list[i + 1]->Eval(scope);
-        if (Is<Number>(args_list[i]) && Is<Number>(args_list[i + 1])) {
-            if (As<Number>(args_list[i])->GetValue() <= As<Number>(args_list[i + 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError{"More не работает с символами"};
-        }
+};
+
+struct LessEqualsOp {
+    static constexpr const char* kName = "LessEquals";
+
+    static bool Test(int64_t lhs, int64_t rhs) {
+        return lhs <= rhs;
     }
-    return std::make_shared<Boolean>(true);
-}
+};
 
-std::shared_ptr<Object> MoreEquals::Apply(std::shared_ptr<Object> args,
-                                          std::shared_ptr<Scope> scope) {
-    if (!args) {
-        return std::make_shared<Boolean>(true);
+struct MoreOp {
+    static constexpr const char* kName = "More";
+
+    static bool Test(int64_t lhs, int64_t rhs) {
+        return lhs > rhs;
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    if (args_list.size() == 1) {
-        args_list[0] = args_list[0]->Eval(scope);
-        if (Is<Number>(args_list[0])) {
-            return std::make_shared<Boolean>(true);
-        } else {
-            throw RuntimeError{"MoreEquals не работает с символами"};
-        }
+};
+
+struct MoreEqualsOp {
+    static constexpr const char* kName = "MoreEquals";
+
+    static bool Test(int64_t lhs, int64_t rhs) {
+        return lhs >= rhs;
     }
-    for (size_t i = 0; i < args_list.size() - 1; ++i) {
-        args_list[i] = args_list[i]->Eval(scope);
-        args_list[i + 1] = args_list[i + 1]->Eval(scope);
-        if (Is<Number>(args_list[i]) && Is<Number>(args_list[i + 1])) {
-            if (As<Number>(args_list[i])->GetValue() < As<Number>(args_list[i + 1])->GetValue()) {
-                return std::make_shared<Boolean>(false);
-            }
-        } else {
-            throw RuntimeError{"MoreEquals не работает с символами"};
+};
+
+template <class Op>
+Ref<Object> Comparison<Op>::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    auto first = dynamic_cast<Cell*>(args.get());
+    if (!first) {
+        return MakeRef<Boolean>(true);
+    }
+    int64_t previous = EvalNumber(first->GetFirst(), scope, Op::kName);
+    auto second = dynamic_cast<Cell*>(first->GetSecond().get());
+    if (!second) {
+        return MakeRef<Boolean>(true);
+    }
+    if (!second->GetSecond()) {
+        return MakeRef<Boolean>(
+            Op::Test(previous, EvalNumber(second->GetFirst(), scope, Op::kName)));
+    }
+    // Как и в исходной реализации, после первого ложного сравнения остальные аргументы
+    // не вычисляются.
+    for (auto cell = second; cell; cell = dynamic_cast<Cell*>(cell->GetSecond().get())) {
+        int64_t current = EvalNumber(cell->GetFirst(), scope, Op::kName);
+        if (!Op::Test(previous, current)) {
+            return MakeRef<Boolean>(false);
         }
+        previous = current;
     }
-    return std::make_shared<Boolean>(true);
+    return MakeRef<Boolean>(true);
 }
 
-std::shared_ptr<Object> Not::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+template class Comparison<EqualOp>;
+template class Comparison<LessOp>;
+template class Comparison<LessEqualsOp>;
+template class Comparison<MoreOp>;
+template class Comparison<MoreEqualsOp>;
+
+Ref<Object> Not::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (!args) {
         throw RuntimeError{"Нет аргументов для not"};
     }
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+    ArgumentList args_list = EvalList(args, scope);
     if (args_list.size() != 1) {
         std::string error_message = "Неверное количество аргументов для Not";
         throw RuntimeError{error_message};
     }
     if (Is<Boolean>(args_list[0])) {
         if (!As<Boolean>(args_list[0])->GetBool()) {
-            return std::make_shared<Boolean>(true);
+            return MakeRef<Boolean>(true);
         }
     }
-    return std::make_shared<Boolean>(false);
+    return MakeRef<Boolean>(false);
 }
 
-std::shared_ptr<Object> And::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> And::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (!args) {
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
 
-    std::shared_ptr<Object> operand;
+    Ref<Object> operand;
 
-    std::shared_ptr<Cell> curent = As<Cell>(args);
+    Ref<Cell> curent = As<Cell>(args);
     while (curent) {
         operand = curent->GetFirst();
         if (Is<Cell>(operand)) {
@@ -615,7 +801,7 @@ std::shared_ptr<Object> And::Apply(std::shared_ptr<Object> args, std::shared_ptr
         }
         if (Is<Boolean>(operand)) {
             if (!As<Boolean>(operand)->GetBool()) {
-                return std::make_shared<Boolean>(false);
+                return MakeRef<Boolean>(false);
             }
         }
         if (curent->GetSecond()) {
@@ -627,14 +813,14 @@ std::shared_ptr<Object> And::Apply(std::shared_ptr<Object> args, std::shared_ptr
     return operand;
 }
 
-std::shared_ptr<Object> Or::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> Or::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (!args) {
-        return std::make_shared<Boolean>(false);
+        return MakeRef<Boolean>(false);
     }
 
-    std::shared_ptr<Object> operand;
+    Ref<Object> operand;
 
-    std::shared_ptr<Cell> curent = As<Cell>(args);
+    Ref<Cell> curent = As<Cell>(args);
     while (curent) {
         operand = curent->GetFirst();
         if (Is<Cell>(operand)) {
@@ -642,7 +828,7 @@ std::shared_ptr<Object> Or::Apply(std::shared_ptr<Object> args, std::shared_ptr<
         }
         if (Is<Boolean>(operand)) {
             if (As<Boolean>(operand)->GetBool()) {
-                return std::make_shared<Boolean>(true);
+                return MakeRef<Boolean>(true);
             }
         }
         if (curent->GetSecond()) {
@@ -654,9 +840,9 @@ std::shared_ptr<Object> Or::Apply(std::shared_ptr<Object> args, std::shared_ptr<
     return operand;
 }
 
-std::shared_ptr<Object> Define::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> Define::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (args && Is<Cell>(As<Cell>(args)->GetFirst())) {
-        auto lambda = std::make_shared<Lambda>();
+        auto lambda = MakeRef<Lambda>();
         auto dec_arg = As<Cell>(As<Cell>(args)->GetFirst())->GetSecond();
         lambda->DeclarationOfArguments(dec_arg);
         lambda->SugarExpression(As<Cell>(args)->GetSecond());
@@ -665,23 +851,29 @@ std::shared_ptr<Object> Define::Apply(std::shared_ptr<Object> args, std::shared_
 
         std::string variable_name =
             As<Symbol>(As<Cell>(As<Cell>(args)->GetFirst())->GetFirst())->GetName();
+        lambda->SetName(variable_name);
         scope->SetElementScope(variable_name, lambda);
-        return std::make_shared<Boolean>(true);
+        return MakeRef<Boolean>(true);
     }
 
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+    ArgumentList args_list = EvalList(args, scope);
+    ConvertQuotedPairs(&args_list);
     if (args_list.size() != 2) {
         throw SyntaxError{"Неверное количество аргументов для Define"};
     } else if (!Is<Symbol>(args_list[0]) && !Is<Number>(args_list[1])) {
         throw SyntaxError{"Неверные аргументы для Define"};
     }
     std::string variable_name = As<Symbol>(args_list[0])->GetName();
+    if (auto lambda = As<Lambda>(args_list[1]); lambda && lambda->GetName().empty()) {
+        lambda->SetName(variable_name);
+    }
     scope->SetElementScope(variable_name, args_list[1]);
-    return std::make_shared<Boolean>(true);
+    return MakeRef<Boolean>(true);
 }
 
-std::shared_ptr<Object> Set::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> Set::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
+    ConvertQuotedPairs(&args_list);
     if (args_list.size() != 2) {
         throw SyntaxError{"Неверное количество аргументов для Set"};
     } else if (!Is<Symbol>(args_list[0]) && !Is<Number>(args_list[1])) {
@@ -690,47 +882,48 @@ std::shared_ptr<Object> Set::Apply(std::shared_ptr<Object> args, std::shared_ptr
     std::string variable_name = As<Symbol>(args_list[0])->GetName();
     scope->GetElementScope(variable_name);
     scope->SetElementScope(variable_name, args_list[1]);
-    return std::make_shared<Boolean>(true);
+    return MakeRef<Boolean>(true);
 }
 
-std::shared_ptr<Object> If::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> If::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     int number_of_arguments = NumberOfArguments(args);
     if (number_of_arguments != 2 && number_of_arguments != 3) {
         throw SyntaxError{"Неверное количество аргументов для If"};
     }
 
-    std::shared_ptr<Cell> curent = As<Cell>(args);
-    std::shared_ptr<Object> condition = curent->GetFirst()->Eval(scope);
+    Ref<Cell> curent = As<Cell>(args);
+    Ref<Object> condition = curent->GetFirst()->Eval(scope);
     if (Is<Boolean>(condition) && !As<Boolean>(condition)->GetBool()) {
         if (number_of_arguments == 2) {
-            return std::make_shared<Symbol>("()");
+            return MakeRef<Symbol>("()");
         } else {
-            std::shared_ptr<Object> cell_with_second_value =
+            Ref<Object> cell_with_second_value =
                 As<Cell>(As<Cell>(args)->GetSecond())->GetSecond();
-            std::shared_ptr<Object> second_value =
+            Ref<Object> second_value =
                 As<Cell>(cell_with_second_value)->GetFirst()->Eval(scope);
             return second_value;
         }
     } else {
-        std::shared_ptr<Object> cell_with_first_value = As<Cell>(args)->GetSecond();
-        std::shared_ptr<Object> first_value =
+        Ref<Object> cell_with_first_value = As<Cell>(args)->GetSecond();
+        Ref<Object> first_value =
             As<Cell>(cell_with_first_value)->GetFirst()->Eval(scope);
         return first_value;
     }
 }
 
-std::shared_ptr<Object> Cons::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> Cons::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
     if (args_list.size() != 2) {
         throw SyntaxError{"Неверное количество аргументов для cons"};
     }
 
-    return std::make_shared<Pair>(As<Number>(args_list[0])->GetValue(),
-                                  As<Number>(args_list[1])->GetValue());
+    return MakeRef<Pair>(As<Number>(args_list[0])->GetValue(),
+                         As<Number>(args_list[1])->GetValue());
 }
 
-std::shared_ptr<Object> Car::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> Car::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
+    ConvertQuotedPairs(&args_list);
 
     if (args_list.size() != 1) {
         throw SyntaxError{"Введена не пара"};
@@ -742,11 +935,12 @@ std::shared_ptr<Object> Car::Apply(std::shared_ptr<Object> args, std::shared_ptr
         throw SyntaxError{"Введена не пара"};
     }
 
-    return std::make_shared<Number>(As<Pair>(args_list[0])->GetElementOne());
+    return MakeRef<Number>(As<Pair>(args_list[0])->GetElementOne());
 }
 
-std::shared_ptr<Object> Cdr::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> Cdr::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
+    ConvertQuotedPairs(&args_list);
 
     if (args_list.size() != 1) {
         throw SyntaxError{"Введена не пара"};
@@ -758,11 +952,11 @@ std::shared_ptr<Object> Cdr::Apply(std::shared_ptr<Object> args, std::shared_ptr
         throw SyntaxError{"Введена не пара"};
     }
 
-    return std::make_shared<Number>(As<Pair>(args_list[0])->GetElementTwo());
+    return MakeRef<Number>(As<Pair>(args_list[0])->GetElementTwo());
 }
 
-std::shared_ptr<Object> SetCar::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> SetCar::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
 
     if (args_list.size() != 2) {
         throw SyntaxError{"Неверное количество аргументов для set-car!"};
@@ -773,17 +967,21 @@ std::shared_ptr<Object> SetCar::Apply(std::shared_ptr<Object> args, std::shared_
 
     std::string variable_name = As<Symbol>(args_list[0])->GetName();
 
-    auto pair = scope->GetElementScope(variable_name);
+    auto cell = scope->FindCellForUpdate(variable_name);
+    if (!cell) {
+        throw NameError{variable_name + " такого элемента нет!"};
+    }
+    auto pair = *cell;
     if (Is<Pair>(pair)) {
         As<Pair>(pair)->SetElementOne(As<Number>(args_list[1])->GetValue());
     } else {
         throw RuntimeError{"Неверные аргументы для set-car!"};
     }
-    return std::make_shared<Boolean>(true);
+    return MakeRef<Boolean>(true);
 }
 
-std::shared_ptr<Object> SetCdr::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
+Ref<Object> SetCdr::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list = EvalList(args, scope);
 
     if (args_list.size() != 2) {
         throw SyntaxError{"Неверное количество аргументов для set-car!"};
@@ -794,141 +992,134 @@ std::shared_ptr<Object> SetCdr::Apply(std::shared_ptr<Object> args, std::shared_
 
     std::string variable_name = As<Symbol>(args_list[0])->GetName();
 
-    auto pair = scope->GetElementScope(variable_name);
+    auto cell = scope->FindCellForUpdate(variable_name);
+    if (!cell) {
+        throw NameError{variable_name + " такого элемента нет!"};
+    }
+    auto pair = *cell;
     if (Is<Pair>(pair)) {
         As<Pair>(pair)->SetElementTwo(As<Number>(args_list[1])->GetValue());
     } else {
         throw RuntimeError{"Неверные аргументы для set-car!"};
     }
-    return std::make_shared<Boolean>(true);
+    return MakeRef<Boolean>(true);
 }
 
-std::shared_ptr<Object> List::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> List::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (!args) {
-        return std::make_shared<Symbol>("()");
+        return MakeRef<Symbol>("()");
     }
 
-    std::vector<std::shared_ptr<Object>> args_list = EvalList(args, scope);
-    return std::make_shared<ListObj>(args_list);
+    ArgumentList args_list = EvalList(args, scope);
+    return MakeRef<ListObj>(
+        std::vector<Ref<Object>>(args_list.begin(), args_list.end()));
 }
 
-std::shared_ptr<Object> ListRef::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> ListRef::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (!args) {
-        return std::make_shared<Symbol>("()");
+        return MakeRef<Symbol>("()");
     }
     int pos = As<Number>(As<Cell>(As<Cell>(args)->GetSecond())->GetFirst())->GetValue();
-    std::vector<std::shared_ptr<Object>> args_list =
+    ArgumentList args_list =
         EvalList(As<Cell>(As<Cell>(As<Cell>(args)->GetFirst())->GetSecond())->GetFirst(), scope);
     if (pos >= static_cast<int>(args_list.size())) {
         throw RuntimeError{"Вышли за диапозон list"};
     }
-    return std::make_shared<Symbol>(std::to_string(As<Number>(args_list[pos])->GetValue()));
+    return MakeRef<Symbol>(std::to_string(As<Number>(args_list[pos])->GetValue()));
 }
 
-std::shared_ptr<Object> ListTail::Apply(std::shared_ptr<Object> args,
-                                        std::shared_ptr<Scope> scope) {
+Ref<Object> ListTail::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     if (!args) {
-        return std::make_shared<Symbol>("()");
+        return MakeRef<Symbol>("()");
     }
     int pos = As<Number>(As<Cell>(As<Cell>(args)->GetSecond())->GetFirst())->GetValue();
-    std::vector<std::shared_ptr<Object>> args_list =
+    ArgumentList args_list =
         EvalList(As<Cell>(As<Cell>(As<Cell>(args)->GetFirst())->GetSecond())->GetFirst(), scope);
 
     if (pos > static_cast<int>(args_list.size())) {
         throw RuntimeError{"Вышли за диапозон list"};
     } else if (pos == static_cast<int>(args_list.size())) {
-        return std::make_shared<Symbol>("()");
+        return MakeRef<Symbol>("()");
     }
-    std::vector<std::shared_ptr<Object>> res;
+    std::vector<Ref<Object>> res;
     for (int i = pos; i < static_cast<int>(args_list.size()); ++i) {
         res.push_back(args_list[i]);
     }
-    return std::make_shared<ListObj>(res);
+    return MakeRef<ListObj>(res);
 }
 
-Lambda::Lambda() : scope_(std::make_shared<Scope>()) {
-    scope_->SetElementScope("quote", std::make_shared<QuoteSpecForm>());
-
-    scope_->SetElementScope("number?", std::make_shared<NumberQ>());
-    scope_->SetElementScope("boolean?", std::make_shared<BooleanQ>());
-    scope_->SetElementScope("symbol?", std::make_shared<SymbolQ>());
-    scope_->SetElementScope("pair?", std::make_shared<PairQ>());
-    scope_->SetElementScope("null?", std::make_shared<NullQ>());
-    scope_->SetElementScope("list?", std::make_shared<ListQ>());
-
-    scope_->SetElementScope("=", std::make_shared<Equal>());
-    scope_->SetElementScope("<", std::make_shared<Less>());
-    scope_->SetElementScope("<=", std::make_shared<LessEquals>());
-    scope_->SetElementScope(">", std::make_shared<More>());
-    scope_->SetElementScope(">=", std::make_shared<MoreEquals>());
-
-    scope_->SetElementScope("+", std::make_shared<Plus>());
-    scope_->SetElementScope("-", std::make_shared<Minus>());
-    scope_->SetElementScope("/", std::make_shared<Division>());
-    scope_->SetElementScope("*", std::make_shared<Multiplication>());
-
-    scope_->SetElementScope("max", std::make_shared<Max>());
-    scope_->SetElementScope("min", std::make_shared<Min>());
-    scope_->SetElementScope("abs", std::make_shared<Abs>());
-
-    scope_->SetElementScope("not", std::make_shared<Not>());
-    scope_->SetElementScope("and", std::make_shared<And>());
-    scope_->SetElementScope("or", std::make_shared<Or>());
+Ref<Object> RuntimeStatsReport::Apply(const Ref<Object>& args, const Ref<Scope>&) {
+    if (args) {
+        throw RuntimeError{"runtime-stats не принимает аргументов"};
+    }
+    return MakeRef<Symbol>(TakeStats().ToString());
+}
 
-    scope_->SetElementScope("define", std::make_shared<Define>());
-    scope_->SetElementScope("set!", std::make_shared<Set>());
+Ref<Object> RuntimeStatsReset::Apply(const Ref<Object>& args, const Ref<Scope>&) {
+    if (args) {
+        throw RuntimeError{"runtime-stats-reset не принимает аргументов"};
+    }
+    ResetStats();
+    return MakeRef<Boolean>(true);
+}
 
-    scope_->SetElementScope("if", std::make_shared<If>());
+Ref<Object> ProfileReport::Apply(const Ref<Object>& args, const Ref<Scope>&) {
+    if (args) {
+        throw RuntimeError{"profile-report не принимает аргументов"};
+    }
+    Profiler* profiler = Profiler::Active();
+    if (!profiler) {
+        throw RuntimeError{"Профилировщик не включён"};
+    }
+    return MakeRef<Symbol>(profiler->Report());
+}
 
-    scope_->SetElementScope("cons", std::make_shared<Cons>());
-    scope_->SetElementScope("car", std::make_shared<Car>());
-    scope_->SetElementScope("cdr", std::make_shared<Cdr>());
-    scope_->SetElementScope("set-car!", std::make_shared<SetCar>());
-    scope_->SetElementScope("set-cdr!", std::make_shared<SetCdr>());
+Lambda::Lambda() : scope_(MakeRef<Scope>()) {
+    AddBuiltins(scope_);
+}
 
-    scope_->SetElementScope("list", std::make_shared<List>());
-    scope_->SetElementScope("list-ref", std::make_shared<ListRef>());
-    scope_->SetElementScope("list-tail", std::make_shared<ListTail>());
+Lambda::Lambda(const Ref<Scope>& scope) : scope_(scope) {
 }
 
-void Lambda::DeclarationOfArguments(std::shared_ptr<Object> args) {
+void Lambda::DeclarationOfArguments(const Ref<Object>& args) {
     std::string name_of_variables;
-    while (args) {
-        name_of_variables = As<Symbol>(As<Cell>(args)->GetFirst())->GetName();
+    Ref<Object> curent = args;
+    while (curent) {
+        name_of_variables = As<Symbol>(As<Cell>(curent)->GetFirst())->GetName();
         arguments_.push_back(name_of_variables);
-        scope_->SetElementScope(name_of_variables, std::make_shared<Number>(0));
-        args = As<Cell>(args)->GetSecond();
+        scope_->SetElementScope(name_of_variables, MakeRef<Number>(0));
+        curent = As<Cell>(curent)->GetSecond();
     }
 }
 
-void Lambda::DefinitionOfArguments(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
-    for (auto argument : arguments_) {
-        auto values = As<Cell>(args)->GetFirst()->Eval(scope);
+void Lambda::DefinitionOfArguments(const Ref<Object>& args, const Ref<Scope>& scope) {
+    Ref<Object> curent = args;
+    for (const auto& argument : arguments_) {
+        auto values = As<Cell>(curent)->GetFirst()->Eval(scope);
         scope_->SetElementScope(argument, values);
-        args = As<Cell>(args)->GetSecond();
+        curent = As<Cell>(curent)->GetSecond();
     }
 }
 
-void Lambda::SugarExpression(std::shared_ptr<Object> expression) {
+void Lambda::SugarExpression(const Ref<Object>& expression) {
     expression_.push_back(As<Cell>(expression)->GetFirst());
 }
 
-std::shared_ptr<Object> Lambda::Defines(std::shared_ptr<Object> args,
-                                        std::shared_ptr<Scope> scope) {
+Ref<Object> Lambda::Defines(const Ref<Object>& args, const Ref<Scope>& scope) {
     int number_of_arguments = NumberOfArguments(args);
-    std::shared_ptr<Object> arguments = As<Cell>(args)->GetFirst();
+    Ref<Object> arguments = As<Cell>(args)->GetFirst();
     DeclarationOfArguments(arguments);
     scope_->SetParentScope(scope);
-    args = As<Cell>(args)->GetSecond();
+    Ref<Object> curent = As<Cell>(args)->GetSecond();
     for (int i = 1; i < number_of_arguments; ++i) {
-        expression_.push_back(As<Cell>(args)->GetFirst());
-        args = As<Cell>(args)->GetSecond();
+        expression_.push_back(As<Cell>(curent)->GetFirst());
+        curent = As<Cell>(curent)->GetSecond();
     }
     flag_ = "defined";
-    return shared_from_this();
+    return Ref<Object>(this);
 }
 
-std::shared_ptr<Object> Lambda::Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope) {
+Ref<Object> Lambda::Apply(const Ref<Object>& args, const Ref<Scope>& scope) {
     int number_of_arguments = NumberOfArguments(args);
     if (flag_ == "undefined" && number_of_arguments <= 1) {
         throw SyntaxError{"Неверное количество аргументов для Lambda"};
@@ -937,6 +1128,7 @@ std::shared_ptr<Object> Lambda::Apply(std::shared_ptr<Object> args, std::shared_
         Defines(args, scope);
     } else if (flag_ == "defined") {
         DefinitionOfArguments(args, scope);
+        ShadowFrame frame{name_};
         for (size_t i = 0; i < expression_.size(); ++i) {
             if (i + 1 == expression_.size()) {
                 return expression_[i]->Eval(scope_);
@@ -944,11 +1136,43 @@ std::shared_ptr<Object> Lambda::Apply(std::shared_ptr<Object> args, std::shared_
             expression_[i]->Eval(scope_);
         }
     }
-    return shared_from_this();
+    return Ref<Object>(this);
 }
 
-int NumberOfArguments(std::shared_ptr<Object> args) {
-    std::shared_ptr<Cell> curent = As<Cell>(args);
+const std::vector<std::string>& Lambda::GetArguments() const {
+    return arguments_;
+}
+
+const Ref<Scope>& Lambda::GetScope() const {
+    return scope_;
+}
+
+const std::vector<Ref<Object>>& Lambda::GetExpressions() const {
+    return expression_;
+}
+
+const std::string& Lambda::GetFlag() const {
+    return flag_;
+}
+
+void Lambda::SetName(const std::string& name) {
+    name_ = InternName(name);
+}
+
+const std::string& Lambda::GetName() const {
+    static const std::string kAnonymous;
+    return name_ ? *name_ : kAnonymous;
+}
+
+void Lambda::Restore(std::vector<std::string> arguments,
+                     std::vector<Ref<Object>> expression, std::string flag) {
+    arguments_ = arguments;
+    expression_ = expression;
+    flag_ = flag;
+}
+
+int NumberOfArguments(const Ref<Object>& args) {
+    Ref<Cell> curent = As<Cell>(args);
     int number_of_arguments = 0;
     while (curent) {
         ++number_of_arguments;
@@ -957,11 +1181,48 @@ int NumberOfArguments(std::shared_ptr<Object> args) {
     return number_of_arguments;
 }
 
-std::vector<std::shared_ptr<Object>> EvalList(std::shared_ptr<Object> args,
-                                              std::shared_ptr<Scope> scope) {
-    std::vector<std::shared_ptr<Object>> args_list;
-    std::vector<std::shared_ptr<Object>> args_list_new;
-    std::shared_ptr<Cell> curent = As<Cell>(args);
+ArgumentList::ArgumentList(ArgumentList&& other) noexcept
+    : heap_(std::move(other.heap_)), size_(other.size_) {
+    if (heap_.empty()) {
+        std::move(other.inline_.begin(), other.inline_.begin() + size_, inline_.begin());
+    }
+    other.size_ = 0;
+}
+
+void ArgumentList::push_back(Ref<Object> value) {
+    if (size_ < kInlineSize) {
+        inline_[size_++] = std::move(value);
+        return;
+    }
+    if (size_ == kInlineSize) {
+        heap_.reserve(2 * kInlineSize);
+        for (auto& element : inline_) {
+            heap_.push_back(std::move(element));
+        }
+    }
+    heap_.push_back(std::move(value));
+    ++size_;
+}
+
+size_t ArgumentList::size() const {
+    return size_;
+}
+
+Ref<Object>& ArgumentList::operator[](size_t index) {
+    return begin()[index];
+}
+
+Ref<Object>* ArgumentList::begin() {
+    return size_ > kInlineSize ? heap_.data() : inline_.data();
+}
+
+Ref<Object>* ArgumentList::end() {
+    return begin() + size_;
+}
+
+ArgumentList EvalList(const Ref<Object>& args, const Ref<Scope>& scope) {
+    ArgumentList args_list;
+    Ref<Cell> curent = As<Cell>(args);
     while (curent) {
         if (Is<Cell>(curent->GetFirst())) {
             args_list.push_back(curent->GetFirst()->Eval(scope));
@@ -978,26 +1239,140 @@ std::vector<std::shared_ptr<Object>> EvalList(std::shared_ptr<Object> args,
             break;
         }
     }
+    return args_list;
+}
 
-    for (size_t i = 0; i < args_list.size(); ++i) {
-        if (Is<Cell>(args_list[i])) {
-            auto current = As<Cell>(args_list[i])->GetFirst();
-            auto first = As<Cell>(current)->GetFirst();
-            auto second = As<Cell>(current)->GetSecond();
-            if (Is<Number>(first) && Is<Number>(second)) {
-                args_list_new.push_back(std::make_shared<Pair>(As<Number>(first)->GetValue(),
-                                                               As<Number>(second)->GetValue()));
-            } else if (Is<Number>(first) && Is<Number>(As<Cell>(second)->GetFirst())) {
-                args_list_new.push_back(
-                    std::make_shared<Pair>(As<Number>(first)->GetValue(),
-                                           As<Number>(As<Cell>(second)->GetFirst())->GetValue()));
-            } else {
-                args_list_new.push_back(args_list[i]);
-            }
-        } else {
-            args_list_new.push_back(args_list[i]);
+std::vector<Ref<Object>> EvalArguments(const Ref<Object>& args, const Ref<Scope>& scope) {
+    std::vector<Ref<Object>> values;
+    for (auto cell = As<Cell>(args); cell; cell = As<Cell>(cell->GetSecond())) {
+        values.push_back(cell->GetFirst() ? cell->GetFirst()->Eval(scope) : nullptr);
+    }
+    return values;
+}
+
+void ConvertQuotedPairs(ArgumentList* args) {
+    for (auto& arg : *args) {
+        if (!Is<Cell>(arg)) {
+            continue;
+        }
+        auto current = As<Cell>(arg)->GetFirst();
+        auto first = As<Cell>(current)->GetFirst();
+        auto second = As<Cell>(current)->GetSecond();
+        if (Is<Number>(first) && Is<Number>(second)) {
+            arg = MakeRef<Pair>(As<Number>(first)->GetValue(),
+                                As<Number>(second)->GetValue());
+        } else if (Is<Number>(first) && Is<Number>(As<Cell>(second)->GetFirst())) {
+            arg = MakeRef<Pair>(As<Number>(first)->GetValue(),
+                                As<Number>(As<Cell>(second)->GetFirst())->GetValue());
+        }
+    }
+}
+
+namespace {
+
+template <class T>
+Ref<Object> MakeObject() {
+    return MakeRef<T>();
+}
+
+using BuiltinFactory = Ref<Object> (*)();
+
+const std::vector<std::pair<std::string, BuiltinFactory>>& BuiltinTable() {
+    static const std::vector<std::pair<std::string, BuiltinFactory>> kBuiltins = {
+        {"quote", MakeObject<QuoteSpecForm>},
+
+        {"number?", MakeObject<NumberQ>},
+        {"boolean?", MakeObject<BooleanQ>},
+        {"symbol?", MakeObject<SymbolQ>},
+        {"pair?", MakeObject<PairQ>},
+        {"null?", MakeObject<NullQ>},
+        {"list?", MakeObject<ListQ>},
+
+        {"=", MakeObject<Equal>},
+        {"<", MakeObject<Less>},
+        {"<=", MakeObject<LessEquals>},
+        {">", MakeObject<More>},
+        {">=", MakeObject<MoreEquals>},
+
+        {"+", MakeObject<Plus>},
+        {"-", MakeObject<Minus>},
+        {"/", MakeObject<Division>},
+        {"*", MakeObject<Multiplication>},
+
+        {"max", MakeObject<Max>},
+        {"min", MakeObject<Min>},
+        {"abs", MakeObject<Abs>},
+
+        {"not", MakeObject<Not>},
+        {"and", MakeObject<And>},
+        {"or", MakeObject<Or>},
+
+        {"define", MakeObject<Define>},
+        {"set!", MakeObject<Set>},
+
+        {"if", MakeObject<If>},
+
+        {"cons", MakeObject<Cons>},
+        {"car", MakeObject<Car>},
+        {"cdr", MakeObject<Cdr>},
+        {"set-car!", MakeObject<SetCar>},
+        {"set-cdr!", MakeObject<SetCdr>},
+
+        {"list", MakeObject<List>},
+        {"list-ref", MakeObject<ListRef>},
+        {"list-tail", MakeObject<ListTail>},
+
+        {"future", MakeObject<FutureSpecForm>},
+        {"touch", MakeObject<Touch>},
+        {"parallel-map", MakeObject<ParallelMap>},
+
+        {"make-channel", MakeObject<MakeChannel>},
+        {"channel-send!", MakeObject<ChannelSend>},
+        {"channel-receive", MakeObject<ChannelReceive>},
+
+        {"runtime-stats", MakeObject<RuntimeStatsReport>},
+        {"runtime-stats-reset", MakeObject<RuntimeStatsReset>},
+        {"profile-report", MakeObject<ProfileReport>},
+    };
+    return kBuiltins;
+}
+
+}  // namespace
+
+void AddBuiltins(const Ref<Scope>& scope) {
+    for (const auto& [name, factory] : BuiltinTable()) {
+        scope->SetElementScope(name, factory());
+    }
+}
+
+Ref<Object> MakeBuiltin(const std::string& name) {
+    for (const auto& [builtin_name, factory] : BuiltinTable()) {
+        if (builtin_name == name) {
+            return factory();
         }
     }
+    return nullptr;
+}
+
+std::string BuiltinName(const Ref<Object>& obj) {
+    if (!obj) {
+        return "";
+    }
+    return BuiltinName(typeid(*obj));
+}
 
-    return args_list_new;
+std::string BuiltinName(const std::type_info& type) {
+    static const std::map<std::type_index, std::string> kNames = [] {
+        std::map<std::type_index, std::string> names;
+        for (const auto& [name, factory] : BuiltinTable()) {
+            auto builtin = factory();
+            names[typeid(*builtin)] = name;
+        }
+        return names;
+    }();
+    auto it = kNames.find(type);
+    if (it == kNames.end()) {
+        return "";
+    }
+    return it->second;
 }
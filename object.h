@@ -2,31 +2,166 @@
 
 #include <iostream>
 #include <vector>
-#include <memory>
 #include <map>
+#include <atomic>
+#include <array>
+#include <unordered_map>
 
 #include "error.h"
+#include "ref.h"
 
 class Object;
+class Scope;
 
-class Scope {
+// Получает изменения, которые вычисления в этом потоке вносят на месте в привязки
+// областей и в пары, пока наблюдатель активен (см. ImageJournalWriter).
+class ChangeObserver {
 public:
-    void SetParentScope(std::shared_ptr<Scope> parent_scope);
+    virtual void BindingChanged(Scope* scope, const std::string& name) = 0;
 
-    void SetElementScope(std::string symbol, std::shared_ptr<Object> object);
+    virtual void ObjectChanged(Object* object) = 0;
 
-    std::shared_ptr<Object> GetElementScope(std::string symbol);
+    static ChangeObserver* Active() {
+        return active;
+    }
+
+    class Activation {
+    public:
+        explicit Activation(ChangeObserver* observer);
+
+        ~Activation();
+
+        Activation(const Activation&) = delete;
+        Activation& operator=(const Activation&) = delete;
+
+    private:
+        ChangeObserver* previous_;
+    };
+
+protected:
+    ~ChangeObserver() = default;
+
+private:
+    static thread_local ChangeObserver* active;
+};
+
+// Значения хранятся в узлах хеш-таблицы, адреса которых не меняются, поэтому на
+// ячейку можно ссылаться, пока не изменились Version() области, с которой начинался
+// поиск, общая Epoch() и ActiveGlobalsId() потока.
+class Scope : public RefCounted {
+public:
+    ~Scope();
+
+    void SetParentScope(const Ref<Scope>& parent_scope);
+
+    const Ref<Scope>& GetParentScope() const;
+
+    const std::unordered_map<std::string, Ref<Object>>& GetElements() const;
+
+    void SetElementScope(const std::string& symbol, const Ref<Object>& object);
+
+    // Удаляет все привязки области, например чтобы разорвать цикл с лямбдами в ней.
+    void Clear();
+
+    // Как Clear, но не сбрасывает кэши символов всех потоков: область и её потомки
+    // больше не вычисляются, поэтому на их ячейки никто не сошлётся.
+    void Discard();
+
+    Ref<Object> GetElementScope(const std::string& symbol);
+
+    Ref<Object>* FindCell(const std::string& symbol);
+
+    // Ячейка для изменения значения на месте (set-car!, set-cdr!). Пара из замороженной
+    // области сначала копируется в глобальную область текущего интерпретатора.
+    Ref<Object>* FindCellForUpdate(const std::string& symbol);
+
+    // Замороженную область делят интерпретатор и его клоны (см. Scheme::Clone). Поиск,
+    // дошедший до неё, сначала проходит глобальную область текущего интерпретатора,
+    // поэтому его собственные привязки перекрывают общие.
+    void Freeze();
+
+    bool IsFrozen() const;
+
+    // Разрешает запись в замороженную область на время жизни объекта: так её обновляет
+    // владелец (см. SharedEnvironment::Replica).
+    class Thaw {
+    public:
+        explicit Thaw(Scope* scope);
+
+        ~Thaw();
+
+        Thaw(const Thaw&) = delete;
+        Thaw& operator=(const Thaw&) = delete;
+
+    private:
+        Scope* scope_;
+        bool frozen_;
+    };
+
+    // Глобальная область интерпретатора, который вычисляет в этом потоке, на время
+    // жизни объекта.
+    class ActiveGlobals {
+    public:
+        explicit ActiveGlobals(Scope* globals);
+
+        ~ActiveGlobals();
+
+        ActiveGlobals(const ActiveGlobals&) = delete;
+        ActiveGlobals& operator=(const ActiveGlobals&) = delete;
+
+    private:
+        Scope* previous_;
+    };
+
+    // Через замороженную область одна и та же область разрешается по-разному у разных
+    // интерпретаторов, поэтому результат поиска зависит и от активной глобальной
+    // области. Номер не повторяется: новая область может занять адрес удалённой.
+    static uint64_t ActiveGlobalsId() {
+        return active_globals_id;
+    }
+
+    // Меняется при новой привязке в этой области или смене родителя. Версии не
+    // повторяются ни у одной области, поэтому новая область по адресу удалённой не
+    // совпадёт с её кэшами.
+    uint64_t Version() const {
+        return version_;
+    }
+
+    // Меняется, когда новая привязка перекрывает одноимённую выше по цепочке у
+    // области с потомками, при смене родителя такой области и при заморозке.
+    static uint64_t Epoch() {
+        return epoch_.load(std::memory_order_relaxed);
+    }
 
 private:
-    std::map<std::string, std::shared_ptr<Object>> scope_;
-    std::shared_ptr<Scope> parent_scope_ = nullptr;
+    static void Invalidate() {
+        epoch_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static uint64_t NextVersion();
+
+    Ref<Object>* FindCell(const std::string& symbol, Scope** owner);
+
+    std::unordered_map<std::string, Ref<Object>> scope_;
+    Ref<Scope> parent_scope_ = nullptr;
+    const uint64_t id_ = NextVersion();
+    uint64_t version_ = id_;
+    // Поиск из другой области может пройти через эту: она чей-то родитель или
+    // глобальная область интерпретатора, куда перенаправляет замороженная область.
+    bool has_children_ = false;
+    bool frozen_ = false;
+
+    static std::atomic<uint64_t> epoch_;
+    static std::atomic<uint64_t> next_version_;
+    static thread_local Scope* active_globals;
+    static thread_local uint64_t active_globals_id;
 };
 
-class Object : public std::enable_shared_from_this<Object> {
+class Object : public RefCounted {
 public:
-    virtual std::shared_ptr<Object> Eval(std::shared_ptr<Scope>);
+    virtual Ref<Object> Eval(const Ref<Scope>&);
 
-    virtual std::shared_ptr<Object> Apply(std::shared_ptr<Object>, std::shared_ptr<Scope>);
+    virtual Ref<Object> Apply(const Ref<Object>&, const Ref<Scope>&);
 
     virtual std::string Print();
 
@@ -35,13 +170,13 @@ public:
 
 class Number : public Object {
 public:
-    Number(int value);
+    Number(int64_t value);
 
-    std::shared_ptr<Object> Eval(std::shared_ptr<Scope>) override;
+    Ref<Object> Eval(const Ref<Scope>&) override;
 
     std::string Print() override;
 
-    int GetValue() const;
+    int64_t GetValue() const;
 
 private:
     int64_t value_;
@@ -49,23 +184,30 @@ private:
 
 class Symbol : public Object {
 public:
-    Symbol(std::string name);
+    Symbol(const std::string& name);
 
-    std::shared_ptr<Object> Eval(std::shared_ptr<Scope> scope) override;
+    Ref<Object> Eval(const Ref<Scope>& scope) override;
 
     std::string Print() override;
 
+    size_t HeapExtraBytes() const;
+
     const std::string& GetName() const;
 
 private:
     std::string name_;
+    Scope* cached_scope_ = nullptr;
+    Ref<Object>* cached_cell_ = nullptr;
+    uint64_t cached_version_ = 0;
+    uint64_t cached_epoch_ = 0;
+    uint64_t cached_globals_ = 0;
 };
 
 class Boolean : public Object {
 public:
     Boolean(bool name);
 
-    std::shared_ptr<Object> Eval(std::shared_ptr<Scope>) override;
+    Ref<Object> Eval(const Ref<Scope>&) override;
 
     const bool& GetBool() const;
 
@@ -77,353 +219,407 @@ private:
 
 class Pair : public Object {
 public:
-    Pair(int element_one, int element_two);
+    Pair(int64_t element_one, int64_t element_two);
 
     std::string Print() override;
 
-    void SetElementOne(int element_one);
+    void SetElementOne(int64_t element_one);
 
-    void SetElementTwo(int element_two);
+    void SetElementTwo(int64_t element_two);
 
-    const int& GetElementOne() const;
+    const int64_t& GetElementOne() const;
 
-    const int& GetElementTwo() const;
+    const int64_t& GetElementTwo() const;
 
 private:
-    int element_one_;
-    int element_two_;
+    int64_t element_one_;
+    int64_t element_two_;
 };
 
 class ListObj : public Object {
 public:
-    ListObj(std::vector<std::shared_ptr<Object>> object_shared_ptr);
+    ListObj(std::vector<Ref<Object>> object_shared_ptr);
 
     std::string Print() override;
 
+    const std::vector<Ref<Object>>& GetElements() const;
+
+    void SetElements(std::vector<Ref<Object>> object_shared_ptr);
+
+    size_t HeapExtraBytes() const;
+
 private:
-    std::vector<std::shared_ptr<Object>> object_shared_ptr_;
+    std::vector<Ref<Object>> object_shared_ptr_;
 };
 
 class Cell : public Object {
 public:
     Cell();
 
-    Cell(std::shared_ptr<Object> first, std::shared_ptr<Object> second);
+    Cell(const Ref<Object>& first, const Ref<Object>& second);
 
-    std::shared_ptr<Object> Eval(std::shared_ptr<Scope> scope) override;
+    Ref<Object> Eval(const Ref<Scope>& scope) override;
 
     std::string Print() override;
 
-    std::shared_ptr<Object> GetFirst() const;
+    const Ref<Object>& GetFirst() const;
 
-    std::shared_ptr<Object> GetSecond() const;
+    const Ref<Object>& GetSecond() const;
 
-    void SetFirst(std::shared_ptr<Object> first);
+    void SetFirst(const Ref<Object>& first);
 
-    void SetSecond(std::shared_ptr<Object> second);
+    void SetSecond(const Ref<Object>& second);
+
+    // Позиция открывающей скобки формы в исходном тексте.
+    SourcePosition GetPosition() const;
+
+    void SetPosition(SourcePosition position);
 
 private:
-    std::shared_ptr<Object> first_;
-    std::shared_ptr<Object> second_;
+    Ref<Object> first_;
+    Ref<Object> second_;
+    SourcePosition position_;
 };
 
 class QuoteSpecForm : public Object {
 public:
     QuoteSpecForm() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>&) override;
 };
 
 class NumberQ : public Object {
 public:
     NumberQ() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class SymbolQ : public Object {
 public:
     SymbolQ() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class BooleanQ : public Object {
 public:
     BooleanQ() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class PairQ : public Object {
 public:
     PairQ() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>&) override;
 };
 
 class NullQ : public Object {
 public:
     NullQ() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>&) override;
 };
 
 class ListQ : public Object {
 public:
     ListQ() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args, std::shared_ptr<Scope>) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>&) override;
 };
 
-class Plus : public Object {
+// Встроенная функция с целочисленным результатом. Compute не упаковывает результат
+// в Number, поэтому вложенная арифметика вычисляется без промежуточных объектов.
+class NumericBuiltin : public Object {
 public:
-    Plus() = default;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    virtual int64_t Compute(const Ref<Object>& args, const Ref<Scope>& scope) = 0;
 };
 
-class Minus : public Object {
-public:
-    Minus() = default;
+int64_t EvalNumber(const Ref<Object>& arg, const Ref<Scope>& scope, const char* name);
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+struct AddOp;
+struct SubtractOp;
+struct MultiplyOp;
+struct DivideOp;
+struct MaxOp;
+struct MinOp;
 
-class Multiplication : public Object {
-public:
-    Multiplication() = default;
+struct EqualOp;
+struct LessOp;
+struct LessEqualsOp;
+struct MoreOp;
+struct MoreEqualsOp;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+// Политика переполнения: результат берётся по модулю 2^64.
+struct WrapOverflow;
 
-class Division : public Object {
+// Левая свёртка аргументов операцией Op, с отдельными ветками для одного и двух аргументов.
+template <class Op, class OverflowPolicy>
+class ArithmeticFold : public NumericBuiltin {
 public:
-    Division() = default;
-
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    int64_t Compute(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
-class Max : public Object {
+// Цепочка попарных сравнений (a Op b) и (b Op c) и т.д.
+template <class Op>
+class Comparison : public Object {
 public:
-    Max() = default;
-
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
-class Min : public Object {
-public:
-    Min() = default;
+class Plus : public ArithmeticFold<AddOp, WrapOverflow> {};
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+class Minus : public ArithmeticFold<SubtractOp, WrapOverflow> {};
 
-class Abs : public Object {
-public:
-    Abs() = default;
+class Multiplication : public ArithmeticFold<MultiplyOp, WrapOverflow> {};
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+class Division : public ArithmeticFold<DivideOp, WrapOverflow> {};
 
-class Equal : public Object {
-public:
-    Equal() = default;
+class Max : public ArithmeticFold<MaxOp, WrapOverflow> {};
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+class Min : public ArithmeticFold<MinOp, WrapOverflow> {};
 
-class Less : public Object {
+class Abs : public NumericBuiltin {
 public:
-    Less() = default;
+    Abs() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    int64_t Compute(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
-class LessEquals : public Object {
-public:
-    LessEquals() = default;
+class Equal : public Comparison<EqualOp> {};
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+class Less : public Comparison<LessOp> {};
 
-class More : public Object {
-public:
-    More() = default;
+class LessEquals : public Comparison<LessEqualsOp> {};
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+class More : public Comparison<MoreOp> {};
 
-class MoreEquals : public Object {
-public:
-    MoreEquals() = default;
-
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
-};
+class MoreEquals : public Comparison<MoreEqualsOp> {};
 
 class Not : public Object {
 public:
     Not() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class And : public Object {
 public:
     And() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class Or : public Object {
 public:
     Or() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class Define : public Object {
 public:
     Define() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+int NumberOfArguments(const Ref<Object>& args);
+
+// Вычисленные аргументы встроенной функции. Первые kInlineSize аргументов лежат
+// внутри объекта, при большем количестве все аргументы переносятся в кучу.
+class ArgumentList {
+public:
+    static constexpr size_t kInlineSize = 8;
+
+    ArgumentList() = default;
+
+    ArgumentList(ArgumentList&& other) noexcept;
+
+    ArgumentList(const ArgumentList&) = delete;
+    ArgumentList& operator=(const ArgumentList&) = delete;
+
+    void push_back(Ref<Object> value);
+
+    size_t size() const;
+
+    Ref<Object>& operator[](size_t index);
+
+    Ref<Object>* begin();
+
+    Ref<Object>* end();
+
+private:
+    std::array<Ref<Object>, kInlineSize> inline_;
+    std::vector<Ref<Object>> heap_;
+    size_t size_ = 0;
 };
 
-int NumberOfArguments(std::shared_ptr<Object> args);
+ArgumentList EvalList(const Ref<Object>& args, const Ref<Scope>& scope);
+
+// В отличие от EvalList вычисляет каждый аргумент, включая символы.
+std::vector<Ref<Object>> EvalArguments(const Ref<Object>& args, const Ref<Scope>& scope);
 
-std::vector<std::shared_ptr<Object>> EvalList(std::shared_ptr<Object> args,
-                                              std::shared_ptr<Scope> scope);
+// Заменяет аргументы вида '(a . b) с числами на Pair. Вызывается только теми
+// встроенными функциями, которые работают с парами.
+void ConvertQuotedPairs(ArgumentList* args);
 
 class Set : public Object {
 public:
     Set() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class If : public Object {
 public:
     If() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class Cons : public Object {
 public:
     Cons() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class Car : public Object {
 public:
     Car() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class Cdr : public Object {
 public:
     Cdr() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class SetCar : public Object {
 public:
     SetCar() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class SetCdr : public Object {
 public:
     SetCdr() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class List : public Object {
 public:
     List() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class ListRef : public Object {
 public:
     ListRef() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class ListTail : public Object {
 public:
     ListTail() = default;
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+// (runtime-stats): счётчики текущего потока в виде символа.
+class RuntimeStatsReport : public Object {
+public:
+    RuntimeStatsReport() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+// (runtime-stats-reset): обнуляет счётчики текущего потока.
+class RuntimeStatsReset : public Object {
+public:
+    RuntimeStatsReset() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+};
+
+// (profile-report): таблица активного профилировщика в виде символа.
+class ProfileReport : public Object {
+public:
+    ProfileReport() = default;
+
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
 };
 
 class Lambda : public Object {
 public:
     Lambda();
 
-    void SugarExpression(std::shared_ptr<Object> expression);
+    explicit Lambda(const Ref<Scope>& scope);
 
-    void DeclarationOfArguments(std::shared_ptr<Object> variables);
+    void SugarExpression(const Ref<Object>& expression);
 
-    void DefinitionOfArguments(std::shared_ptr<Object> variables, std::shared_ptr<Scope> scope);
+    void DeclarationOfArguments(const Ref<Object>& variables);
 
-    std::shared_ptr<Object> Defines(std::shared_ptr<Object> args, std::shared_ptr<Scope> scope);
+    void DefinitionOfArguments(const Ref<Object>& variables, const Ref<Scope>& scope);
 
-    std::shared_ptr<Object> Apply(std::shared_ptr<Object> args,
-                                  std::shared_ptr<Scope> scope) override;
+    Ref<Object> Defines(const Ref<Object>& args, const Ref<Scope>& scope);
 
-    void SetFlag(std::string flag) {
+    Ref<Object> Apply(const Ref<Object>& args, const Ref<Scope>& scope) override;
+
+    void SetFlag(const std::string& flag) {
         flag_ = flag;
     }
 
+    // Имя, под которым лямбда была определена через define; пустое у анонимных.
+    void SetName(const std::string& name);
+
+    const std::string& GetName() const;
+
+    const std::vector<std::string>& GetArguments() const;
+
+    const Ref<Scope>& GetScope() const;
+
+    const std::vector<Ref<Object>>& GetExpressions() const;
+
+    const std::string& GetFlag() const;
+
+    void Restore(std::vector<std::string> arguments,
+                 std::vector<Ref<Object>> expression, std::string flag);
+
 private:
     std::vector<std::string> arguments_;
-    std::shared_ptr<Scope> scope_;
-    std::vector<std::shared_ptr<Object>> expression_;
+    Ref<Scope> scope_;
+    std::vector<Ref<Object>> expression_;
     std::string flag_ = "undefined";
+    const std::string* name_ = nullptr;
 };
 
+void AddBuiltins(const Ref<Scope>& scope);
+
+Ref<Object> MakeBuiltin(const std::string& name);
+
+std::string BuiltinName(const Ref<Object>& obj);
+
+std::string BuiltinName(const std::type_info& type);
+
 template <class T>
-std::shared_ptr<T> As(const std::shared_ptr<Object>& obj) {
-    return std::dynamic_pointer_cast<T>(obj);
+Ref<T> As(const Ref<Object>& obj) {
+    return Ref<T>(dynamic_cast<T*>(obj.get()));
 }
 
 template <class T>
-bool Is(const std::shared_ptr<Object>& obj) {
+bool Is(const Ref<Object>& obj) {
     return dynamic_cast<T*>(obj.get());
 }
\ No newline at end of file
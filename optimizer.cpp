@@ -0,0 +1,245 @@
+#include "optimizer.h"
+
+#include <typeinfo>
+
+namespace {
+
+const std::unordered_set<std::string> kPureBuiltins = {
+    "+", "-", "*", "/", "max", "min", "abs", "=", "<", "<=", ">", ">=", "not", "number?",
+    "boolean?"};
+
+bool IsLiteral(const Ref<Object>& obj) {
+    return Is<Number>(obj) || Is<Boolean>(obj);
+}
+
+bool Matches(const Ref<Object>& value, const Ref<Object>& expected) {
+    if (!value) {
+        return false;
+    }
+    if (Is<Number>(expected)) {
+        return Is<Number>(value) &&
+               As<Number>(value)->GetValue() == As<Number>(expected)->GetValue();
+    }
+    if (Is<Boolean>(expected)) {
+        return Is<Boolean>(value) &&
+               As<Boolean>(value)->GetBool() == As<Boolean>(expected)->GetBool();
+    }
+    return typeid(*value) == typeid(*expected);
+}
+
+}  // namespace
+
+FoldedCell::FoldedCell(const Ref<Cell>& original, Ref<Object> replacement,
+                       std::vector<Guard> guards)
+    : Cell(original->GetFirst(), original->GetSecond()),
+      replacement_(replacement),
+      guards_(guards) {
+    SetPosition(original->GetPosition());
+}
+
+Ref<Object> FoldedCell::Eval(const Ref<Scope>& scope) {
+    if (!GuardsHold(scope)) {
+        return Cell::Eval(scope);
+    }
+    // Свёрнутый вызов не доходит до Cell::Eval: форма вычислена, но Apply не было.
+    ++runtime_stats.evals;
+    return replacement_->Eval(scope);
+}
+
+bool FoldedCell::GuardsHold(const Ref<Scope>& scope) const {
+    for (const auto& guard : guards_) {
+        Ref<Object> value;
+        try {
+            value = guard.symbol->Eval(scope);
+        } catch (const NameError&) {
+            return false;
+        }
+        if (!Matches(value, guard.expected)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const Ref<Object>& FoldedCell::GetReplacement() const {
+    return replacement_;
+}
+
+const std::vector<FoldedCell::Guard>& FoldedCell::GetGuards() const {
+    return guards_;
+}
+
+Optimizer::Optimizer(const Ref<Scope>& global) : global_(global) {
+}
+
+Ref<Object> Optimizer::Optimize(const Ref<Object>& expression) {
+    return Optimize(expression, {});
+}
+
+Ref<Object> Optimizer::Optimize(const Ref<Object>& expression, const Locals& locals) {
+    auto cell = As<Cell>(expression);
+    if (!cell || Is<FoldedCell>(cell)) {
+        return expression;
+    }
+    auto head = As<Symbol>(cell->GetFirst());
+    auto args = As<Cell>(cell->GetSecond());
+    std::string name = head ? head->GetName() : "";
+
+    if (name == "quote") {
+        return expression;
+    }
+    if (name == "lambda" && args) {
+        Locals inner = locals;
+        for (auto param = As<Cell>(args->GetFirst()); param;
+             param = As<Cell>(param->GetSecond())) {
+            if (Is<Symbol>(param->GetFirst())) {
+                inner.insert(As<Symbol>(param->GetFirst())->GetName());
+            }
+        }
+        OptimizeBody(args->GetSecond(), inner);
+        return expression;
+    }
+    if (name == "define" && args && Is<Cell>(args->GetFirst())) {
+        Locals inner = locals;
+        auto signature = As<Cell>(args->GetFirst());
+        for (auto param = As<Cell>(signature->GetSecond()); param;
+             param = As<Cell>(param->GetSecond())) {
+            if (Is<Symbol>(param->GetFirst())) {
+                inner.insert(As<Symbol>(param->GetFirst())->GetName());
+            }
+        }
+        OptimizeBody(args->GetSecond(), inner);
+        return expression;
+    }
+    if (name == "set!" && args && Is<Symbol>(args->GetFirst())) {
+        assigned_.insert(As<Symbol>(args->GetFirst())->GetName());
+    }
+
+    if (Is<Cell>(cell->GetFirst())) {
+        cell->SetFirst(Optimize(cell->GetFirst(), locals));
+    }
+    for (auto arg = args; arg; arg = As<Cell>(arg->GetSecond())) {
+        arg->SetFirst(Optimize(arg->GetFirst(), locals));
+    }
+    if (!head || name == "define" || name == "set!") {
+        return expression;
+    }
+    return Fold(cell, locals);
+}
+
+void Optimizer::OptimizeBody(const Ref<Object>& body, Locals locals) {
+    for (auto expression = As<Cell>(body); expression;
+         expression = As<Cell>(expression->GetSecond())) {
+        auto form = As<Cell>(expression->GetFirst());
+        if (!form || !Is<Symbol>(form->GetFirst()) || !Is<Cell>(form->GetSecond()) ||
+            As<Symbol>(form->GetFirst())->GetName() != "define") {
+            continue;
+        }
+        auto target = As<Cell>(form->GetSecond())->GetFirst();
+        if (Is<Cell>(target)) {
+            target = As<Cell>(target)->GetFirst();
+        }
+        if (Is<Symbol>(target)) {
+            locals.insert(As<Symbol>(target)->GetName());
+        }
+    }
+    for (auto expression = As<Cell>(body); expression;
+         expression = As<Cell>(expression->GetSecond())) {
+        expression->SetFirst(Optimize(expression->GetFirst(), locals));
+    }
+}
+
+Ref<Object> Optimizer::ResolveGlobal(const std::string& name,
+                                     const Locals& locals) const {
+    if (locals.count(name) || assigned_.count(name)) {
+        return nullptr;
+    }
+    auto cell = global_->FindCell(name);
+    return cell ? *cell : nullptr;
+}
+
+Ref<Object> Optimizer::Fold(const Ref<Cell>& cell, const Locals& locals) {
+    const std::string& name = As<Symbol>(cell->GetFirst())->GetName();
+    auto builtin = ResolveGlobal(name, locals);
+    if (!builtin) {
+        return cell;
+    }
+    std::vector<FoldedCell::Guard> guards = {{MakeRef<Symbol>(name), builtin}};
+
+    // Аргумент считается константой, если это литерал, уже свёрнутая константа
+    // или глобальная переменная, которой нигде не присваивают через set!.
+    auto constant = [&](const Ref<Object>& arg) -> Ref<Object> {
+        if (IsLiteral(arg)) {
+            return arg;
+        }
+        if (auto folded = As<FoldedCell>(arg); folded && IsLiteral(folded->GetReplacement())) {
+            guards.insert(guards.end(), folded->GetGuards().begin(), folded->GetGuards().end());
+            return folded->GetReplacement();
+        }
+        if (Is<Symbol>(arg)) {
+            auto value = ResolveGlobal(As<Symbol>(arg)->GetName(), locals);
+            if (IsLiteral(value)) {
+                guards.push_back({MakeRef<Symbol>(As<Symbol>(arg)->GetName()), value});
+                return value;
+            }
+        }
+        return nullptr;
+    };
+
+    if (Is<If>(builtin)) {
+        int number_of_arguments = NumberOfArguments(cell->GetSecond());
+        if (number_of_arguments != 2 && number_of_arguments != 3) {
+            return cell;
+        }
+        auto args = As<Cell>(cell->GetSecond());
+        auto condition = constant(args->GetFirst());
+        if (!condition) {
+            return cell;
+        }
+        bool is_false = Is<Boolean>(condition) && !As<Boolean>(condition)->GetBool();
+        if (is_false && number_of_arguments == 2) {
+            return cell;
+        }
+        auto branch = As<Cell>(args->GetSecond());
+        if (is_false) {
+            branch = As<Cell>(branch->GetSecond());
+        }
+        if (!branch->GetFirst()) {
+            return cell;
+        }
+        return MakeRef<FoldedCell>(cell, branch->GetFirst(), guards);
+    }
+
+    if (!kPureBuiltins.count(BuiltinName(builtin))) {
+        return cell;
+    }
+    std::vector<Ref<Object>> values;
+    Ref<Object> curent = cell->GetSecond();
+    while (auto arg = As<Cell>(curent)) {
+        auto value = constant(arg->GetFirst());
+        if (!value) {
+            return cell;
+        }
+        if (name == "/" && !values.empty() && Is<Number>(value) &&
+            As<Number>(value)->GetValue() == 0) {
+            return cell;
+        }
+        values.push_back(value);
+        curent = arg->GetSecond();
+    }
+    if (curent) {
+        return cell;
+    }
+
+    Ref<Object> folded_args = nullptr;
+    for (auto it = values.rbegin(); it != values.rend(); ++it) {
+        folded_args = MakeRef<Cell>(*it, folded_args);
+    }
+    Ref<Object> result;
+    try {
+        result = builtin->Apply(folded_args, global_);
+    } catch (const std::runtime_error&) {
+        return cell;
+    }
+    return MakeRef<FoldedCell>(cell, result, guards);
+}
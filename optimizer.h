@@ -0,0 +1,55 @@
+#pragma once
+
+#include <unordered_set>
+
+#include "object.h"
+
+// Свёрнутый вызов: хранит исходную форму и результат свёртки. Перед использованием
+// результата проверяет, что имена, от которых он зависит, связаны с теми же значениями.
+class FoldedCell : public Cell {
+public:
+    struct Guard {
+        Ref<Symbol> symbol;
+        Ref<Object> expected;
+    };
+
+    FoldedCell(const Ref<Cell>& original, Ref<Object> replacement, std::vector<Guard> guards);
+
+    Ref<Object> Eval(const Ref<Scope>& scope) override;
+
+    // Свёртка ещё верна: каждое имя из guards связано с тем, что видел оптимизатор.
+    bool GuardsHold(const Ref<Scope>& scope) const;
+
+    const Ref<Object>& GetReplacement() const;
+
+    const std::vector<Guard>& GetGuards() const;
+
+private:
+    Ref<Object> replacement_;
+    std::vector<Guard> guards_;
+};
+
+// Свёртка констант: чистые встроенные функции от литералов вычисляются заранее,
+// if с константным условием заменяется нужной веткой, неизменяемые глобальные
+// константы подставляются в свёртку.
+class Optimizer {
+public:
+    using Locals = std::unordered_set<std::string>;
+
+    explicit Optimizer(const Ref<Scope>& global);
+
+    Ref<Object> Optimize(const Ref<Object>& expression);
+
+    // locals перекрывают глобальные имена и не подставляются как константы.
+    Ref<Object> Optimize(const Ref<Object>& expression, const Locals& locals);
+
+private:
+    void OptimizeBody(const Ref<Object>& body, Locals locals);
+
+    Ref<Object> Fold(const Ref<Cell>& cell, const Locals& locals);
+
+    Ref<Object> ResolveGlobal(const std::string& name, const Locals& locals) const;
+
+    Ref<Scope> global_;
+    std::unordered_set<std::string> assigned_;
+};
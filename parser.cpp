@@ -20,7 +20,7 @@ bool IsQuote(Tokenizer* tokenizer) {
     return false;
 }
 
-std::shared_ptr<Object> Read(Tokenizer* tokenizer) {
+Ref<Object> Read(Tokenizer* tokenizer) {
     auto obj = ReadSymbol(tokenizer);
     if (!tokenizer->IsEnd()) {
         throw SyntaxError{"AAAAAA"};
@@ -28,26 +28,29 @@ std::shared_ptr<Object> Read(Tokenizer* tokenizer) {
     return obj;
 }
 
-std::shared_ptr<Object> ReadSymbol(Tokenizer* tokenizer) {
+Ref<Object> ReadSymbol(Tokenizer* tokenizer) {
     if (tokenizer->IsEnd()) {
         return nullptr;
     }
+    ++runtime_stats.parsed_nodes;
     Token token = tokenizer->GetToken();
+    SourcePosition position = tokenizer->GetPosition();
     if (IsQuote(tokenizer)) {
-        std::shared_ptr<Cell> root_ptr = std::make_shared<Cell>();
-        std::shared_ptr<Cell> cell_current_ptr = root_ptr;
-        std::shared_ptr<Symbol> symbol_ptr = std::make_shared<Symbol>("quote");
+        Ref<Cell> root_ptr = MakeRef<Cell>();
+        root_ptr->SetPosition(position);
+        Ref<Cell> cell_current_ptr = root_ptr;
+        Ref<Symbol> symbol_ptr = MakeRef<Symbol>("quote");
         cell_current_ptr->SetFirst(symbol_ptr);
         tokenizer->Next();
 
-        std::shared_ptr<Cell> cell_ptr = std::make_shared<Cell>();
+        Ref<Cell> cell_ptr = MakeRef<Cell>();
         cell_current_ptr->SetSecond(cell_ptr);
         cell_current_ptr = cell_ptr;
 
         if (IfBracket(tokenizer) && IsOpenBracket(tokenizer)) {
             tokenizer->Next();
             if (IfBracket(tokenizer) && !IsOpenBracket(tokenizer)) {
-                std::shared_ptr<Cell> cell_ptr2 = std::make_shared<Cell>();
+                Ref<Cell> cell_ptr2 = MakeRef<Cell>();
                 cell_current_ptr->SetFirst(cell_ptr2);
                 cell_current_ptr = cell_ptr2;
                 tokenizer->Next();
@@ -61,23 +64,27 @@ std::shared_ptr<Object> ReadSymbol(Tokenizer* tokenizer) {
     }
     if (!IfBracket(tokenizer)) {
         if (auto constant_token = std::get_if<ConstantToken>(&token)) {
-            std::shared_ptr<Number> number_ptr = std::make_shared<Number>(constant_token->value);
+            Ref<Number> number_ptr = MakeRef<Number>(constant_token->value);
             tokenizer->Next();
             return number_ptr;
         } else if (auto symbol_token = std::get_if<SymbolToken>(&token)) {
-            std::shared_ptr<Symbol> symbol_token_ptr = std::make_shared<Symbol>(symbol_token->name);
+            Ref<Symbol> symbol_token_ptr = MakeRef<Symbol>(symbol_token->name);
             tokenizer->Next();
             return symbol_token_ptr;
         } else if (auto boolean_token = std::get_if<BooleanToken>(&token)) {
-            std::shared_ptr<Boolean> symbol_token_ptr =
-                std::make_shared<Boolean>(*boolean_token == BooleanToken::True);
+            Ref<Boolean> symbol_token_ptr =
+                MakeRef<Boolean>(*boolean_token == BooleanToken::True);
             tokenizer->Next();
             return symbol_token_ptr;
         }
     } else {
         if (IsOpenBracket(tokenizer)) {
             tokenizer->Next();
-            return ReadList(tokenizer);
+            auto list = ReadList(tokenizer);
+            if (auto cell = As<Cell>(list)) {
+                cell->SetPosition(position);
+            }
+            return list;
         } else {
             throw SyntaxError{"AAAAAA"};
         }
@@ -85,9 +92,9 @@ std::shared_ptr<Object> ReadSymbol(Tokenizer* tokenizer) {
     return nullptr;
 }
 
-std::shared_ptr<Object> ReadList(Tokenizer* tokenizer) {
-    std::shared_ptr<Cell> root_ptr = std::make_shared<Cell>();
-    std::shared_ptr<Cell> cell_current_ptr = root_ptr;
+Ref<Object> ReadList(Tokenizer* tokenizer) {
+    Ref<Cell> root_ptr = MakeRef<Cell>();
+    Ref<Cell> cell_current_ptr = root_ptr;
     while (true) {
         if (tokenizer->IsEnd()) {
             throw SyntaxError{"AAAAAA"};
@@ -115,7 +122,7 @@ std::shared_ptr<Object> ReadList(Tokenizer* tokenizer) {
                     tokenizer->Next();
                     break;
                 } else {
-                    std::shared_ptr<Cell> cell_ptr = std::make_shared<Cell>();
+                    Ref<Cell> cell_ptr = MakeRef<Cell>();
                     cell_current_ptr->SetSecond(cell_ptr);
                     cell_current_ptr = cell_ptr;
                 }
@@ -128,3 +135,11 @@ std::shared_ptr<Object> ReadList(Tokenizer* tokenizer) {
     }
     return root_ptr;
 }
+
+std::vector<Ref<Object>> ReadAll(Tokenizer* tokenizer) {
+    std::vector<Ref<Object>> forms;
+    while (!tokenizer->IsEnd()) {
+        forms.push_back(ReadSymbol(tokenizer));
+    }
+    return forms;
+}
@@ -10,6 +10,7 @@ bool IsOpenBracket(Tokenizer* tokenizer);
 
 bool IsQuote(Tokenizer* tokenizer);
 
-std::shared_ptr<Object> Read(Tokenizer* tokenizer);
-std::shared_ptr<Object> ReadSymbol(Tokenizer* tokenizer);
-std::shared_ptr<Object> ReadList(Tokenizer* tokenizer);
\ No newline at end of file
+Ref<Object> Read(Tokenizer* tokenizer);
+Ref<Object> ReadSymbol(Tokenizer* tokenizer);
+Ref<Object> ReadList(Tokenizer* tokenizer);
+std::vector<Ref<Object>> ReadAll(Tokenizer* tokenizer);
\ No newline at end of file
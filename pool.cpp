@@ -0,0 +1,111 @@
+#include "pool.h"
+
+#include <mutex>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> next_pool_id = 1;
+
+// Интерпретаторы потока по номерам пулов. Номер, а не адрес: адрес уничтоженного пула
+// может достаться новому.
+struct LocalInstances {
+    ~LocalInstances();
+
+    std::unordered_map<uint64_t, Scheme*> instances;
+};
+
+thread_local LocalInstances local_instances;
+
+}  // namespace
+
+// Живые пулы. Через него поток при завершении отдаёт пулам свои интерпретаторы, а
+// кэш потока узнаёт, какие из его записей остались от уничтоженных пулов.
+class PoolRegistry {
+public:
+    static PoolRegistry& Get() {
+        // Не уничтожается: потоки могут завершаться после статических объектов.
+        static PoolRegistry* registry = new PoolRegistry;
+        return *registry;
+    }
+
+    void Add(SchemePool* pool) {
+        std::lock_guard lock{mutex_};
+        pools_.emplace(pool->id_, pool);
+    }
+
+    std::unordered_map<std::thread::id, std::unique_ptr<Scheme>> Remove(SchemePool* pool) {
+        std::lock_guard lock{mutex_};
+        pools_.erase(pool->id_);
+        return std::exchange(pool->locals_, {});
+    }
+
+    Scheme* Adopt(SchemePool* pool, std::unique_ptr<Scheme> instance, LocalInstances* local) {
+        std::lock_guard lock{mutex_};
+        std::erase_if(local->instances,
+                      [this](const auto& entry) { return !pools_.contains(entry.first); });
+        Scheme* scheme = instance.get();
+        pool->locals_[std::this_thread::get_id()] = std::move(instance);
+        local->instances.emplace(pool->id_, scheme);
+        return scheme;
+    }
+
+    std::vector<std::unique_ptr<Scheme>> Release(const LocalInstances& local) {
+        std::vector<std::unique_ptr<Scheme>> released;
+        std::lock_guard lock{mutex_};
+        for (const auto& [id, scheme] : local.instances) {
+            auto pool = pools_.find(id);
+            if (pool == pools_.end()) {
+                continue;
+            }
+            auto& locals = pool->second->locals_;
+            auto it = locals.find(std::this_thread::get_id());
+            if (it != locals.end()) {
+                released.push_back(std::move(it->second));
+                locals.erase(it);
+            }
+        }
+        return released;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, SchemePool*> pools_;
+};
+
+LocalInstances::~LocalInstances() {
+    // Интерпретаторы удаляются вне мьютекса реестра.
+    auto released = PoolRegistry::Get().Release(*this);
+}
+
+SchemePool::SchemePool() : SchemePool(std::make_unique<Scheme>().get()) {
+}
+
+SchemePool::SchemePool(Scheme* prototype)
+    : id_(next_pool_id.fetch_add(1, std::memory_order_relaxed)) {
+    std::stringstream image;
+    prototype->SaveImage(&image);
+    image_ = image.str();
+    PoolRegistry::Get().Add(this);
+}
+
+SchemePool::~SchemePool() {
+    auto locals = PoolRegistry::Get().Remove(this);
+}
+
+Scheme& SchemePool::Local() {
+    auto& instances = local_instances.instances;
+    if (auto it = instances.find(id_); it != instances.end()) {
+        return *it->second;
+    }
+    std::stringstream image{image_};
+    auto instance = std::make_unique<Scheme>(Scheme::FromImage(&image));
+    instances_.fetch_add(1, std::memory_order_relaxed);
+    return *PoolRegistry::Get().Adopt(this, std::move(instance), &local_instances);
+}
+
+size_t SchemePool::Instances() const {
+    return instances_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "scheme.h"
+
+// Раздаёт потокам собственные интерпретаторы. Общим остаётся только неизменяемый
+// образ прототипа: каждый поток восстанавливает из него свою кучу и свои встроенные
+// функции, поэтому счётчики ссылок и области видимости не разделяются между ядрами.
+class SchemePool {
+public:
+    // Пул интерпретаторов, в которых есть только встроенные функции.
+    SchemePool();
+
+    // Снимает образ прототипа; его последующие изменения в пул не попадают.
+    explicit SchemePool(Scheme* prototype);
+
+    ~SchemePool();
+
+    SchemePool(const SchemePool&) = delete;
+    SchemePool& operator=(const SchemePool&) = delete;
+
+    // Интерпретатор вызывающего потока, создаётся при первом обращении. Живёт до
+    // завершения потока или до уничтожения пула.
+    Scheme& Local();
+
+    // Сколько интерпретаторов пул создал за всё время.
+    size_t Instances() const;
+
+private:
+    friend class PoolRegistry;
+
+    uint64_t id_;
+    std::string image_;
+    std::atomic<size_t> instances_ = 0;
+    // Интерпретаторы принадлежат пулу, у потоков только кэш указателей; меняется под
+    // мьютексом реестра пулов.
+    std::unordered_map<std::thread::id, std::unique_ptr<Scheme>> locals_;
+};
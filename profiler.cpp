@@ -0,0 +1,103 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+thread_local Profiler* Profiler::active = nullptr;
+
+std::string ProcedureName(const Ref<Object>& function) {
+    if (auto lambda = As<Lambda>(function)) {
+        return lambda->GetName().empty() ? "lambda" : lambda->GetName();
+    }
+    auto name = BuiltinName(function);
+    return name.empty() ? "?" : name;
+}
+
+Profiler::Call::Call(Profiler* profiler, const Ref<Object>& function) : profiler_(profiler) {
+    Entry* entry = &profiler_->entries_[ProcedureName(function)];
+    ++entry->calls;
+    ++entry->depth;
+    profiler_->stack_.push_back({entry, Clock::now()});
+}
+
+Profiler::Call::~Call() {
+    Frame frame = profiler_->stack_.back();
+    profiler_->stack_.pop_back();
+    auto elapsed = Clock::now() - frame.start;
+    // Рекурсивные вызовы уже входят во время внешнего вызова той же процедуры.
+    if (--frame.entry->depth == 0) {
+        frame.entry->inclusive += elapsed;
+    }
+    frame.entry->exclusive += elapsed - frame.children;
+    if (!profiler_->stack_.empty()) {
+        profiler_->stack_.back().children += elapsed;
+    }
+}
+
+Profiler* Profiler::Activate(Profiler* profiler) {
+    Profiler* previous = active;
+    if (previous) {
+        allocation_hook = previous->previous_hook_;
+    }
+    if (profiler) {
+        profiler->previous_hook_ = allocation_hook;
+        allocation_hook = CountAllocation;
+    }
+    active = profiler;
+    return previous;
+}
+
+Profiler::Activation::Activation(Profiler* profiler) : profiler_(profiler) {
+    if (profiler_) {
+        previous_ = Activate(profiler_);
+    }
+}
+
+Profiler::Activation::~Activation() {
+    if (profiler_) {
+        Activate(previous_);
+    }
+}
+
+void Profiler::CountAllocation(const std::type_info& type, size_t size) {
+    if (active && !active->stack_.empty()) {
+        ++active->stack_.back().entry->allocations;
+    }
+    if (active && active->previous_hook_) {
+        active->previous_hook_(type, size);
+    }
+}
+
+const std::unordered_map<std::string, Profiler::Entry>& Profiler::GetEntries() const {
+    return entries_;
+}
+
+std::string Profiler::Report() const {
+    std::vector<std::pair<std::string, Entry>> rows(entries_.begin(), entries_.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& lhs, const auto& rhs) {
+        if (lhs.second.exclusive != rhs.second.exclusive) {
+            return lhs.second.exclusive > rhs.second.exclusive;
+        }
+        return lhs.first < rhs.first;
+    });
+    auto milliseconds = [](std::chrono::nanoseconds time) {
+        return std::chrono::duration<double, std::milli>(time).count();
+    };
+    std::stringstream ss;
+    ss << std::left << std::setw(24) << "procedure" << std::right << std::setw(10) << "calls"
+       << std::setw(14) << "incl ms" << std::setw(14) << "excl ms" << std::setw(12) << "allocs"
+       << '\n';
+    ss << std::fixed << std::setprecision(3);
+    for (const auto& [name, entry] : rows) {
+        ss << std::left << std::setw(24) << name << std::right << std::setw(10) << entry.calls
+           << std::setw(14) << milliseconds(entry.inclusive) << std::setw(14)
+           << milliseconds(entry.exclusive) << std::setw(12) << entry.allocations << '\n';
+    }
+    return ss.str();
+}
+
+void Profiler::Reset() {
+    entries_.clear();
+    stack_.clear();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Профилировщик вызовов: для каждой процедуры (лямбды по имени из define и
+// встроенной функции) считает число вызовов, полное и собственное время и
+// количество созданных объектов. Включается для потока через Activate, при
+// выключенном профилировщике вызов проверяет только Active().
+class Profiler {
+public:
+    struct Entry {
+        uint64_t calls = 0;
+        std::chrono::nanoseconds inclusive{0};
+        std::chrono::nanoseconds exclusive{0};
+        uint64_t allocations = 0;
+        int depth = 0;
+    };
+
+    // Учитывает один вызов function, пока жив объект.
+    class Call {
+    public:
+        Call(Profiler* profiler, const Ref<Object>& function);
+
+        ~Call();
+
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+
+    private:
+        Profiler* profiler_;
+    };
+
+    static Profiler* Active() {
+        return active;
+    }
+
+    // Делает profiler активным в текущем потоке и возвращает предыдущий.
+    static Profiler* Activate(Profiler* profiler);
+
+    // Активирует профилировщик на время жизни объекта; nullptr ничего не меняет.
+    class Activation {
+    public:
+        explicit Activation(Profiler* profiler);
+
+        ~Activation();
+
+        Activation(const Activation&) = delete;
+        Activation& operator=(const Activation&) = delete;
+
+    private:
+        Profiler* profiler_;
+        Profiler* previous_ = nullptr;
+    };
+
+    const std::unordered_map<std::string, Entry>& GetEntries() const;
+
+    std::string Report() const;
+
+    void Reset();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame {
+        Entry* entry;
+        Clock::time_point start;
+        std::chrono::nanoseconds children{0};
+    };
+
+    static void CountAllocation(const std::type_info& type, size_t size);
+
+    static thread_local Profiler* active;
+
+    std::unordered_map<std::string, Entry> entries_;
+    std::vector<Frame> stack_;
+    AllocationHook previous_hook_ = nullptr;
+};
+
+std::string ProcedureName(const Ref<Object>& function);
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include "heap.h"
+#include "stats.h"
+
+// Базовый класс для объектов со встроенным счётчиком ссылок. Счётчик не атомарный:
+// объекты интерпретатора живут в одном потоке. Чтобы передать значение в другой
+// поток, его нужно явно сериализовать (см. image.h) и восстановить на той стороне.
+class RefCounted {
+public:
+    RefCounted() = default;
+
+    RefCounted(const RefCounted&) {
+    }
+
+    RefCounted& operator=(const RefCounted&) {
+        return *this;
+    }
+
+    void AddRef() const {
+        ++ref_count_;
+    }
+
+    // Возвращает true, если ссылок больше не осталось.
+    bool Release() const {
+        return --ref_count_ == 0;
+    }
+
+    uint32_t RefCount() const {
+        return ref_count_;
+    }
+
+    // Счёт памяти, на который записан объект (см. heap.h); nullptr, если объект создан
+    // вне учёта.
+    HeapAccount* HeapOwner() const {
+        return heap_owner_;
+    }
+
+    // Байты, записанные на HeapOwner(); при удалении объекта возвращаются ему.
+    uint32_t ChargedBytes() const {
+        return charged_bytes_;
+    }
+
+    void AddCharge(HeapAccount* account, size_t bytes) const {
+        heap_owner_ = account;
+        charged_bytes_ += static_cast<uint32_t>(bytes);
+    }
+
+private:
+    mutable uint32_t ref_count_ = 0;
+    mutable uint32_t charged_bytes_ = 0;
+    mutable HeapAccount* heap_owner_ = nullptr;
+};
+
+// Владеющая ссылка на RefCounted. Удаляет объект через T, поэтому у полиморфных
+// типов должен быть виртуальный деструктор.
+template <class T>
+class Ref {
+public:
+    Ref() = default;
+
+    Ref(std::nullptr_t) {
+    }
+
+    explicit Ref(T* ptr) : ptr_(ptr) {
+        if (ptr_) {
+            ptr_->AddRef();
+        }
+    }
+
+    Ref(const Ref& other) : Ref(other.ptr_) {
+    }
+
+    Ref(Ref&& other) noexcept : ptr_(std::exchange(other.ptr_, nullptr)) {
+    }
+
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(const Ref<U>& other) : Ref(other.get()) {
+    }
+
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(Ref<U>&& other) noexcept : ptr_(other.Detach()) {
+    }
+
+    ~Ref() {
+        if (ptr_ && ptr_->Release()) {
+            --runtime_stats.live_objects;
+            HeapAccount* account = ptr_->HeapOwner();
+            uint32_t bytes = ptr_->ChargedBytes();
+            delete ptr_;
+            if (account) {
+                account->Release(bytes);
+            }
+        }
+    }
+
+    Ref& operator=(Ref other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    T* get() const {
+        return ptr_;
+    }
+
+    T& operator*() const {
+        return *ptr_;
+    }
+
+    T* operator->() const {
+        return ptr_;
+    }
+
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+    // Отдаёт указатель вместе с владением, не трогая счётчик.
+    T* Detach() {
+        return std::exchange(ptr_, nullptr);
+    }
+
+private:
+    T* ptr_ = nullptr;
+};
+
+template <class T, class U>
+bool operator==(const Ref<T>& lhs, const Ref<U>& rhs) {
+    return lhs.get() == rhs.get();
+}
+
+template <class T, class U>
+bool operator!=(const Ref<T>& lhs, const Ref<U>& rhs) {
+    return lhs.get() != rhs.get();
+}
+
+template <class T>
+bool operator==(const Ref<T>& lhs, std::nullptr_t) {
+    return !lhs;
+}
+
+template <class T>
+bool operator!=(const Ref<T>& lhs, std::nullptr_t) {
+    return static_cast<bool>(lhs);
+}
+
+// Если задан, вызывается при каждом создании объекта через MakeRef в этом потоке.
+// Через него тесты считают выделения памяти по типам объектов.
+using AllocationHook = void (*)(const std::type_info& type, size_t size);
+
+inline thread_local AllocationHook allocation_hook = nullptr;
+
+template <class T, class... Args>
+Ref<T> MakeRef(Args&&... args) {
+    if (allocation_hook) {
+        allocation_hook(typeid(T), sizeof(T));
+    }
+    RuntimeStats& stats = runtime_stats;
+    ++stats.allocations[ObjectTypeIndex<T>()];
+    if (++stats.live_objects > stats.peak_live_objects) {
+        stats.peak_live_objects = stats.live_objects;
+    }
+    Ref<T> ref(new T(std::forward<Args>(args)...));
+    if (HeapAccount* account = heap_account) {
+        size_t bytes = sizeof(T);
+        if constexpr (requires(const T& object) { object.HeapExtraBytes(); }) {
+            bytes += ref->HeapExtraBytes();
+        }
+        account->Charge(bytes);
+        ref->AddCharge(account, bytes);
+    }
+    return ref;
+}
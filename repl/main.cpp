@@ -1,8 +1,140 @@
 #include <scheme.h>
+#include <fasl.h>
+#include <sampler.h>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
-int main() {
+int Compile(const std::string& source_path, const std::string& output_path) {
+    std::ifstream source{source_path};
+    if (!source) {
+        std::cerr << "Не удалось открыть " << source_path << '\n';
+        return 1;
+    }
+    std::ofstream output{output_path, std::ios::binary};
+    try {
+        CompileFasl(&source, &output);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+int Profile(Scheme* scheme, const std::string& script_path, const std::string& output_path) {
+    std::ofstream output{output_path};
+    if (!output) {
+        std::cerr << "Не удалось открыть " << output_path << '\n';
+        return 1;
+    }
+    SamplingProfiler profiler;
+    int status = 0;
+    profiler.Start();
+    try {
+        std::cout << scheme->LoadSource(script_path) << '\n';
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << '\n';
+        status = 1;
+    }
+    profiler.Stop();
+    profiler.WriteCollapsed(&output);
+    std::cerr << profiler.Samples() << " samples, " << profiler.Dropped() << " dropped\n";
+    if (profiler.Samples() == 0) {
+        // Таймер считает процессорное время, поэтому короткий скрипт может не получить
+        // ни одного сигнала.
+        std::cerr << "Профиль пуст: скрипт выполнился быстрее интервала семплирования "
+                     "(1 мс процессорного времени)\n";
+    }
+    return status;
+}
+
+// Раз в interval печатает в stderr гистограммы фаз Evaluate, пока жив объект.
+class LatencyDumper {
+public:
+    explicit LatencyDumper(std::chrono::seconds interval)
+        : thread_([this, interval] { Run(interval); }) {
+    }
+
+    ~LatencyDumper() {
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+        stopped_.notify_one();
+        thread_.join();
+    }
+
+private:
+    void Run(std::chrono::seconds interval) {
+        std::unique_lock lock{mutex_};
+        while (!stopped_.wait_for(lock, interval, [this] { return stop_; })) {
+            std::cerr << Scheme::Latencies().Report();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+int main(int argc, char** argv) {
     Scheme scheme;
+    std::string compile_path;
+    std::string output_path = "out.fasl";
+    std::string profile_path;
+    std::string script_path;
+    int dump_interval = 0;
+    bool trace = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--profile=", 0) == 0) {
+            profile_path = arg.substr(std::string{"--profile="}.size());
+        } else if (arg.rfind("--latency-dump=", 0) == 0) {
+            dump_interval = std::atoi(arg.c_str() + std::string{"--latency-dump="}.size());
+        } else if (arg == "--trace") {
+            trace = true;
+        } else if (script_path.empty() && !arg.empty() && arg[0] != '-') {
+            script_path = arg;
+        } else if (arg == "--compile" && i + 1 < argc) {
+            compile_path = argv[++i];
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--load" && i + 1 < argc) {
+            try {
+                scheme.LoadFasl(argv[++i]);
+            } catch (const std::runtime_error& ex) {
+                std::cerr << ex.what() << '\n';
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: scheme-repl [--compile in.scm -o out.fasl] [--load file.fasl]\n"
+                         "                   [--latency-dump=SECONDS] [--trace]\n"
+                         "       scheme-repl --profile=out.folded script.scm\n";
+            return 1;
+        }
+    }
+    if (!compile_path.empty()) {
+        return Compile(compile_path, output_path);
+    }
+    if (!profile_path.empty() || !script_path.empty()) {
+        if (profile_path.empty() || script_path.empty()) {
+            std::cerr << "Usage: scheme-repl --profile=out.folded script.scm\n";
+            return 1;
+        }
+        return Profile(&scheme, script_path, profile_path);
+    }
+
+    if (trace) {
+        scheme.EnableTrace();
+    }
+    std::unique_ptr<LatencyDumper> dumper;
+    if (dump_interval > 0) {
+        dumper = std::make_unique<LatencyDumper>(std::chrono::seconds{dump_interval});
+    }
     std::string expression;
     std::cout << "Scheme 1.0.0\n";
     while (std::cin) {
@@ -13,6 +145,8 @@ int main() {
         }
         try {
             std::cout << scheme.Evaluate(expression);
+        } catch (const EvalError& ex) {
+            std::cout << ex.what() << '\n' << ex.Trace();
         } catch (const std::runtime_error& ex) {
             std::cout << ex.what();
         }
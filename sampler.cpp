@@ -0,0 +1,200 @@
+#include "sampler.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "error.h"
+
+namespace {
+
+struct ShadowStack {
+    uint32_t depth = 0;
+    const std::string* frames[SamplingProfiler::kMaxDepth];
+};
+
+thread_local ShadowStack shadow_stack;
+
+struct sigaction previous_action;
+
+}  // namespace
+
+std::atomic<bool> SamplingProfiler::running = false;
+std::atomic<SamplingProfiler*> SamplingProfiler::instance = nullptr;
+std::atomic<uint32_t> SamplingProfiler::in_handler = 0;
+
+const std::string* InternName(const std::string& name) {
+    static std::mutex mutex;
+    static std::unordered_set<std::string>* names = new std::unordered_set<std::string>;
+    std::lock_guard lock{mutex};
+    return &*names->insert(name).first;
+}
+
+ShadowFrame::ShadowFrame(const std::string* name) {
+    if (!SamplingProfiler::Running()) {
+        return;
+    }
+    auto& stack = shadow_stack;
+    if (stack.depth < SamplingProfiler::kMaxDepth) {
+        stack.frames[stack.depth] = name;
+    }
+    // Обработчик сигнала прерывает этот же поток: кадр должен быть записан
+    // раньше, чем станет виден новый размер стека.
+    std::atomic_signal_fence(std::memory_order_release);
+    ++stack.depth;
+    pushed_ = true;
+}
+
+ShadowFrame::~ShadowFrame() {
+    if (pushed_) {
+        --shadow_stack.depth;
+    }
+}
+
+SamplingProfiler::SamplingProfiler(std::chrono::microseconds interval)
+    : interval_(interval), ring_(kRingSize) {
+}
+
+SamplingProfiler::~SamplingProfiler() {
+    Stop();
+}
+
+void SamplingProfiler::Start() {
+    SamplingProfiler* expected = nullptr;
+    if (!instance.compare_exchange_strong(expected, this)) {
+        throw RuntimeError{"Семплирующий профилировщик уже запущен"};
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = OnSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previous_action);
+
+    // Фоновый поток наследует маску с заблокированным SIGPROF и не семплируется.
+    sigset_t profiling_signal;
+    sigset_t old_mask;
+    sigemptyset(&profiling_signal);
+    sigaddset(&profiling_signal, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &profiling_signal, &old_mask);
+    stop_drainer_.store(false);
+    drainer_ = std::thread([this] {
+        while (!stop_drainer_.load(std::memory_order_acquire)) {
+            Drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+    });
+    pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+
+    running.store(true, std::memory_order_relaxed);
+    itimerval timer = {};
+    timer.it_interval.tv_sec = interval_.count() / 1000000;
+    timer.it_interval.tv_usec = interval_.count() % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void SamplingProfiler::Stop() {
+    if (instance.load() != this) {
+        return;
+    }
+    itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    running.store(false, std::memory_order_relaxed);
+    instance.store(nullptr);
+
+    // Сигнал мог уже быть в пути: действие по умолчанию для SIGPROF завершает процесс.
+    if (previous_action.sa_handler == SIG_DFL) {
+        previous_action.sa_handler = SIG_IGN;
+    }
+    sigaction(SIGPROF, &previous_action, nullptr);
+
+    // Обработчик в другом потоке мог прочитать instance до сброса и ещё писать в буфер
+    // или держать writing_: объект нельзя освобождать, пока он не вышел.
+    while (in_handler.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    stop_drainer_.store(true, std::memory_order_release);
+    drainer_.join();
+    Drain();
+}
+
+void SamplingProfiler::OnSignal(int) {
+    // Счётчик поднимается до чтения instance: если обработчик увидел профилировщик,
+    // Stop увидит и его.
+    in_handler.fetch_add(1);
+    SamplingProfiler* profiler = instance.load();
+    if (!profiler) {
+        in_handler.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    // Буфер пишет один поток за раз; снимок, пришедший во время чужой записи, теряется.
+    if (profiler->writing_.test_and_set(std::memory_order_acquire)) {
+        profiler->dropped_.fetch_add(1, std::memory_order_relaxed);
+        in_handler.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    uint64_t head = profiler->head_.load(std::memory_order_relaxed);
+    if (head - profiler->tail_.load(std::memory_order_acquire) >= kRingSize) {
+        profiler->dropped_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        std::atomic_signal_fence(std::memory_order_acquire);
+        const auto& stack = shadow_stack;
+        Sample& sample = profiler->ring_[head % kRingSize];
+        sample.depth = stack.depth;
+        std::copy_n(stack.frames, std::min<size_t>(stack.depth, kMaxDepth),
+                    sample.frames.begin());
+        profiler->head_.store(head + 1, std::memory_order_release);
+    }
+    profiler->writing_.clear(std::memory_order_release);
+    in_handler.fetch_sub(1, std::memory_order_release);
+}
+
+void SamplingProfiler::Drain() {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    std::lock_guard lock{stacks_mutex_};
+    for (; tail != head; ++tail) {
+        Collapse(ring_[tail % kRingSize]);
+        tail_.store(tail + 1, std::memory_order_release);
+    }
+}
+
+void SamplingProfiler::Collapse(const Sample& sample) {
+    std::string stack;
+    if (sample.depth == 0) {
+        stack = "[toplevel]";
+    }
+    for (size_t i = 0; i < std::min<size_t>(sample.depth, kMaxDepth); ++i) {
+        if (!stack.empty()) {
+            stack += ';';
+        }
+        const std::string* name = sample.frames[i];
+        stack += !name || name->empty() ? "lambda" : *name;
+    }
+    if (sample.depth > kMaxDepth) {
+        stack += ";[truncated]";
+    }
+    ++stacks_[stack];
+    ++samples_;
+}
+
+void SamplingProfiler::WriteCollapsed(std::ostream* out) const {
+    std::lock_guard lock{stacks_mutex_};
+    for (const auto& [stack, count] : stacks_) {
+        *out << stack << ' ' << count << '\n';
+    }
+}
+
+uint64_t SamplingProfiler::Samples() const {
+    std::lock_guard lock{stacks_mutex_};
+    return samples_;
+}
+
+uint64_t SamplingProfiler::Dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
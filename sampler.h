@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Имена процедур живут до конца программы, поэтому на них можно ссылаться из
+// обработчика сигнала и после того, как сама лямбда удалена.
+const std::string* InternName(const std::string& name);
+
+// Семплирующий профилировщик: по таймеру SIGPROF снимает теневой стек процедур
+// Scheme в кольцевой буфер, фоновый поток сворачивает снимки в счётчики стеков.
+// Одновременно может работать только один экземпляр.
+class SamplingProfiler {
+public:
+    static constexpr size_t kMaxDepth = 64;
+
+    explicit SamplingProfiler(std::chrono::microseconds interval = std::chrono::milliseconds{1});
+
+    ~SamplingProfiler();
+
+    SamplingProfiler(const SamplingProfiler&) = delete;
+    SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+    void Start();
+
+    void Stop();
+
+    // Стеки в формате flamegraph.pl: "f;g;h 42" на строку, корень слева. Во время
+    // работы отдаёт то, что фоновый поток успел свернуть; полный итог — после Stop.
+    void WriteCollapsed(std::ostream* out) const;
+
+    uint64_t Samples() const;
+
+    uint64_t Dropped() const;
+
+    static bool Running() {
+        return running.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Sample {
+        uint32_t depth;
+        std::array<const std::string*, kMaxDepth> frames;
+    };
+
+    static constexpr size_t kRingSize = 1024;
+
+    static void OnSignal(int);
+
+    void Drain();
+
+    void Collapse(const Sample& sample);
+
+    static std::atomic<bool> running;
+    static std::atomic<SamplingProfiler*> instance;
+    // Обработчики, которые могли прочитать instance; Stop ждёт их перед выходом.
+    static std::atomic<uint32_t> in_handler;
+
+    std::chrono::microseconds interval_;
+    std::vector<Sample> ring_;
+    std::atomic<uint64_t> head_ = 0;
+    std::atomic<uint64_t> tail_ = 0;
+    std::atomic<uint64_t> dropped_ = 0;
+    std::atomic<bool> stop_drainer_ = false;
+    std::atomic_flag writing_ = ATOMIC_FLAG_INIT;
+    std::thread drainer_;
+    // Счётчики пишет фоновый поток, а читать их можно из любого.
+    mutable std::mutex stacks_mutex_;
+    std::map<std::string, uint64_t> stacks_;
+    uint64_t samples_ = 0;
+};
+
+// Кадр теневого стека текущего потока; кладётся только пока идёт семплирование.
+class ShadowFrame {
+public:
+    explicit ShadowFrame(const std::string* name);
+
+    ~ShadowFrame();
+
+    ShadowFrame(const ShadowFrame&) = delete;
+    ShadowFrame& operator=(const ShadowFrame&) = delete;
+
+private:
+    bool pushed_ = false;
+};
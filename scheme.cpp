@@ -1,59 +1,389 @@
 #include "scheme.h"
 
+#include <chrono>
+#include <fstream>
+#include <optional>
 #include <stdexcept>
 
-Scheme::Scheme() : scope_(std::make_shared<Scope>()) {
-    scope_->SetElementScope("quote", std::make_shared<QuoteSpecForm>());
+#include "fasl.h"
+#include "image.h"
+#include "machine.h"
 
-    scope_->SetElementScope("number?", std::make_shared<NumberQ>());
-    scope_->SetElementScope("boolean?", std::make_shared<BooleanQ>());
-    scope_->SetElementScope("symbol?", std::make_shared<SymbolQ>());
-    scope_->SetElementScope("pair?", std::make_shared<PairQ>());
-    scope_->SetElementScope("null?", std::make_shared<NullQ>());
-    scope_->SetElementScope("list?", std::make_shared<ListQ>());
+namespace {
 
-    scope_->SetElementScope("=", std::make_shared<Equal>());
-    scope_->SetElementScope("<", std::make_shared<Less>());
-    scope_->SetElementScope("<=", std::make_shared<LessEquals>());
-    scope_->SetElementScope(">", std::make_shared<More>());
-    scope_->SetElementScope(">=", std::make_shared<MoreEquals>());
+Ref<Scope> MakeScope(HeapAccount* account) {
+    HeapAccount::Activation heap{account};
+    return MakeRef<Scope>();
+}
+
+// Текущая фаза Evaluate. Границы фаз общие: на каждую приходится одно чтение часов.
+// Фаза, прерванная исключением, записывается тоже, поэтому ошибки видны в её хвосте.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(LatencyHistogram* phase)
+        : phase_(phase), start_(std::chrono::steady_clock::now()) {
+    }
 
-    scope_->SetElementScope("+", std::make_shared<Plus>());
-    scope_->SetElementScope("-", std::make_shared<Minus>());
-    scope_->SetElementScope("/", std::make_shared<Division>());
-    scope_->SetElementScope("*", std::make_shared<Multiplication>());
+    ~PhaseTimer() {
+        phase_->Record(std::chrono::steady_clock::now() - start_);
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    void Next(LatencyHistogram* phase) {
+        auto now = std::chrono::steady_clock::now();
+        phase_->Record(now - start_);
+        phase_ = phase;
+        start_ = now;
+    }
+
+private:
+    LatencyHistogram* phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Подготовленная форма вычисляется в области параметров, поэтому определение вне тела
+// лямбды осталось бы в ней, а не в глобальной области.
+bool DefinesOutsideLambda(const Ref<Object>& form) {
+    auto cell = As<Cell>(form);
+    if (!cell) {
+        return false;
+    }
+    if (auto head = As<Symbol>(cell->GetFirst())) {
+        if (head->GetName() == "define") {
+            return true;
+        }
+        if (head->GetName() == "lambda" || head->GetName() == "quote") {
+            return false;
+        }
+    }
+    for (; cell; cell = As<Cell>(cell->GetSecond())) {
+        if (DefinesOutsideLambda(cell->GetFirst())) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    scope_->SetElementScope("max", std::make_shared<Max>());
-    scope_->SetElementScope("min", std::make_shared<Min>());
-    scope_->SetElementScope("abs", std::make_shared<Abs>());
+}  // namespace
 
-    scope_->SetElementScope("not", std::make_shared<Not>());
-    scope_->SetElementScope("and", std::make_shared<And>());
-    scope_->SetElementScope("or", std::make_shared<Or>());
+Scheme::EvalContext::EvalContext(Scheme* scheme)
+    : globals_(scheme->scope_.get()),
+      heap_(scheme->heap_.get()),
+      budget_(&scheme->fuel_, scheme->timeout_),
+      profiler_(scheme->profiler_.get()) {
+    scheme->Refresh();
+}
 
-    scope_->SetElementScope("define", std::make_shared<Define>());
-    scope_->SetElementScope("set!", std::make_shared<Set>());
+Scheme::EvalContext::EvalContext(Scheme* scheme, std::chrono::steady_clock::time_point deadline)
+    : globals_(scheme->scope_.get()),
+      heap_(scheme->heap_.get()),
+      budget_(&scheme->fuel_, deadline),
+      profiler_(scheme->profiler_.get()) {
+    scheme->Refresh();
+}
 
-    scope_->SetElementScope("if", std::make_shared<If>());
+Scheme::Scheme()
+    : heap_(HeapAccount::Create()),
+      scope_(MakeScope(heap_.get())),
+      base_(scope_),
+      optimizer_(scope_) {
+    HeapAccount::Activation heap{heap_.get()};
+    AddBuiltins(scope_);
+}
 
-    scope_->SetElementScope("cons", std::make_shared<Cons>());
-    scope_->SetElementScope("car", std::make_shared<Car>());
-    scope_->SetElementScope("cdr", std::make_shared<Cdr>());
-    scope_->SetElementScope("set-car!", std::make_shared<SetCar>());
-    scope_->SetElementScope("set-cdr!", std::make_shared<SetCdr>());
+Scheme::Scheme(const Scheme& parent, const Ref<Scope>& frozen)
+    : heap_(HeapAccount::Create()),
+      scope_(MakeScope(heap_.get())),
+      base_(parent.base_),
+      optimizer_(parent.optimizer_),
+      shared_(parent.shared_),
+      replica_(parent.replica_),
+      fuel_(parent.fuel_),
+      timeout_(parent.timeout_) {
+    heap_->SetLimits(parent.heap_->SoftLimit(), parent.heap_->HardLimit());
+    scope_->SetParentScope(frozen);
+}
 
-    scope_->SetElementScope("list", std::make_shared<List>());
-    scope_->SetElementScope("list-ref", std::make_shared<ListRef>());
-    scope_->SetElementScope("list-tail", std::make_shared<ListTail>());
+Scheme Scheme::Clone() {
+    // Пустой верхний слой остаётся от прошлого клонирования: повторно его не замораживаем,
+    // чтобы цепочка областей не росла от серии клонов.
+    Ref<Scope> frozen = scope_->GetParentScope();
+    if (!scope_->GetElements().empty() || !frozen || !frozen->IsFrozen()) {
+        frozen = scope_;
+        frozen->Freeze();
+        scope_ = MakeScope(heap_.get());
+        scope_->SetParentScope(frozen);
+    }
+    return Scheme{*this, frozen};
 }
 
 std::string Scheme::Evaluate(const std::string& expression) {
+    EvalContext context{this};
+    EvaluateLatencies& latencies = GlobalEvaluateLatencies();
+    PhaseTimer timer{&latencies.read};
     std::stringstream ss{expression};
     Tokenizer tokenizer{&ss};
     auto obj = Read(&tokenizer);
     if (!obj) {
         throw RuntimeError{"Пусто"};
     }
+    timer.Next(&latencies.optimize);
+    obj = optimizer_.Optimize(obj);
+    timer.Next(&latencies.eval);
     auto asd = obj->Eval(scope_);
+    timer.Next(&latencies.print);
     return asd->Print();
 }
+
+EvalTask Scheme::EvaluateAsync(std::string expression) {
+    std::vector<Ref<Object>> forms;
+    {
+        // Разобранные формы — тоже память интерпретатора.
+        EvalContext context{this};
+        std::stringstream ss{expression};
+        Tokenizer tokenizer{&ss};
+        forms = ReadAll(&tokenizer);
+    }
+    if (forms.empty()) {
+        throw RuntimeError{"Пусто"};
+    }
+    std::string result;
+    for (size_t i = 0; i < forms.size(); ++i) {
+        if (i > 0) {
+            co_await EvalTask::Yield{};
+        }
+        if (!forms[i]) {
+            throw RuntimeError{"Пусто"};
+        }
+        auto deadline = timeout_.count() > 0 ? std::chrono::steady_clock::now() + timeout_
+                                             : std::chrono::steady_clock::time_point::max();
+        std::optional<EvalMachine> machine;
+        {
+            EvalContext context{this, deadline};
+            machine.emplace(optimizer_.Optimize(forms[i]), scope_);
+        }
+        while (true) {
+            {
+                EvalContext context{this, deadline};
+                if (machine->Run()) {
+                    result = machine->Result()->Print();
+                    break;
+                }
+            }
+            co_await EvalTask::Suspend{machine->Suspended()};
+        }
+    }
+    co_return result;
+}
+
+Value Scheme::CallWith(const std::string& name, const Marshaller& marshal) {
+    EvalContext context{this};
+    auto function = scope_->GetElementScope(name);
+    ++runtime_stats.applies;
+    return Value{function->Apply(MakeArguments(marshal()), scope_)};
+}
+
+const std::vector<std::string>& PreparedExpression::Parameters() const {
+    return parameters_;
+}
+
+PreparedExpression Scheme::Prepare(const std::string& expression,
+                                   std::vector<std::string> parameters) {
+    EvalContext context{this};
+    std::stringstream ss{expression};
+    Tokenizer tokenizer{&ss};
+    auto form = Read(&tokenizer);
+    if (!form) {
+        throw RuntimeError{"Пусто"};
+    }
+    if (DefinesOutsideLambda(form)) {
+        throw SyntaxError{"define в подготовленной форме: определения делаются через Evaluate"};
+    }
+    PreparedExpression prepared;
+    prepared.scope_ = MakeRef<Scope>();
+    prepared.scope_->SetParentScope(scope_);
+    for (const auto& name : parameters) {
+        if (prepared.scope_->GetElements().count(name)) {
+            throw SyntaxError{"Параметр " + name + " повторяется"};
+        }
+        prepared.scope_->SetElementScope(name, MakeRef<Boolean>(false));
+    }
+    for (const auto& name : parameters) {
+        prepared.slots_.push_back(prepared.scope_->FindCell(name));
+    }
+    prepared.form_ = optimizer_.Optimize(
+        form, Optimizer::Locals(parameters.begin(), parameters.end()));
+    prepared.parameters_ = std::move(parameters);
+    return prepared;
+}
+
+Value Scheme::RunWith(const PreparedExpression& prepared, const Marshaller& marshal) {
+    EvalContext context{this};
+    auto args = marshal();
+    if (args.size() != prepared.slots_.size()) {
+        throw RuntimeError{"Неверное количество параметров: ожидалось " +
+                           std::to_string(prepared.slots_.size())};
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+        *prepared.slots_[i] = args[i];
+    }
+    return Value{prepared.form_->Eval(prepared.scope_)};
+}
+
+std::string Scheme::LoadFasl(const std::string& path) {
+    std::ifstream in{path, std::ios::binary};
+    if (!in) {
+        throw RuntimeError{"Не удалось открыть " + path};
+    }
+    EvalContext context{this};
+    std::string result;
+    for (const auto& form : ReadFasl(&in)) {
+        if (!form) {
+            throw RuntimeError{"Пусто"};
+        }
+        result = optimizer_.Optimize(form)->Eval(scope_)->Print();
+    }
+    return result;
+}
+
+std::string Scheme::LoadSource(const std::string& path) {
+    std::ifstream in{path};
+    if (!in) {
+        throw RuntimeError{"Не удалось открыть " + path};
+    }
+    EvalContext context{this};
+    Tokenizer tokenizer{&in};
+    std::string result;
+    for (const auto& form : ReadAll(&tokenizer)) {
+        if (!form) {
+            throw RuntimeError{"Пусто"};
+        }
+        result = optimizer_.Optimize(form)->Eval(scope_)->Print();
+    }
+    return result;
+}
+
+void Scheme::SaveImage(const std::string& path) {
+    std::ofstream out{path, std::ios::binary};
+    if (!out) {
+        throw RuntimeError{"Не удалось открыть " + path};
+    }
+    SaveImage(&out);
+}
+
+void Scheme::SaveImage(std::ostream* out) {
+    WriteImage(scope_, out);
+}
+
+Scheme Scheme::FromImage(const std::string& path) {
+    std::ifstream in{path, std::ios::binary};
+    if (!in) {
+        throw RuntimeError{"Не удалось открыть " + path};
+    }
+    return FromImage(&in);
+}
+
+Scheme Scheme::FromImage(std::istream* in) {
+    Scheme scheme;
+    HeapAccount::Activation heap{scheme.heap_.get()};
+    ReadImage(in, scheme.scope_);
+    scheme.base_ = scheme.scope_;
+    return scheme;
+}
+
+void Scheme::EnableProfiler() {
+    if (!profiler_) {
+        profiler_ = std::make_unique<Profiler>();
+    }
+}
+
+void Scheme::DisableProfiler() {
+    profiler_.reset();
+}
+
+std::string Scheme::ProfileReport() const {
+    if (!profiler_) {
+        throw RuntimeError{"Профилировщик не включён"};
+    }
+    return profiler_->Report();
+}
+
+StatsSnapshot Scheme::Stats() const {
+    return TakeStats();
+}
+
+void Scheme::ResetStats() {
+    ::ResetStats();
+}
+
+void Scheme::Attach(std::shared_ptr<SharedEnvironment> environment) {
+    shared_ = std::move(environment);
+    {
+        HeapAccount::Activation heap{heap_.get()};
+        replica_ = std::make_shared<SharedEnvironment::Replica>();
+    }
+    base_->SetParentScope(replica_->GetScope());
+    EvalContext context{this};
+}
+
+void Scheme::Refresh() {
+    if (shared_) {
+        replica_->Refresh(*shared_);
+    }
+}
+
+void Scheme::SetFuel(int64_t fuel) {
+    fuel_ = fuel;
+}
+
+int64_t Scheme::Fuel() const {
+    return fuel_;
+}
+
+void Scheme::SetTimeout(std::chrono::nanoseconds timeout) {
+    timeout_ = timeout;
+}
+
+void Scheme::SetHeapLimits(size_t soft, size_t hard) {
+    heap_->SetLimits(soft, hard);
+}
+
+void Scheme::SetSoftHeapLimitHandler(std::function<void(size_t used)> handler) {
+    heap_->SetSoftLimitHandler(std::move(handler));
+}
+
+size_t Scheme::HeapUsed() const {
+    return heap_->Used();
+}
+
+void Scheme::DefineChannel(const std::string& name, std::shared_ptr<Channel> channel) {
+    EvalContext context{this};
+    scope_->SetElementScope(name, MakeRef<ChannelObject>(std::move(channel)));
+}
+
+std::shared_ptr<Channel> Scheme::GetChannel(const std::string& name) {
+    auto channel = As<ChannelObject>(scope_->GetElementScope(name));
+    if (!channel) {
+        throw RuntimeError{name + " не канал"};
+    }
+    return channel->GetChannel();
+}
+
+void Scheme::EnableTrace() {
+    eval_trace.enabled = true;
+}
+
+void Scheme::DisableTrace() {
+    eval_trace.enabled = false;
+    eval_trace.Clear();
+}
+
+std::string Scheme::TraceDump() const {
+    return eval_trace.Dump();
+}
+
+EvaluateLatencies& Scheme::Latencies() {
+    return GlobalEvaluateLatencies();
+}
@@ -1,15 +1,205 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <sstream>
 #include <string>
 #include "parser.h"
+#include "async.h"
+#include "budget.h"
+#include "optimizer.h"
+#include "channel.h"
+#include "environment.h"
+#include "latency.h"
+#include "native.h"
+#include "profiler.h"
+#include "stats.h"
 
+// Выражение, разобранное и оптимизированное один раз (см. Scheme::Prepare). Параметры
+// живут в собственной области выражения над глобальной, и Run только переписывает
+// их значения. Используется с тем интерпретатором, который его создал.
+class PreparedExpression {
+public:
+    const std::vector<std::string>& Parameters() const;
+
+private:
+    friend class Scheme;
+
+    Ref<Object> form_;
+    Ref<Scope> scope_;
+    std::vector<std::string> parameters_;
+    std::vector<Ref<Object>*> slots_;
+};
+
+// Экземпляр не потокобезопасен: в каждый момент им пользуется один поток. Разные
+// экземпляры не разделяют изменяемых объектов, поэтому могут работать параллельно
+// (см. SchemePool).
 class Scheme {
 public:
     Scheme();
 
+    // Копия интерпретатора за время, не зависящее от размера окружения. Текущая
+    // глобальная область замораживается и становится общей, а новые define, set! и
+    // set-car! каждого из интерпретаторов ложатся в его собственный верхний слой.
+    // Лямбды, созданные до клонирования, делят свой кадр аргументов, а объекты общие,
+    // поэтому клон используется в том же потоке; для других потоков есть SchemePool.
+    Scheme Clone();
+
     std::string Evaluate(const std::string& expression);
 
+    // Сопрограмма, которая вычисляет формы выражения по одной и уступает управление
+    // перед каждой следующей (см. EvalScheduler). Формы вычисляет EvalMachine, поэтому
+    // задача уступает и посреди формы: раз в EvalBudget::kSlice вызовов и вместо
+    // ожидания канала или touch. Интерпретатор должен пережить задачу.
+    EvalTask EvaluateAsync(std::string expression);
+
+    // Вызывает процедуру name с аргументами C++, минуя токенизатор; результат
+    // приводится к нужному типу через Value::As (см. Marshal).
+    template <class... Args>
+    Value Call(const std::string& name, Args&&... args) {
+        return CallWith(name, [&] {
+            return std::vector<Ref<Object>>{
+                MarshalOf<Args>::ToScheme(std::forward<Args>(args))...};
+        });
+    }
+
+    // Связывает name с функцией C++. Преобразования аргументов и результата
+    // выводятся из её сигнатуры при компиляции. Такую привязку нельзя сохранить в образ.
+    template <class F>
+    void Register(const std::string& name, F function) {
+        EvalContext context{this};
+        scope_->SetElementScope(name, MakeNative(name, std::move(function)));
+    }
+
+    // Разбирает и оптимизирует одну форму, в которой parameters — свободные имена,
+    // связываемые при каждом Run. Лямбды в форме видят параметры последнего запуска.
+    // define вне тела лямбды запрещён (SyntaxError): форма вычисляется в области
+    // параметров, и определение пропало бы вместе с ней.
+    PreparedExpression Prepare(const std::string& expression,
+                               std::vector<std::string> parameters = {});
+
+    // Вычисляет подготовленную форму без токенизатора и разбора; значения параметров
+    // передаются по порядку и преобразуются через Marshal.
+    template <class... Args>
+    Value Run(const PreparedExpression& prepared, Args&&... args) {
+        return RunWith(prepared, [&] {
+            return std::vector<Ref<Object>>{
+                MarshalOf<Args>::ToScheme(std::forward<Args>(args))...};
+        });
+    }
+
+    std::string LoadFasl(const std::string& path);
+
+    // Вычисляет по очереди все формы исходного файла, возвращает результат последней.
+    std::string LoadSource(const std::string& path);
+
+    void SaveImage(const std::string& path);
+
+    void SaveImage(std::ostream* out);
+
+    static Scheme FromImage(const std::string& path);
+
+    static Scheme FromImage(std::istream* in);
+
+    // Включает профилирование вызовов; статистика копится до DisableProfiler.
+    void EnableProfiler();
+
+    void DisableProfiler();
+
+    std::string ProfileReport() const;
+
+    // Счётчики времени выполнения вызывающего потока (см. stats.h).
+    StatsSnapshot Stats() const;
+
+    void ResetStats();
+
+    // Подключает общее окружение: его определения видны как внешняя область
+    // глобальной и обновляются перед каждым вычислением, если писатель опубликовал
+    // новый снимок. Собственные define, set! и set-car! интерпретатора остаются у него.
+    void Attach(std::shared_ptr<SharedEnvironment> environment);
+
+    // Связывает name с каналом, чтобы по нему могли обмениваться интерпретаторы
+    // разных потоков.
+    void DefineChannel(const std::string& name, std::shared_ptr<Channel> channel);
+
+    // Канал, созданный программой через make-channel и связанный с name.
+    std::shared_ptr<Channel> GetChannel(const std::string& name);
+
+    // Топливо: каждый вызов процедуры или особой формы тратит единицу, и когда оно
+    // кончается, вычисление прерывается FuelExhausted. Остаток переходит между
+    // вычислениями; EvalBudget::kUnlimited (по умолчанию) снимает ограничение.
+    void SetFuel(int64_t fuel);
+
+    // Остаток топлива; по нему можно делить время между интерпретаторами.
+    int64_t Fuel() const;
+
+    // Срок одного Evaluate (при EvaluateAsync — одной формы), после которого оно
+    // прерывается DeadlineExceeded. Ноль снимает ограничение.
+    void SetTimeout(std::chrono::nanoseconds timeout);
+
+    // Пределы памяти интерпретатора в байтах: объекты, созданные во время его
+    // вычислений, и привязки его областей. Переход через мягкий предел вызывает
+    // обработчик, жёсткий прерывает вычисление HeapLimitExceeded.
+    void SetHeapLimits(size_t soft, size_t hard);
+
+    void SetSoftHeapLimitHandler(std::function<void(size_t used)> handler);
+
+    size_t HeapUsed() const;
+
+    // Трассировка вызовов вызывающего потока (см. trace.h). При ошибке содержимое
+    // буфера сохраняется в EvalError::Trace().
+    void EnableTrace();
+
+    void DisableTrace();
+
+    std::string TraceDump() const;
+
+    // Длительности фаз Evaluate по всем интерпретаторам процесса (см. latency.h).
+    static EvaluateLatencies& Latencies();
+
 private:
-    std::shared_ptr<Scope> scope_;
+    friend class SharedEnvironment;
+
+    // Состояние потока на время работы с интерпретатором: его глобальная область,
+    // счёт памяти, бюджет и профилировщик; общее окружение перед этим обновляется.
+    class EvalContext {
+    public:
+        explicit EvalContext(Scheme* scheme);
+
+        // Срок задан моментом: части одной формы EvaluateAsync делят её срок.
+        EvalContext(Scheme* scheme, std::chrono::steady_clock::time_point deadline);
+
+        EvalContext(const EvalContext&) = delete;
+        EvalContext& operator=(const EvalContext&) = delete;
+
+    private:
+        Scope::ActiveGlobals globals_;
+        HeapAccount::Activation heap_;
+        EvalBudget::Activation budget_;
+        Profiler::Activation profiler_;
+    };
+
+    Scheme(const Scheme& parent, const Ref<Scope>& frozen);
+
+    void Refresh();
+
+    // Аргументы преобразуются уже внутри EvalContext, на счёт этого интерпретатора.
+    using Marshaller = std::function<std::vector<Ref<Object>>()>;
+
+    Value CallWith(const std::string& name, const Marshaller& marshal);
+
+    Value RunWith(const PreparedExpression& prepared, const Marshaller& marshal);
+
+    // Объявлен первым: глобальная область создаётся уже на его счёт.
+    HeapAccount::Owner heap_;
+    Ref<Scope> scope_;
+    // Нижний слой глобальных областей: под него подключается общее окружение.
+    Ref<Scope> base_;
+    Optimizer optimizer_;
+    std::unique_ptr<Profiler> profiler_;
+    std::shared_ptr<SharedEnvironment> shared_;
+    std::shared_ptr<SharedEnvironment::Replica> replica_;
+    int64_t fuel_ = EvalBudget::kUnlimited;
+    std::chrono::nanoseconds timeout_{0};
 };
@@ -0,0 +1,87 @@
+#include "stats.h"
+
+#include <cxxabi.h>
+
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+std::mutex type_names_mutex;
+std::vector<std::string> type_names;
+
+std::string Demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result = status == 0 ? demangled : name;
+    std::free(demangled);
+    return result;
+}
+
+}  // namespace
+
+size_t RegisterObjectType(const std::type_info& type) {
+    std::lock_guard lock{type_names_mutex};
+    // Последняя ячейка собирает все типы, которым не хватило места.
+    if (type_names.size() + 1 == RuntimeStats::kMaxObjectTypes) {
+        type_names.push_back("other");
+    }
+    if (type_names.size() == RuntimeStats::kMaxObjectTypes) {
+        return RuntimeStats::kMaxObjectTypes - 1;
+    }
+    type_names.push_back(Demangle(type.name()));
+    return type_names.size() - 1;
+}
+
+StatsSnapshot TakeStats() {
+    const RuntimeStats& stats = runtime_stats;
+    StatsSnapshot snapshot;
+    {
+        std::lock_guard lock{type_names_mutex};
+        for (size_t i = 0; i < type_names.size(); ++i) {
+            if (stats.allocations[i]) {
+                snapshot.allocations[type_names[i]] += stats.allocations[i];
+            }
+        }
+    }
+    snapshot.live_objects = stats.live_objects;
+    snapshot.peak_live_objects = stats.peak_live_objects;
+    snapshot.evals = stats.evals;
+    snapshot.applies = stats.applies;
+    snapshot.scope_lookups = stats.scope_lookups;
+    if (stats.scope_lookups) {
+        snapshot.average_scope_depth =
+            static_cast<double>(stats.scope_depth) / static_cast<double>(stats.scope_lookups);
+    }
+    snapshot.symbol_cache_hits = stats.symbol_cache_hits;
+    snapshot.tokens = stats.tokens;
+    snapshot.parsed_nodes = stats.parsed_nodes;
+    return snapshot;
+}
+
+void ResetStats() {
+    RuntimeStats& stats = runtime_stats;
+    int64_t live = stats.live_objects;
+    stats = RuntimeStats{};
+    stats.live_objects = live;
+    stats.peak_live_objects = live;
+}
+
+std::string StatsSnapshot::ToString() const {
+    std::stringstream ss;
+    ss << "evals " << evals << '\n';
+    ss << "applies " << applies << '\n';
+    ss << "scope-lookups " << scope_lookups << '\n';
+    ss << "average-scope-depth " << average_scope_depth << '\n';
+    ss << "symbol-cache-hits " << symbol_cache_hits << '\n';
+    ss << "tokens " << tokens << '\n';
+    ss << "parsed-nodes " << parsed_nodes << '\n';
+    ss << "live-objects " << live_objects << '\n';
+    ss << "peak-live-objects " << peak_live_objects << '\n';
+    for (const auto& [type, count] : allocations) {
+        ss << "allocated " << type << ' ' << count << '\n';
+    }
+    return ss.str();
+}
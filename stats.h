@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <typeinfo>
+
+// Всегда включённые счётчики интерпретатора. Каждый поток пишет в свой экземпляр,
+// поэтому обновление счётчика стоит одной записи в thread_local память.
+struct RuntimeStats {
+    static constexpr size_t kMaxObjectTypes = 64;
+
+    std::array<uint64_t, kMaxObjectTypes> allocations{};
+    int64_t live_objects = 0;
+    int64_t peak_live_objects = 0;
+
+    // Вычисленные составные формы, включая свёрнутые оптимизатором.
+    uint64_t evals = 0;
+    // Вызовы Apply у процедуры формы; (lambda ...) и свёрнутые формы их не делают.
+    uint64_t applies = 0;
+    uint64_t scope_lookups = 0;
+    uint64_t scope_depth = 0;
+    uint64_t symbol_cache_hits = 0;
+    uint64_t tokens = 0;
+    uint64_t parsed_nodes = 0;
+};
+
+inline thread_local RuntimeStats runtime_stats;
+
+// Номер типа объекта в RuntimeStats::allocations; выдаётся один раз на тип.
+size_t RegisterObjectType(const std::type_info& type);
+
+template <class T>
+size_t ObjectTypeIndex() {
+    static const size_t index = RegisterObjectType(typeid(T));
+    return index;
+}
+
+// Снимок счётчиков текущего потока с именами типов вместо номеров.
+struct StatsSnapshot {
+    std::map<std::string, uint64_t> allocations;
+    int64_t live_objects = 0;
+    int64_t peak_live_objects = 0;
+    uint64_t evals = 0;
+    uint64_t applies = 0;
+    uint64_t scope_lookups = 0;
+    double average_scope_depth = 0;
+    uint64_t symbol_cache_hits = 0;
+    uint64_t tokens = 0;
+    uint64_t parsed_nodes = 0;
+
+    // Строки вида "name value", по одной на счётчик.
+    std::string ToString() const;
+};
+
+StatsSnapshot TakeStats();
+
+// Обнуляет счётчики текущего потока; число живых объектов сохраняется.
+void ResetStats();
@@ -0,0 +1,126 @@
+#include "alloc_counter.h"
+
+#include <cxxabi.h>
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+#include <ref.h>
+
+namespace {
+
+thread_local AllocationCounter* active_counter = nullptr;
+thread_local AllocationStats* active_stats = nullptr;
+thread_local bool paused = false;
+
+void* CountedAllocate(size_t size) {
+    if (active_stats && !paused) {
+        ++active_stats->count;
+        active_stats->bytes += size;
+    }
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+std::string Demangle(const char* name) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string result = status == 0 ? demangled : name;
+    std::free(demangled);
+    return result;
+}
+
+void CountObject(const std::type_info& type, size_t size) {
+    if (!active_stats || paused) {
+        return;
+    }
+    paused = true;
+    auto& stats = active_stats->by_type[Demangle(type.name())];
+    ++stats.count;
+    stats.bytes += size;
+    paused = false;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return CountedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+    return CountedAllocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return CountedAllocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return CountedAllocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+std::string AllocationStats::Report() const {
+    std::stringstream ss;
+    ss << count << " allocations, " << bytes << " bytes";
+    for (const auto& [type, stats] : by_type) {
+        ss << "\n  " << type << ": " << stats.count << " objects, " << stats.bytes << " bytes";
+    }
+    return ss.str();
+}
+
+AllocationCounter::AllocationCounter() : previous_(active_counter) {
+    active_counter = this;
+    active_stats = &stats_;
+    allocation_hook = CountObject;
+}
+
+AllocationCounter::~AllocationCounter() {
+    Stop();
+}
+
+AllocationStats AllocationCounter::Stop() {
+    if (!stopped_) {
+        stopped_ = true;
+        active_counter = previous_;
+        active_stats = previous_ ? &previous_->stats_ : nullptr;
+        if (!previous_) {
+            allocation_hook = nullptr;
+        }
+    }
+    return stats_;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+struct AllocationStats {
+    struct TypeStats {
+        size_t count = 0;
+        size_t bytes = 0;
+    };
+
+    size_t count = 0;
+    size_t bytes = 0;
+    std::map<std::string, TypeStats> by_type;
+
+    std::string Report() const;
+};
+
+// От создания до Stop() считает все вызовы глобального operator new в текущем потоке,
+// а создание объектов интерпретатора дополнительно раскладывает по типам.
+class AllocationCounter {
+public:
+    AllocationCounter();
+
+    ~AllocationCounter();
+
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    AllocationStats Stop();
+
+private:
+    AllocationStats stats_;
+    AllocationCounter* previous_;
+    bool stopped_ = false;
+};
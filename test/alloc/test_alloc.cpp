@@ -0,0 +1,71 @@
+#include <test/scheme_test.h>
+#include <test/alloc/alloc_counter.h>
+
+#include <object.h>
+
+namespace {
+
+// Первое вычисление прогревает кэши символов и статические таблицы встроенных
+// функций, считается только повторное.
+AllocationStats Measure(Scheme* scheme, const std::string& expression) {
+    scheme->Evaluate(expression);
+    AllocationCounter counter;
+    scheme->Evaluate(expression);
+    return counter.Stop();
+}
+
+size_t Objects(const AllocationStats& stats, const std::string& type) {
+    auto it = stats.by_type.find(type);
+    return it == stats.by_type.end() ? 0 : it->second.count;
+}
+
+}  // namespace
+
+TEST_CASE("AllocationsOfArithmetic") {
+    Scheme scheme;
+    auto stats = Measure(&scheme, "(+ 1 2)");
+    INFO(stats.Report());
+    REQUIRE(stats.count <= 18);
+    REQUIRE(Objects(stats, "Number") <= 3);
+    REQUIRE(Objects(stats, "Cell") <= 5);
+}
+
+TEST_CASE("AllocationsOfBuiltinCall") {
+    Scheme scheme;
+    scheme.Evaluate("(define x 0)");
+    scheme.Evaluate("(set! x 5)");
+    auto stats = Measure(&scheme, "(number? (+ x 1 2 3 4 5 6 7))");
+    INFO(stats.Report());
+    REQUIRE(stats.count <= 32);
+    REQUIRE(Objects(stats, "Scope") == 0);
+}
+
+TEST_CASE("AllocationsOfLambdaCall") {
+    Scheme scheme;
+    scheme.Evaluate("(define add (lambda (x y) (+ x y)))");
+    auto stats = Measure(&scheme, "(add 3 4)");
+    INFO(stats.Report());
+    REQUIRE(Objects(stats, "Scope") == 0);
+    REQUIRE(Objects(stats, "Lambda") == 0);
+    REQUIRE(stats.count <= 12);
+}
+
+TEST_CASE("AllocationsOfLambdaCreation") {
+    Scheme scheme;
+    auto stats = Measure(&scheme, "(define g (lambda (x) x))");
+    INFO(stats.Report());
+    // Только результат define: встроенные функции лямбды своих объектов не создают.
+    REQUIRE(Objects(stats, "Boolean") <= 1);
+}
+
+TEST_CASE("AllocationsOfParser") {
+    std::string program = "(define (f x) (if (< x 1) 'done (f (- x 1))))";
+    AllocationCounter counter;
+    std::stringstream ss{program};
+    Tokenizer tokenizer{&ss};
+    Read(&tokenizer);
+    auto stats = counter.Stop();
+    INFO(stats.Report());
+    REQUIRE(Objects(stats, "Cell") <= 20);
+    REQUIRE(stats.count <= 36);
+}
@@ -0,0 +1,232 @@
+#include <test/scheme_test.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "future.h"
+#include "scheme.h"
+
+namespace {
+
+EvalTask Sum(Scheme* scheme) {
+    auto first = co_await scheme->EvaluateAsync("(define a 1) (+ a 1)");
+    auto second = co_await scheme->EvaluateAsync("(define b 10) (+ b a)");
+    co_return first + " " + second;
+}
+
+}  // namespace
+
+TEST_CASE("EvaluateAsyncYieldsBetweenForms") {
+    Scheme scheme;
+    auto task = scheme.EvaluateAsync("(define x 1) (set! x (+ x 1)) x");
+    REQUIRE_FALSE(task.Done());
+    REQUIRE_FALSE(task.Resume());
+    REQUIRE(scheme.Evaluate("x") == "1");
+    REQUIRE_FALSE(task.Resume());
+    REQUIRE(scheme.Evaluate("x") == "2");
+    REQUIRE(task.Resume());
+    REQUIRE(task.Result() == "2");
+}
+
+TEST_CASE("EvaluateAsyncErrors") {
+    Scheme scheme;
+    auto task = scheme.EvaluateAsync("(define x 1) y");
+    REQUIRE_FALSE(task.Resume());
+    REQUIRE(task.Resume());
+    REQUIRE_THROWS_AS(task.Result(), NameError);
+
+    auto empty = scheme.EvaluateAsync("");
+    REQUIRE(empty.Resume());
+    REQUIRE_THROWS_AS(empty.Result(), RuntimeError);
+}
+
+TEST_CASE("EvaluateAsyncAwait") {
+    Scheme scheme;
+    auto task = Sum(&scheme);
+    int resumes = 1;
+    while (!task.Resume()) {
+        ++resumes;
+    }
+    REQUIRE(resumes == 3);
+    REQUIRE(task.Result() == "2 11");
+}
+
+TEST_CASE("EvaluateAsyncYieldsInsideForm") {
+    Scheme scheme;
+    scheme.Evaluate("(define count (lambda (n) (if (= n 0) 0 (+ 1 (count (- n 1))))))");
+    auto task = scheme.EvaluateAsync("(count 20000)");
+    int resumes = 1;
+    while (!task.Resume()) {
+        REQUIRE_FALSE(task.Suspended().blocked);
+        // Пока форма приостановлена, интерпретатор свободен.
+        if (resumes == 1) {
+            REQUIRE(scheme.Evaluate("(+ 1 2)") == "3");
+        }
+        ++resumes;
+    }
+    REQUIRE(resumes > 2);
+    REQUIRE(task.Result() == "20000");
+}
+
+TEST_CASE("EvaluateAsyncLimitsSuspendedForm") {
+    Scheme scheme;
+    scheme.Evaluate("(define loop (lambda (n) (if (= n 0) 0 (loop (- n 1)))))");
+    scheme.SetFuel(10000);
+    auto task = scheme.EvaluateAsync("(loop 100000)");
+    while (!task.Resume()) {
+    }
+    REQUIRE_THROWS_AS(task.Result(), FuelExhausted);
+    REQUIRE(scheme.Fuel() == 0);
+}
+
+TEST_CASE("EvaluateAsyncDropsSuspendedForm") {
+    Scheme scheme;
+    scheme.Evaluate("(define x 0)");
+    scheme.Evaluate("(define loop (lambda (n) (if (= n 0) 0 (loop (- n 1)))))");
+    {
+        auto task = scheme.EvaluateAsync("(set! x (+ 1 (loop 100000)))");
+        REQUIRE_FALSE(task.Resume());
+    }
+    REQUIRE(scheme.Evaluate("x") == "0");
+    REQUIRE(scheme.Evaluate("(loop 10)") == "0");
+}
+
+TEST_CASE("EvalSchedulerRunsReceiverBeforeSender") {
+    auto channel = std::make_shared<Channel>(1);
+    Scheme consumer;
+    Scheme producer;
+    consumer.DefineChannel("in", channel);
+    producer.DefineChannel("out", channel);
+    std::future<std::string> received;
+    std::future<std::string> sent;
+    {
+        // Один поток: получатель должен уснуть и отдать его отправителю.
+        EvalScheduler scheduler{1};
+        received = scheduler.Spawn(consumer.EvaluateAsync("(+ 1 (channel-receive in))"));
+        sent = scheduler.Spawn(producer.EvaluateAsync("(channel-send! out 41)"));
+    }
+    REQUIRE(received.get() == "42");
+    REQUIRE(sent.get() == "#t");
+}
+
+TEST_CASE("EvalSchedulerParksMoreSessionsThanThreads") {
+    constexpr int kSessions = 100;
+    auto channel = std::make_shared<Channel>(1);
+    std::vector<std::unique_ptr<Scheme>> schemes;
+    std::vector<std::future<std::string>> results;
+    Scheme producer;
+    producer.DefineChannel("out", channel);
+    producer.Evaluate(R"EOF(
+        (define produce (lambda (i n)
+          (if (> i n)
+              0
+              ((lambda (sent) (produce (+ i 1) n)) (channel-send! out i)))))
+    )EOF");
+    std::future<std::string> produced;
+    {
+        EvalScheduler scheduler{2};
+        for (int i = 0; i < kSessions; ++i) {
+            schemes.push_back(std::make_unique<Scheme>());
+            schemes.back()->DefineChannel("in", channel);
+            results.push_back(scheduler.Spawn(schemes.back()->EvaluateAsync("(channel-receive in)")));
+        }
+        produced = scheduler.Spawn(producer.EvaluateAsync(
+            "(produce 1 " + std::to_string(kSessions) + ")"));
+    }
+    REQUIRE(produced.get() == "0");
+    int sum = 0;
+    for (auto& result : results) {
+        sum += std::stoi(result.get());
+    }
+    REQUIRE(sum == kSessions * (kSessions + 1) / 2);
+}
+
+TEST_CASE("EvalSchedulerWakesParkedTaskAtDeadline") {
+    Scheme scheme;
+    scheme.DefineChannel("in", std::make_shared<Channel>(1));
+    scheme.SetTimeout(std::chrono::milliseconds{20});
+    std::future<std::string> result;
+    {
+        EvalScheduler scheduler{1};
+        result = scheduler.Spawn(scheme.EvaluateAsync("(channel-receive in)"));
+    }
+    REQUIRE_THROWS_AS(result.get(), DeadlineExceeded);
+}
+
+TEST_CASE("EvalSchedulerTouchesFutures") {
+    TaskPool::SetDefaultSize(2);
+    constexpr int kSessions = 8;
+    std::vector<std::unique_ptr<Scheme>> schemes;
+    std::vector<std::future<std::string>> results;
+    {
+        EvalScheduler scheduler{1};
+        for (int i = 0; i < kSessions; ++i) {
+            schemes.push_back(std::make_unique<Scheme>());
+            schemes.back()->Evaluate(
+                "(define count (lambda (n) (if (= n 0) 0 (+ 1 (count (- n 1))))))");
+            results.push_back(scheduler.Spawn(
+                schemes.back()->EvaluateAsync("(+ 1 (touch (future (count 2000))))")));
+        }
+    }
+    for (auto& result : results) {
+        REQUIRE(result.get() == "2001");
+    }
+    TaskPool::SetDefaultSize(1);
+}
+
+TEST_CASE("EvalSchedulerMultiplexesTasks") {
+    constexpr int kTasks = 200;
+    std::vector<std::unique_ptr<Scheme>> schemes;
+    std::vector<std::future<std::string>> results;
+    {
+        EvalScheduler scheduler{4};
+        for (int i = 0; i < kTasks; ++i) {
+            schemes.push_back(std::make_unique<Scheme>());
+            std::string program = "(define n " + std::to_string(i) + ")";
+            for (int step = 0; step < 10; ++step) {
+                program += " (set! n (+ n 1))";
+            }
+            results.push_back(scheduler.Spawn(schemes.back()->EvaluateAsync(program + " n")));
+        }
+        schemes.push_back(std::make_unique<Scheme>());
+        results.push_back(scheduler.Spawn(schemes.back()->EvaluateAsync("(1)")));
+    }
+    for (int i = 0; i < kTasks; ++i) {
+        REQUIRE(results[i].get() == std::to_string(i + 10));
+    }
+    REQUIRE_THROWS_AS(results.back().get(), RuntimeError);
+}
+
+TEST_CASE("EvaluateAsyncKeepsManySuspendedTasks") {
+    constexpr int kTasks = 10000;
+    Scheme scheme;
+    scheme.Evaluate("(define n 0)");
+    std::vector<EvalTask> tasks;
+    tasks.reserve(kTasks);
+    for (int i = 0; i < kTasks; ++i) {
+        tasks.push_back(scheme.EvaluateAsync("(set! n (+ n 1)) n"));
+        REQUIRE_FALSE(tasks.back().Resume());
+    }
+    REQUIRE(scheme.Evaluate("n") == std::to_string(kTasks));
+    for (auto& task : tasks) {
+        REQUIRE(task.Resume());
+    }
+    REQUIRE(tasks.back().Result() == std::to_string(kTasks));
+}
+
+TEST_CASE("EvaluateAsyncChargesParsedForms") {
+    Scheme scheme;
+    std::string big = "(quote (";
+    for (int i = 0; i < 1000; ++i) {
+        big += " " + std::to_string(i);
+    }
+    big += "))";
+    size_t baseline = scheme.HeapUsed();
+    auto task = scheme.EvaluateAsync("1 " + big);
+    REQUIRE_FALSE(task.Resume());
+    REQUIRE(scheme.HeapUsed() > baseline + 10000);
+    REQUIRE(task.Resume());
+}
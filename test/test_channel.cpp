@@ -0,0 +1,153 @@
+#include <test/scheme_test.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "channel.h"
+
+TEST_CASE_METHOD(SchemeTest, "ChannelSameInterpreter") {
+    ExpectNoError("(define ch (make-channel 2))");
+    ExpectEq("ch", "#<channel>");
+    ExpectEq("(channel-send! ch 5)", "#t");
+    ExpectEq("(channel-send! ch #f)", "#t");
+    ExpectEq("(channel-receive ch)", "5");
+    ExpectEq("(channel-receive ch)", "#f");
+
+    ExpectNoError("(define k 3)");
+    ExpectNoError("(channel-send! ch (lambda (x) (* x k)))");
+    ExpectNoError("(define f (channel-receive ch))");
+    ExpectNoError("(set! k 4)");
+    ExpectEq("(f 2)", "6");
+
+    ExpectNoError("(channel-send! ch '(1 2))");
+    ExpectEq("(channel-receive ch)", "(1 2)");
+
+    ExpectRuntimeError("(make-channel 0)");
+    ExpectRuntimeError("(channel-send! 1 2)");
+    ExpectRuntimeError("(channel-send! ch ch)");
+}
+
+TEST_CASE("ChannelBackpressure") {
+    Channel channel{2};
+    REQUIRE(channel.Capacity() == 2);
+    REQUIRE(channel.TrySend(MakeRef<Number>(1)));
+    REQUIRE(channel.TrySend(MakeRef<Number>(2)));
+    REQUIRE_FALSE(channel.TrySend(MakeRef<Number>(3)));
+    Ref<Object> value;
+    REQUIRE(channel.TryReceive(&value));
+    REQUIRE(value->Print() == "1");
+    REQUIRE(channel.TrySend(MakeRef<Number>(3)));
+    REQUIRE(channel.TryReceive(&value));
+    REQUIRE(channel.TryReceive(&value));
+    REQUIRE(value->Print() == "3");
+    REQUIRE_FALSE(channel.TryReceive(&value));
+
+    Channel single{1};
+    REQUIRE(single.TrySend(MakeRef<Number>(1)));
+    REQUIRE_FALSE(single.TrySend(MakeRef<Number>(2)));
+    REQUIRE(single.TryReceive(&value));
+    REQUIRE_FALSE(single.TryReceive(&value));
+}
+
+TEST_CASE("ChannelManyProducersAndConsumers") {
+    Channel channel{16};
+    constexpr int kThreads = 4;
+    constexpr int kMessages = 5000;
+    std::atomic<int64_t> sum = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&channel] {
+            for (int i = 1; i <= kMessages; ++i) {
+                channel.Send(MakeRef<Number>(i));
+            }
+        });
+        threads.emplace_back([&channel, &sum] {
+            int64_t local = 0;
+            for (int i = 0; i < kMessages; ++i) {
+                local += As<Number>(channel.Receive())->GetValue();
+            }
+            sum += local;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(sum == kThreads * int64_t{kMessages} * (kMessages + 1) / 2);
+}
+
+TEST_CASE("ChannelPipelineBetweenInterpreters") {
+    Scheme producer;
+    producer.Evaluate("(define out (make-channel 8))");
+    auto channel = producer.GetChannel("out");
+    producer.Evaluate(R"EOF(
+        (define produce (lambda (i n)
+          (if (> i n)
+              (channel-send! out 0)
+              ((lambda (sent) (produce (+ i 1) n)) (channel-send! out i)))))
+    )EOF");
+
+    std::string total;
+    std::thread consumer_thread{[channel, &total] {
+        Scheme consumer;
+        consumer.DefineChannel("in", channel);
+        consumer.Evaluate(R"EOF(
+            (define consume (lambda (acc)
+              ((lambda (value) (if (= value 0) acc (consume (+ acc value))))
+               (channel-receive in))))
+        )EOF");
+        total = consumer.Evaluate("(consume 0)");
+    }};
+    producer.Evaluate("(produce 1 200)");
+    consumer_thread.join();
+    REQUIRE(total == "20100");
+}
+
+TEST_CASE("ChannelWaitRespectsBudget") {
+    Scheme scheme;
+    scheme.Evaluate("(define ch (make-channel 1))");
+    scheme.SetTimeout(std::chrono::milliseconds{50});
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(scheme.Evaluate("(channel-receive ch)"), DeadlineExceeded);
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds{5});
+
+    scheme.SetTimeout(std::chrono::nanoseconds{0});
+    scheme.Evaluate("(channel-send! ch 1)");
+    scheme.SetFuel(20);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(channel-send! ch 2)"), FuelExhausted);
+    scheme.SetFuel(EvalBudget::kUnlimited);
+    REQUIRE(scheme.Evaluate("(channel-receive ch)") == "1");
+}
+
+TEST_CASE("ChannelWakesSleepingReceiver") {
+    Channel channel{1};
+    std::thread sender{[&channel] {
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        channel.Send(MakeRef<Number>(7));
+    }};
+    REQUIRE(channel.Receive()->Print() == "7");
+    sender.join();
+}
+
+TEST_CASE("ChannelBufferIsCharged") {
+    Scheme scheme;
+    size_t before = scheme.HeapUsed();
+    scheme.Evaluate("(define ch (make-channel 1000))");
+    REQUIRE(scheme.HeapUsed() >= before + Channel::BufferBytes(1000));
+    scheme.Evaluate("(set! ch 0)");
+    REQUIRE(scheme.HeapUsed() < before + 1000);
+
+    // Канал, отданный наружу, остаётся на счёте, пока его держат.
+    scheme.Evaluate("(define kept (make-channel 1000))");
+    auto kept = scheme.GetChannel("kept");
+    scheme.Evaluate("(set! kept 0)");
+    REQUIRE(scheme.HeapUsed() >= before + Channel::BufferBytes(1000));
+    kept.reset();
+    REQUIRE(scheme.HeapUsed() < before + 1000);
+
+    scheme.SetHeapLimits(scheme.HeapUsed() + 10000, scheme.HeapUsed() + 100000);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(make-channel 100000000)"), HeapLimitExceeded);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(make-channel 4000000000000000000)"), RuntimeError);
+    REQUIRE(scheme.Evaluate("(make-channel 10)") == "#<channel>");
+}
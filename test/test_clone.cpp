@@ -0,0 +1,84 @@
+#include <test/scheme_test.h>
+
+#include <string>
+
+#include "scheme.h"
+
+namespace {
+
+// Токенизатор не пускает цифры в имена, поэтому номер записывается буквами.
+std::string VariableName(int index) {
+    std::string name = "v";
+    for (; index; index /= 26) {
+        name += static_cast<char>('a' + index % 26);
+    }
+    return name;
+}
+
+}  // namespace
+
+TEST_CASE("CloneIsolatesBindings") {
+    Scheme parent;
+    parent.Evaluate("(define x 1)");
+    parent.Evaluate("(define add-x (lambda (y) (+ x y)))");
+
+    Scheme clone = parent.Clone();
+    REQUIRE(clone.Evaluate("(add-x 10)") == "11");
+
+    clone.Evaluate("(set! x 5)");
+    clone.Evaluate("(define z 7)");
+    REQUIRE(clone.Evaluate("x") == "5");
+    REQUIRE(clone.Evaluate("(add-x 10)") == "15");
+    REQUIRE(parent.Evaluate("x") == "1");
+    REQUIRE(parent.Evaluate("(add-x 10)") == "11");
+    REQUIRE_THROWS_AS(parent.Evaluate("z"), NameError);
+
+    parent.Evaluate("(define x 100)");
+    REQUIRE(parent.Evaluate("(add-x 10)") == "110");
+    REQUIRE(clone.Evaluate("(add-x 10)") == "15");
+}
+
+TEST_CASE("CloneCopiesPairsOnWrite") {
+    Scheme parent;
+    parent.Evaluate("(define p (cons 1 2))");
+
+    Scheme clone = parent.Clone();
+    clone.Evaluate("(set-car! p 10)");
+    REQUIRE(clone.Evaluate("p") == "(10 . 2)");
+    REQUIRE(parent.Evaluate("p") == "(1 . 2)");
+
+    parent.Evaluate("(set-cdr! p 20)");
+    REQUIRE(parent.Evaluate("p") == "(1 . 20)");
+    REQUIRE(clone.Evaluate("p") == "(10 . 2)");
+}
+
+TEST_CASE("CloneOfClone") {
+    Scheme parent;
+    parent.Evaluate("(define a 1)");
+    Scheme first = parent.Clone();
+    first.Evaluate("(define b 2)");
+    Scheme second = first.Clone();
+    second.Evaluate("(set! a 10)");
+
+    REQUIRE(second.Evaluate("(+ a b)") == "12");
+    REQUIRE(first.Evaluate("(+ a b)") == "3");
+    REQUIRE(parent.Evaluate("a") == "1");
+    REQUIRE_THROWS_AS(parent.Evaluate("b"), NameError);
+
+    Scheme third = parent.Clone();
+    REQUIRE(third.Evaluate("a") == "1");
+}
+
+TEST_CASE("CloneDoesNotCopyEnvironment") {
+    Scheme parent;
+    for (int i = 0; i < 5000; ++i) {
+        parent.Evaluate("(define " + VariableName(i) + " " + std::to_string(i) + ")");
+    }
+    Scheme clone = parent.Clone();
+    // 5000 привязок остаются в общей замороженной области, а на счёте клона только его
+    // пустой верхний слой.
+    REQUIRE(clone.HeapUsed() * 100 < parent.HeapUsed());
+    REQUIRE(clone.Evaluate(VariableName(4999)) == "4999");
+    clone.Evaluate("(define " + VariableName(4999) + " 0)");
+    REQUIRE(parent.Evaluate(VariableName(4999)) == "4999");
+}
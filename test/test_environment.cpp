@@ -0,0 +1,213 @@
+#include <test/scheme_test.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "environment.h"
+
+TEST_CASE("SharedEnvironmentPublishes") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    uint64_t initial = environment->Version();
+    environment->Evaluate("(define limit 10)");
+    environment->Evaluate("(define check (lambda (x) (< x limit)))");
+    REQUIRE(environment->Version() == initial + 2);
+
+    Scheme first;
+    Scheme second;
+    first.Attach(environment);
+    second.Attach(environment);
+    REQUIRE(first.Evaluate("(check 5)") == "#t");
+    REQUIRE(second.Evaluate("(check 50)") == "#f");
+
+    environment->Evaluate("(set! limit 100)");
+    REQUIRE(first.Evaluate("(check 50)") == "#t");
+
+    environment->Evaluate("(define check (lambda (x) (> x limit)))");
+    REQUIRE(second.Evaluate("(check 50)") == "#f");
+    REQUIRE(second.Evaluate("(check 500)") == "#t");
+
+    first.Evaluate("(define limit 1)");
+    REQUIRE(first.Evaluate("limit") == "1");
+    REQUIRE(second.Evaluate("limit") == "100");
+    REQUIRE(environment->Evaluate("limit") == "100");
+}
+
+TEST_CASE("SharedEnvironmentReadIfNewer") {
+    SharedEnvironment environment;
+    uint64_t version = 0;
+    std::shared_ptr<const SharedEnvironment::Journal> journal;
+    REQUIRE(environment.ReadIfNewer(&version, &journal));
+    REQUIRE(version == environment.Version());
+    REQUIRE(journal->version == version);
+    REQUIRE_FALSE(journal->previous);
+    REQUIRE_FALSE(environment.ReadIfNewer(&version, &journal));
+
+    environment.Evaluate("(define x 1)");
+    environment.Evaluate("(define y (list 1 2))");
+    REQUIRE(environment.ReadIfNewer(&version, &journal));
+    REQUIRE(version == environment.Version());
+    REQUIRE(journal->previous->previous->version == version - 2);
+
+    auto previous = journal;
+    environment.Evaluate("(set! x 2)");
+    REQUIRE(environment.ReadIfNewer(&version, &journal));
+    REQUIRE(journal->previous == previous);
+    REQUIRE(journal->image.size() < previous->image.size());
+}
+
+TEST_CASE("SharedEnvironmentKeepsSharedObjects") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    environment->Evaluate("(define same (lambda (x) x))");
+    environment->Evaluate("(define a (cons 1 2))");
+    environment->Evaluate("(define b (same a))");
+
+    Scheme scheme;
+    scheme.Attach(environment);
+    REQUIRE(scheme.Evaluate("b") == "(1 . 2)");
+
+    environment->Evaluate("(set-car! b 5)");
+    REQUIRE(scheme.Evaluate("a") == "(5 . 2)");
+    REQUIRE(scheme.Evaluate("b") == "(5 . 2)");
+
+    // Образ несёт только новое значение пары, и его видят все привязки к ней.
+    environment->Evaluate("(define c (same b))");
+    environment->Evaluate("(set-cdr! a 6)");
+    REQUIRE(scheme.Evaluate("b") == "(5 . 6)");
+    REQUIRE(scheme.Evaluate("c") == "(5 . 6)");
+}
+
+TEST_CASE("SharedEnvironmentReaderWritesStayLocal") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    environment->Evaluate("(define p (cons 1 2))");
+    environment->Evaluate("(define limit 10)");
+
+    Scheme first;
+    Scheme second;
+    first.Attach(environment);
+    second.Attach(environment);
+    first.Evaluate("(set-car! p 7)");
+    first.Evaluate("(set! limit 1)");
+    REQUIRE(first.Evaluate("p") == "(7 . 2)");
+    REQUIRE(first.Evaluate("limit") == "1");
+    REQUIRE(second.Evaluate("p") == "(1 . 2)");
+    REQUIRE(second.Evaluate("limit") == "10");
+
+    environment->Evaluate("(set-cdr! p 3)");
+    environment->Evaluate("(set! limit 20)");
+    REQUIRE(first.Evaluate("p") == "(7 . 2)");
+    REQUIRE(first.Evaluate("limit") == "1");
+    REQUIRE(second.Evaluate("p") == "(1 . 3)");
+    REQUIRE(second.Evaluate("limit") == "20");
+    REQUIRE(environment->Evaluate("p") == "(1 . 3)");
+}
+
+TEST_CASE("SharedEnvironmentPublishesOnlyChanges") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    for (int i = 0; i < 1000; ++i) {
+        std::string name = "v";
+        for (int rest = i; rest; rest /= 26) {
+            name += static_cast<char>('a' + rest % 26);
+        }
+        environment->Evaluate("(define " + name + " (list " + std::to_string(i) + " 1 2 3))");
+    }
+    environment->Evaluate("(define p (cons 0 0))");
+    uint64_t version = 0;
+    std::shared_ptr<const SharedEnvironment::Journal> journal;
+    environment->Evaluate("(set! p (cons 1 0))");
+    REQUIRE(environment->ReadIfNewer(&version, &journal));
+    REQUIRE(journal->previous);
+    REQUIRE(journal->image.size() < 64);
+
+    Scheme scheme;
+    scheme.Attach(environment);
+    REQUIRE(scheme.Evaluate("p") == "(1 . 0)");
+    // Изменение до ошибки публикуется вместе с ошибкой.
+    REQUIRE_THROWS(environment->Evaluate("(+ (set-car! p 2) (car 1))"));
+    REQUIRE(scheme.Evaluate("p") == "(2 . 0)");
+}
+
+TEST_CASE("SharedEnvironmentRestartsJournal") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    environment->Evaluate("(define counter 0)");
+    environment->Evaluate("(define p (cons 0 0))");
+
+    Scheme early;
+    early.Attach(environment);
+    REQUIRE(early.Evaluate("counter") == "0");
+    bool restarted = false;
+    for (int i = 1; i <= 2500; ++i) {
+        environment->Evaluate("(set! counter " + std::to_string(i) + ")");
+        environment->Evaluate("(set-car! p " + std::to_string(i) + ")");
+        uint64_t version = 0;
+        std::shared_ptr<const SharedEnvironment::Journal> journal;
+        environment->ReadIfNewer(&version, &journal);
+        restarted |= !journal->previous;
+    }
+    REQUIRE(restarted);
+    REQUIRE(early.Evaluate("counter") == "2500");
+    REQUIRE(early.Evaluate("p") == "(2500 . 0)");
+
+    Scheme late;
+    late.Attach(environment);
+    REQUIRE(late.Evaluate("counter") == "2500");
+    REQUIRE(late.Evaluate("p") == "(2500 . 0)");
+}
+
+TEST_CASE("SharedEnvironmentRefreshesChangedBindings") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    environment->Evaluate("(define limit 10)");
+    environment->Evaluate("(define check (lambda (x) (< x limit)))");
+    std::string big = "(define big (list";
+    for (int i = 0; i < 1000; ++i) {
+        big += " " + std::to_string(i);
+    }
+    environment->Evaluate(big + "))");
+
+    Scheme scheme;
+    scheme.Attach(environment);
+    REQUIRE(scheme.Evaluate("(check 5)") == "#t");
+
+    environment->Evaluate("(set! limit 1)");
+    scheme.ResetStats();
+    REQUIRE(scheme.Evaluate("(check 5)") == "#f");
+    uint64_t allocations = 0;
+    for (const auto& [type, count] : scheme.Stats().allocations) {
+        allocations += count;
+    }
+    REQUIRE(allocations < 1000);
+
+    environment->Evaluate("(define extra 3)");
+    REQUIRE(scheme.Evaluate("(+ extra limit)") == "4");
+}
+
+TEST_CASE("SharedEnvironmentHotReload") {
+    auto environment = std::make_shared<SharedEnvironment>();
+    environment->Evaluate("(define rule (lambda (x) (+ x 0)))");
+
+    constexpr int kReaders = 8;
+    std::atomic<bool> stop = false;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < kReaders; ++t) {
+        readers.emplace_back([&] {
+            Scheme scheme;
+            scheme.Attach(environment);
+            int previous = 0;
+            while (!stop) {
+                int result = std::stoi(scheme.Evaluate("(rule 0)"));
+                // Версии публикуются по порядку, поэтому читатель не может откатиться.
+                failures += result < previous;
+                previous = result;
+            }
+        });
+    }
+    for (int i = 1; i <= 200; ++i) {
+        environment->Evaluate("(define rule (lambda (x) (+ x " + std::to_string(i) + ")))");
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    REQUIRE(failures == 0);
+}
@@ -0,0 +1,73 @@
+#include <test/scheme_test.h>
+#include <fasl.h>
+#include <parser.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+std::string Dump(const Ref<Object>& obj) {
+    if (!obj) {
+        return "nil";
+    }
+    if (Is<Cell>(obj)) {
+        auto cell = As<Cell>(obj);
+        return "[" + Dump(cell->GetFirst()) + " " + Dump(cell->GetSecond()) + "]";
+    }
+    return obj->Print();
+}
+
+std::string PrintForms(const std::vector<Ref<Object>>& forms) {
+    std::string result;
+    for (const auto& form : forms) {
+        result += Dump(form) + "\n";
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST_CASE("FaslRoundTrip") {
+    std::stringstream source{"(+ 1 (* -2 3)) 'sym #t (1 2 . 3) (define (f x) (+ x 1)) ()"};
+    Tokenizer tokenizer{&source};
+    auto forms = ReadAll(&tokenizer);
+
+    std::stringstream fasl;
+    WriteFasl(forms, &fasl);
+    auto loaded = ReadFasl(&fasl);
+
+    REQUIRE(loaded.size() == forms.size());
+    REQUIRE(PrintForms(loaded) == PrintForms(forms));
+}
+
+TEST_CASE("FaslBadInput") {
+    std::stringstream garbage{"not a fasl file"};
+    REQUIRE_THROWS_AS(ReadFasl(&garbage), RuntimeError);
+
+    std::stringstream fasl;
+    WriteFasl({MakeRef<Number>(1)}, &fasl);
+    std::stringstream truncated{fasl.str().substr(0, fasl.str().size() - 2)};
+    REQUIRE_THROWS_AS(ReadFasl(&truncated), RuntimeError);
+}
+
+TEST_CASE("LoadFasl") {
+    auto path = std::filesystem::temp_directory_path() / "scheme_test_load.fasl";
+    {
+        std::stringstream source{R"EOF(
+            (define slow-add (lambda (x y) (if (= x 0) y (slow-add (- x 1) (+ y 1)))))
+            (define base 10)
+            (slow-add base 5)
+        )EOF"};
+        std::ofstream out{path, std::ios::binary};
+        CompileFasl(&source, &out);
+    }
+
+    Scheme scheme;
+    REQUIRE(scheme.LoadFasl(path.string()) == "15");
+    REQUIRE(scheme.Evaluate("(slow-add base 1)") == "11");
+    std::filesystem::remove(path);
+
+    REQUIRE_THROWS_AS(scheme.LoadFasl(path.string()), RuntimeError);
+}
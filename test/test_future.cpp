@@ -0,0 +1,135 @@
+#include <test/scheme_test.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "future.h"
+
+TEST_CASE("TaskPoolRunsEveryTask") {
+    std::atomic<int> done = 0;
+    {
+        TaskPool pool{4};
+        REQUIRE(pool.Size() == 4);
+        for (int i = 0; i < 1000; ++i) {
+            pool.Submit([&done, &pool] {
+                pool.Submit([&done] { ++done; });
+                ++done;
+            });
+        }
+    }
+    REQUIRE(done == 2000);
+}
+
+TEST_CASE("TaskPoolOfOneRunsOnCaller") {
+    TaskPool pool{1};
+    int done = 0;
+    pool.Submit([&done] { ++done; });
+    REQUIRE(done == 0);
+    REQUIRE(pool.RunOne());
+    REQUIRE_FALSE(pool.RunOne());
+    REQUIRE(done == 1);
+}
+
+TEST_CASE_METHOD(SchemeTest, "FutureSequential") {
+    TaskPool::SetDefaultSize(1);
+    ExpectNoError("(define x 1)");
+    ExpectNoError("(define f (future (+ x 2)))");
+    ExpectEq("f", "#<future>");
+    ExpectEq("(touch f)", "3");
+    ExpectEq("(touch 5)", "5");
+    ExpectEq("(parallel-map (lambda (y) (* y y)) (list 1 2 3))", "(1 4 9)");
+    ExpectEq("(parallel-map (lambda (y) (= y 2)) (list 1 2))", "(#f #t)");
+    ExpectRuntimeError("(future)");
+
+    // Как и у большого пула: ошибка ждёт touch, а set! меняет только копию окружения.
+    ExpectNoError("(define g (future (begin-unknown)))");
+    ExpectNameError("(touch g)");
+    ExpectNoError("(define h (future (set! x 20)))");
+    ExpectEq("(touch h)", "#t");
+    ExpectEq("x", "1");
+    ExpectEq("(parallel-map (lambda (y) (set! x y)) (list 5))", "(#t)");
+    ExpectEq("x", "1");
+}
+
+TEST_CASE_METHOD(SchemeTest, "FutureOutlivesDefaultPool") {
+    TaskPool::SetDefaultSize(4);
+    ExpectNoError("(define count (lambda (n) (if (= n 0) 0 (count (- n 1)))))");
+    ExpectNoError("(define f (future (count 1000)))");
+    ExpectNoError("(define g (future (touch (future (count 10)))))");
+    TaskPool::SetDefaultSize(1);
+    ExpectEq("(touch f)", "0");
+    ExpectEq("(touch g)", "0");
+    auto pool = TaskPool::Default();
+    TaskPool::SetDefaultSize(2);
+    REQUIRE(pool->Size() == 1);
+}
+
+TEST_CASE_METHOD(SchemeTest, "FutureParallel") {
+    TaskPool::SetDefaultSize(4);
+    ExpectNoError("(define fib (lambda (b a n) (if (= n 0) a (fib (+ a b) (- b a) (- n 1)))))");
+    ExpectNoError("(define x 10)");
+    ExpectNoError("(define f (future (fib 1 0 x)))");
+    ExpectNoError("(define g (future (begin-unknown)))");
+    ExpectEq("(touch f)", "55");
+    ExpectEq("(touch f)", "55");
+    ExpectNameError("(touch g)");
+
+    ExpectNoError("(define h (future (set! x 20)))");
+    ExpectEq("(touch h)", "#t");
+    ExpectEq("x", "10");
+
+    ExpectNoError("(define nested (future (+ (touch (future (* x 2))) 1)))");
+    ExpectEq("(touch nested)", "21");
+    ExpectRuntimeError("(touch (future (abs 1 2)))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "ParallelMap") {
+    TaskPool::SetDefaultSize(4);
+    ExpectNoError("(define offset 100)");
+    ExpectNoError("(define shift (lambda (y) (+ y offset)))");
+    ExpectEq("(parallel-map shift (list 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20))",
+             "(101 102 103 104 105 106 107 108 109 110 111 112 113 114 115 116 117 118 119 120)");
+    ExpectEq("(parallel-map abs '(-1 2 -3))", "(1 2 3)");
+    ExpectEq("(parallel-map abs (list 7))", "(7)");
+    ExpectEq("(parallel-map (lambda (x) (> x 1)) '(1 2 3))", "(#f #t #t)");
+    ExpectEq("(parallel-map (lambda (x) (if (> x 1) 'big 'small)) (list 1 2))", "(small big)");
+    ExpectEq("(parallel-map (lambda (x) (list (+ x 0) (* x x))) (list 2 3))", "((2 4) (3 9))");
+    ExpectEq("(parallel-map (lambda (x) (cons (+ x 0) 0)) (list 1 2))", "((1 . 0) (2 . 0))");
+    ExpectRuntimeError("(parallel-map abs 1)");
+    ExpectRuntimeError("(parallel-map (lambda (y) (abs y 1)) (list 1 2 3))");
+}
+
+TEST_CASE("FutureInheritsLimits") {
+    TaskPool::SetDefaultSize(4);
+    Scheme scheme;
+    scheme.Evaluate("(define loop (lambda (n) (loop (+ n 1))))");
+    scheme.Evaluate("(define count (lambda (n) (if (= n 0) 0 (count (- n 1)))))");
+
+    scheme.SetFuel(1000);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(touch (future (loop 0)))"), FuelExhausted);
+    REQUIRE(scheme.Fuel() == 0);
+    scheme.SetFuel(100000);
+    REQUIRE(scheme.Evaluate("(touch (future (count 1000)))") == "0");
+    REQUIRE(scheme.Fuel() < 100000 - 1000);
+    scheme.SetFuel(2000);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(parallel-map count (list 500 500 500 500 500))"),
+                      FuelExhausted);
+    scheme.SetFuel(EvalBudget::kUnlimited);
+
+    scheme.SetTimeout(std::chrono::milliseconds{1});
+    REQUIRE_THROWS_AS(scheme.Evaluate("(touch (future (loop 0)))"), DeadlineExceeded);
+    scheme.SetTimeout(std::chrono::nanoseconds{0});
+
+    size_t baseline = scheme.HeapUsed();
+    scheme.SetHeapLimits(baseline + 20000, baseline + 100000);
+    std::string list = "(list";
+    for (int i = 0; i < 5000; ++i) {
+        list += " " + std::to_string(i);
+    }
+    REQUIRE_THROWS_AS(scheme.Evaluate("(touch (future " + list + "))"), HeapLimitExceeded);
+    REQUIRE(scheme.Evaluate("(touch (future (count 10)))") == "0");
+    REQUIRE(scheme.HeapUsed() < baseline + 1000);
+    TaskPool::SetDefaultSize(std::max(1u, std::thread::hardware_concurrency()));
+}
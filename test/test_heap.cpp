@@ -0,0 +1,122 @@
+#include <test/scheme_test.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "scheme.h"
+
+namespace {
+
+std::string ListOf(int size) {
+    std::string list = "(list";
+    for (int i = 0; i < size; ++i) {
+        list += " " + std::to_string(i);
+    }
+    return list + ")";
+}
+
+}  // namespace
+
+TEST_CASE("HeapAccounting") {
+    Scheme scheme;
+    size_t baseline = scheme.HeapUsed();
+    REQUIRE(baseline > 0);
+
+    scheme.Evaluate("(define big " + ListOf(1000) + ")");
+    size_t with_list = scheme.HeapUsed();
+    REQUIRE(with_list > baseline + 1000 * sizeof(Number));
+
+    scheme.Evaluate("(set! big 0)");
+    REQUIRE(scheme.HeapUsed() < baseline + 1000);
+
+    scheme.Evaluate("(define counter 0)");
+    REQUIRE(scheme.HeapUsed() > baseline);
+}
+
+TEST_CASE("HeapLimits") {
+    Scheme scheme;
+    size_t baseline = scheme.HeapUsed();
+    size_t reported = 0;
+    int calls = 0;
+    scheme.SetSoftHeapLimitHandler([&](size_t used) {
+        reported = used;
+        ++calls;
+    });
+    scheme.SetHeapLimits(baseline + 20000, baseline + 100000);
+
+    scheme.Evaluate("(define a " + ListOf(500) + ")");
+    REQUIRE(calls == 1);
+    REQUIRE(reported > baseline + 20000);
+    scheme.Evaluate("(define b " + ListOf(10) + ")");
+    REQUIRE(calls == 1);
+
+    REQUIRE_THROWS_AS(scheme.Evaluate("(define c " + ListOf(5000) + ")"), HeapLimitExceeded);
+    REQUIRE(scheme.HeapUsed() <= baseline + 100000);
+    REQUIRE_THROWS_AS(scheme.Evaluate("c"), NameError);
+    REQUIRE(scheme.Evaluate("(+ 1 2)") == "3");
+
+    scheme.Evaluate("(set! a 0)");
+    REQUIRE(scheme.HeapUsed() < baseline + 20000);
+    int before = calls;
+    scheme.Evaluate("(set! a " + ListOf(500) + ")");
+    REQUIRE(calls == before + 1);
+}
+
+TEST_CASE("HeapRefundsOwnerAccount") {
+    Scheme scheme;
+    scheme.Evaluate("(define add (lambda (x y) (+ x y)))");
+    auto prepared = scheme.Prepare("(add x 1)", {"x"});
+    size_t baseline = scheme.HeapUsed();
+    scheme.SetHeapLimits(baseline + 20000, baseline + 40000);
+    for (int64_t i = 0; i < 5000; ++i) {
+        REQUIRE(scheme.Call("add", i, 1).As<int64_t>() == i + 1);
+        REQUIRE(scheme.Run(prepared, i).As<int64_t>() == i + 1);
+    }
+    REQUIRE(scheme.HeapUsed() < baseline + 1000);
+    REQUIRE(scheme.Evaluate("(add 1 2)") == "3");
+
+    std::optional<Value> kept = scheme.Call("list", 1, 2, 3);
+    size_t with_value = scheme.HeapUsed();
+    Scheme other;
+    other.Register("drop", [&kept] {
+        kept.reset();
+        return true;
+    });
+    size_t other_used = other.HeapUsed();
+    REQUIRE(other.Evaluate("(drop)") == "#t");
+    REQUIRE(scheme.HeapUsed() < with_value);
+    REQUIRE(other.HeapUsed() >= other_used);
+}
+
+TEST_CASE("HeapChargesMarshalledArguments") {
+    Scheme scheme;
+    auto echo = scheme.Prepare("items", {"items"});
+    size_t baseline = scheme.HeapUsed();
+    scheme.SetHeapLimits(baseline + 20000, baseline + 100000);
+    REQUIRE_THROWS_AS(scheme.Run(echo, std::vector<int64_t>(10000, 1)), HeapLimitExceeded);
+    REQUIRE(scheme.Run(echo, std::vector<int64_t>{1, 2}).Print() == "(1 2)");
+    REQUIRE(scheme.HeapUsed() < baseline + 1000);
+
+    REQUIRE_THROWS_AS(scheme.Call("list", std::vector<int64_t>(10000, 1)), HeapLimitExceeded);
+    REQUIRE(scheme.Call("list", std::vector<int64_t>{1, 2}).Print() == "((1 2))");
+    REQUIRE(scheme.HeapUsed() < baseline + 1000);
+}
+
+TEST_CASE("HeapAccountOutlivesInterpreter") {
+    std::optional<Value> kept;
+    {
+        Scheme scheme;
+        kept = scheme.Call("list", 1, 2, 3);
+    }
+    REQUIRE(kept->Print() == "(1 2 3)");
+    kept.reset();
+
+    auto scheme = std::make_unique<Scheme>();
+    scheme->Evaluate("(define numbers (list 1 2 3))");
+    Scheme clone = scheme->Clone();
+    scheme.reset();
+    REQUIRE(clone.Evaluate("numbers") == "(1 2 3)");
+}
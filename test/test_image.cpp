@@ -0,0 +1,73 @@
+#include <test/scheme_test.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "image.h"
+
+TEST_CASE("ImageRestoresGlobals") {
+    auto path = std::filesystem::temp_directory_path() / "scheme_test_image.img";
+    {
+        Scheme scheme;
+        scheme.Evaluate("(define x 1)");
+        scheme.Evaluate("(define p (cons 1 2))");
+        scheme.Evaluate("(define l (list 1 2 3))");
+        scheme.Evaluate("(define flag #f)");
+        scheme.Evaluate("(define (inc y) (+ y 1))");
+        scheme.Evaluate(
+            "(define slow-add (lambda (x y) (if (= x 0) y (slow-add (- x 1) (+ y 1)))))");
+        scheme.Evaluate("(define range (lambda (x) (lambda () (set! x (+ x 1)) x)))");
+        scheme.Evaluate("(define my-range (range 10))");
+        scheme.Evaluate("(my-range)");
+        scheme.SaveImage(path.string());
+    }
+
+    auto scheme = Scheme::FromImage(path.string());
+    std::filesystem::remove(path);
+
+    REQUIRE(scheme.Evaluate("x") == "1");
+    REQUIRE(scheme.Evaluate("p") == "(1 . 2)");
+    REQUIRE(scheme.Evaluate("l") == "(1 2 3)");
+    REQUIRE(scheme.Evaluate("flag") == "#f");
+    REQUIRE(scheme.Evaluate("(inc 41)") == "42");
+    REQUIRE(scheme.Evaluate("(slow-add 3 3)") == "6");
+    REQUIRE(scheme.Evaluate("(my-range)") == "12");
+    REQUIRE(scheme.Evaluate("(+ 1 2)") == "3");
+}
+
+TEST_CASE("ImageBadInput") {
+    auto path = std::filesystem::temp_directory_path() / "scheme_test_missing.img";
+    std::filesystem::remove(path);
+    REQUIRE_THROWS_AS(Scheme::FromImage(path.string()), RuntimeError);
+}
+
+TEST_CASE("PackBindingsTakesFreeVariables") {
+    auto global = MakeRef<Scope>();
+    AddBuiltins(global);
+    std::vector<Ref<Object>> elements;
+    for (int64_t i = 0; i < 1000; ++i) {
+        elements.push_back(MakeRef<Number>(i));
+    }
+    global->SetElementScope("big", MakeRef<ListObj>(elements));
+    global->SetElementScope("x", MakeRef<Number>(41));
+    auto local = MakeRef<Scope>();
+    local->SetParentScope(global);
+    local->SetElementScope("y", MakeRef<Number>(1));
+    local->SetElementScope("unused", MakeRef<ListObj>(elements));
+
+    auto sum = MakeRef<Cell>(
+        MakeRef<Symbol>("+"),
+        MakeRef<Cell>(MakeRef<Symbol>("x"), MakeRef<Cell>(MakeRef<Symbol>("y"), nullptr)));
+    auto image = PackBindings({{"sum", sum}}, local);
+    REQUIRE(image.size() < 200);
+    auto root = UnpackBindings(image);
+    REQUIRE(root->GetElementScope("sum")->Eval(root)->Print() == "42");
+    REQUIRE_THROWS_AS(root->GetElementScope("big"), NameError);
+    REQUIRE_THROWS_AS(root->GetElementScope("unused"), NameError);
+
+    auto whole = PackBindings({{"list", MakeRef<Symbol>("big")}}, local);
+    REQUIRE(whole.size() > 1000);
+    root = UnpackBindings(whole);
+    REQUIRE(root->GetElementScope("list")->Eval(root)->Print().size() > 1000);
+}
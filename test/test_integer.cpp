@@ -110,3 +110,20 @@ TEST_CASE_METHOD(SchemeTest, "IntegerAbsEdgeCases") {
     ExpectRuntimeError("(abs #t)");
     ExpectRuntimeError("(abs 1 2)");
 }
+
+TEST_CASE_METHOD(SchemeTest, "IntegerArithmeticsWide") {
+    ExpectEq("(* 100000 100000)", "10000000000");
+    ExpectEq("(+ (* 100000 100000) (- 1 (* 2 3)))", "9999999995");
+    ExpectEq("(define x 4000000000)", "#t");
+    ExpectEq("(- x 1 1)", "3999999998");
+    ExpectEq("(< x (* x 2) (* x 3))", "#t");
+    ExpectEq("(cons 4000000000 -5000000000)", "(4000000000 . -5000000000)");
+    ExpectRuntimeError("(/ 1 0)");
+    ExpectRuntimeError("(/ 10 (- 2 2))");
+}
+
+TEST_CASE_METHOD(SchemeTest, "IntegerComparisonStopsAtFalse") {
+    ExpectEq("(< 2 1 (/ 1 0))", "#f");
+    ExpectEq("(= 1 1 2 (/ 1 0))", "#f");
+    ExpectRuntimeError("(< 1 2 (/ 1 0))");
+}
@@ -0,0 +1,100 @@
+#include <test/scheme_test.h>
+
+#include <thread>
+#include <vector>
+
+#include "latency.h"
+
+TEST_CASE("LatencyHistogramBuckets") {
+    for (uint64_t value : {0ULL, 1ULL, 15ULL, 16ULL, 17ULL, 1000ULL, 123456789ULL}) {
+        size_t index = LatencyHistogram::BucketIndex(value);
+        REQUIRE(LatencyHistogram::BucketUpperBound(index) >= value);
+        REQUIRE(LatencyHistogram::BucketUpperBound(index) - value <= value / 16);
+        if (index > 0) {
+            REQUIRE(LatencyHistogram::BucketUpperBound(index - 1) < value);
+        }
+    }
+}
+
+TEST_CASE("LatencyHistogramPercentiles") {
+    LatencyHistogram histogram;
+    REQUIRE(histogram.Percentile(0.5).count() == 0);
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.Record(std::chrono::nanoseconds{i * 100});
+    }
+    REQUIRE(histogram.Count() == 1000);
+    REQUIRE(histogram.Max().count() == 100000);
+    auto p50 = histogram.Percentile(0.5).count();
+    auto p99 = histogram.Percentile(0.99).count();
+    REQUIRE(p50 >= 50000);
+    REQUIRE(p50 <= 50000 + 50000 / 16);
+    REQUIRE(p99 >= 99000);
+    REQUIRE(p99 <= 100000);
+    REQUIRE(histogram.Percentile(1).count() == 100000);
+
+    histogram.Reset();
+    REQUIRE(histogram.Count() == 0);
+    REQUIRE(histogram.Max().count() == 0);
+}
+
+TEST_CASE("LatencyHistogramConcurrentRecord") {
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&histogram, t] {
+            for (int i = 0; i < 10000; ++i) {
+                histogram.Record(std::chrono::nanoseconds{t * 10000 + i});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(histogram.Count() == 40000);
+    REQUIRE(histogram.Max().count() == 39999);
+    REQUIRE(histogram.Summarize().count == 40000);
+    REQUIRE(histogram.Summarize().max.count() == 39999);
+}
+
+TEST_CASE("LatencyHistogramsAreIndependent") {
+    for (int i = 1; i <= 20; ++i) {
+        LatencyHistogram first;
+        LatencyHistogram second;
+        first.Record(std::chrono::nanoseconds{i});
+        REQUIRE(first.Count() == 1);
+        REQUIRE(second.Count() == 0);
+        REQUIRE(first.Max().count() == i);
+    }
+}
+
+TEST_CASE("LatencyHistogramReusesShardsOfFinishedThreads") {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 100; ++i) {
+        std::thread{[&histogram, i] { histogram.Record(std::chrono::nanoseconds{i}); }}.join();
+    }
+    REQUIRE(histogram.Count() == 100);
+    REQUIRE(histogram.Max().count() == 99);
+    REQUIRE(histogram.ShardCount() == 1);
+}
+
+TEST_CASE_METHOD(SchemeTest, "EvaluateLatencies") {
+    auto& latencies = Scheme::Latencies();
+    latencies.Reset();
+    ExpectEq("(+ 1 2)", "3");
+    ExpectEq("(list 1 2 3)", "(1 2 3)");
+    REQUIRE(latencies.read.Count() == 2);
+    REQUIRE(latencies.optimize.Count() == 2);
+    REQUIRE(latencies.eval.Count() == 2);
+    REQUIRE(latencies.print.Count() == 2);
+    REQUIRE(latencies.eval.Percentile(0.5) <= latencies.eval.Max());
+
+    // Вычисление, прерванное ошибкой, записывает фазу, в которой остановилось.
+    ExpectRuntimeError("(1)");
+    REQUIRE(latencies.read.Count() == 3);
+    REQUIRE(latencies.eval.Count() == 3);
+    REQUIRE(latencies.print.Count() == 2);
+
+    auto report = latencies.Report();
+    REQUIRE(report.find("phase") == 0);
+    REQUIRE(report.find("optimize") != std::string::npos);
+}
@@ -0,0 +1,84 @@
+#include <test/scheme_test.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "scheme.h"
+
+namespace {
+
+const std::string kTak = R"EOF(
+    (define tak (lambda (x y z)
+      ((lambda (x y z)
+         (if (not (< y x))
+             z
+             ((lambda (a b c) (tak a b c))
+              (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y))))
+       x y z))))EOF";
+
+}  // namespace
+
+TEST_CASE("FuelExhaustion") {
+    Scheme scheme;
+    scheme.Evaluate("(define loop (lambda (n) (loop (+ n 1))))");
+    scheme.Evaluate("(define add (lambda (x y) (+ x y)))");
+    REQUIRE(scheme.Fuel() == EvalBudget::kUnlimited);
+
+    scheme.SetFuel(1000);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(loop 0)"), FuelExhausted);
+    REQUIRE(scheme.Fuel() == 0);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(list 1 2)"), FuelExhausted);
+
+    scheme.SetFuel(100);
+    REQUIRE(scheme.Evaluate("(add 1 1)") == "2");
+    int64_t left = scheme.Fuel();
+    REQUIRE(left < 100);
+    REQUIRE(left > 90);
+    REQUIRE(scheme.Evaluate("(list 1)") == "(1)");
+    REQUIRE(scheme.Fuel() < left);
+
+    scheme.SetFuel(EvalBudget::kUnlimited);
+    REQUIRE(scheme.Evaluate("(+ 1 2)") == "3");
+}
+
+TEST_CASE("DeadlineExceeded") {
+    Scheme scheme;
+    scheme.Evaluate(kTak);
+    scheme.SetTimeout(std::chrono::milliseconds{1});
+    REQUIRE_THROWS_AS(scheme.Evaluate("(tak 24 16 8)"), DeadlineExceeded);
+    REQUIRE(scheme.Evaluate("(tak 3 2 1)") == "2");
+    REQUIRE(scheme.Fuel() == EvalBudget::kUnlimited);
+
+    scheme.SetTimeout(std::chrono::nanoseconds{0});
+    scheme.SetFuel(50);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(tak 24 16 8)"), LimitError);
+}
+
+TEST_CASE("ReentrantEvaluateSharesBudget") {
+    Scheme scheme;
+    scheme.Evaluate("(define count (lambda (n) (if (= n 0) 0 (count (- n 1)))))");
+    scheme.Register("inner", [&scheme](int64_t n) {
+        return scheme.Evaluate("(count " + std::to_string(n) + ")") == "0";
+    });
+
+    scheme.SetFuel(10000);
+    REQUIRE(scheme.Evaluate("(inner 1000)") == "#t");
+    REQUIRE(scheme.Fuel() < 10000 - 1000);
+    int64_t left = scheme.Fuel();
+    REQUIRE(scheme.Evaluate("(if (inner 1000) (count 10) 1)") == "0");
+    REQUIRE(scheme.Fuel() < left - 1000);
+    scheme.SetFuel(500);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(count (if (inner 400) 400 0))"), FuelExhausted);
+    REQUIRE(scheme.Fuel() == 0);
+    scheme.SetFuel(EvalBudget::kUnlimited);
+
+    scheme.Register("late", [&scheme] {
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        return scheme.Evaluate("(count 5000)") == "0";
+    });
+    scheme.SetTimeout(std::chrono::milliseconds{10});
+    REQUIRE_THROWS_AS(scheme.Evaluate("(late)"), DeadlineExceeded);
+    scheme.SetTimeout(std::chrono::nanoseconds{0});
+    REQUIRE(scheme.Evaluate("(late)") == "#t");
+}
@@ -79,3 +79,10 @@ TEST_CASE_METHOD(SchemeTest, "ListOperations") {
     ExpectRuntimeError("(list-ref '(1 2 3) 10)");
     ExpectRuntimeError("(list-tail '(1 2 3) 10)");
 }
+
+TEST_CASE_METHOD(SchemeTest, "ListManyArguments") {
+    ExpectEq("(list 1 2 3 4 5 6 7 8)", "(1 2 3 4 5 6 7 8)");
+    ExpectEq("(list 1 2 3 4 5 6 7 8 9 10 11)", "(1 2 3 4 5 6 7 8 9 10 11)");
+    ExpectEq("(list-ref '(1 2 3 4 5 6 7 8 9 10) 9)", "10");
+    ExpectEq("(list-tail '(1 2 3 4 5 6 7 8 9 10) 7)", "(8 9 10)");
+}
@@ -0,0 +1,86 @@
+#include <test/scheme_test.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scheme.h"
+
+TEST_CASE("CallSchemeProcedure") {
+    Scheme scheme;
+    scheme.Evaluate("(define add (lambda (x y) (+ x y)))");
+    scheme.Evaluate("(define (less? x y) (< x y))");
+    scheme.Evaluate("(define (first-of p) (car p))");
+
+    REQUIRE(scheme.Call("add", 1, 2).As<int64_t>() == 3);
+    REQUIRE(scheme.Call("add", int32_t{-5}, uint8_t{7}).As<int>() == 2);
+    REQUIRE(scheme.Call("less?", 1, 2).As<bool>());
+    REQUIRE(scheme.Call("first-of", std::pair<int64_t, int64_t>{4, 5}).As<int64_t>() == 4);
+    REQUIRE(scheme.Call("car", std::pair<int64_t, int64_t>{5000000000, 1}).As<int64_t>() ==
+            5000000000);
+    auto wide = std::pair<int64_t, int64_t>{-6000000000, 7000000000};
+    REQUIRE(scheme.Call("cons", wide.first, wide.second).As<std::pair<int64_t, int64_t>>() ==
+            wide);
+
+    auto list = scheme.Call("list", 3, 4).As<std::vector<int64_t>>();
+    REQUIRE(list == std::vector<int64_t>{3, 4});
+    REQUIRE(scheme.Call("list", 1, 2, 3).Print() == "(1 2 3)");
+    REQUIRE(scheme.Call("list", std::string{"x"}).As<std::vector<std::string>>() ==
+            std::vector<std::string>{"x"});
+
+    scheme.Evaluate("(define (same x) x)");
+    auto flags = scheme.Call("same", std::vector<bool>{true, false});
+    REQUIRE(flags.Print() == "(#t #f)");
+    REQUIRE(flags.As<std::vector<bool>>() == std::vector<bool>{true, false});
+    REQUIRE(scheme.Call("same", std::vector<std::string>{"a", "b"}).Print() == "(a b)");
+    auto nested = std::vector<Value>{scheme.Call("same", std::vector<int64_t>{1, 2}),
+                                     scheme.Call("cons", 3, 4), Value{MakeRef<Boolean>(false)}};
+    REQUIRE(scheme.Call("same", nested).Print() == "((1 2) (3 . 4) #f)");
+    REQUIRE(scheme.Call("same", std::vector<int64_t>{}).Print() == "()");
+
+    REQUIRE_THROWS_AS(scheme.Call("add", 1, 2).As<bool>(), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.Call("add", 5000000000, 0).As<int>(), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.Call("add", -1, 0).As<uint32_t>(), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.Call("add", uint64_t{1} << 63, 0), RuntimeError);
+    REQUIRE(scheme.Call("add", 127, 0).As<int8_t>() == 127);
+    REQUIRE_THROWS_AS(scheme.Call("add", 127, 1).As<int8_t>(), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.Call("missing", 1), NameError);
+}
+
+TEST_CASE("RegisterNativeFunction") {
+    Scheme scheme;
+    scheme.Register("native-add", [](int64_t a, int64_t b) { return a + b; });
+    scheme.Register("sum", [](const std::vector<int64_t>& values) {
+        int64_t sum = 0;
+        for (auto value : values) {
+            sum += value;
+        }
+        return sum;
+    });
+    int64_t seen = 0;
+    scheme.Register("remember!", [&seen](int64_t value) { seen = value; });
+    scheme.Register("swap", [](std::pair<int64_t, int64_t> pair) {
+        return std::pair<int64_t, int64_t>{pair.second, pair.first};
+    });
+
+    REQUIRE(scheme.Evaluate("(native-add 2 (* 3 4))") == "14");
+    REQUIRE(scheme.Evaluate("(sum (list 1 2 3))") == "6");
+    REQUIRE(scheme.Evaluate("(sum '(4 5))") == "9");
+    REQUIRE(scheme.Evaluate("(remember! 42)") == "#t");
+    REQUIRE(seen == 42);
+    REQUIRE(scheme.Evaluate("(swap (cons 1 2))") == "(2 . 1)");
+    REQUIRE(scheme.Evaluate("native-add") == "#<native native-add>");
+
+    scheme.Evaluate("(define twice (lambda (x) (native-add x x)))");
+    REQUIRE(scheme.Call("twice", 21).As<int64_t>() == 42);
+    scheme.Evaluate("(define total (lambda (lst) (sum lst)))");
+    REQUIRE(scheme.Call("total", std::vector<int64_t>{1, 2, 3, 4}).As<int64_t>() == 10);
+
+    REQUIRE_THROWS_AS(scheme.Evaluate("(native-add 1)"), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(native-add 1 #t)"), RuntimeError);
+
+    scheme.Register("narrow", [](int32_t value) { return value; });
+    REQUIRE(scheme.Evaluate("(narrow -7)") == "-7");
+    REQUIRE_THROWS_AS(scheme.Evaluate("(narrow 5000000000)"), RuntimeError);
+}
@@ -0,0 +1,67 @@
+#include <test/scheme_test.h>
+
+TEST_CASE_METHOD(SchemeTest, "FoldedArithmetic") {
+    ExpectEq("(* 60 60 24)", "86400");
+    ExpectEq("(+ 1 (* 2 3) (- 10 4))", "13");
+    ExpectEq("(< 1 (+ 1 1) 3)", "#t");
+    ExpectEq("(not (= 1 2))", "#t");
+    ExpectEq("'(+ 1 2)", "(+ 1 2)");
+
+    ExpectNoError("(define seconds-per-day (lambda () (* 60 60 24)))");
+    ExpectEq("(seconds-per-day)", "86400");
+    ExpectEq("(seconds-per-day)", "86400");
+
+    ExpectRuntimeError("(abs 1 2)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "FoldedIf") {
+    ExpectEq("(if #t 1 (car 5))", "1");
+    ExpectEq("(if #f (car 5) (+ 1 2))", "3");
+    ExpectEq("(if (< 1 2) 10 20)", "10");
+    ExpectSyntaxError("(if #t)");
+}
+
+TEST_CASE_METHOD(SchemeTest, "FoldedConstantsFollowSet") {
+    ExpectNoError("(define k 10)");
+    ExpectNoError("(define get-k (lambda () (+ k 1)))");
+    ExpectEq("(get-k)", "11");
+
+    ExpectNoError("(set! k 20)");
+    ExpectEq("(get-k)", "21");
+    ExpectEq("(+ k 1)", "21");
+
+    ExpectNoError("(define k 30)");
+    ExpectEq("(get-k)", "31");
+}
+
+TEST_CASE_METHOD(SchemeTest, "FoldedBuiltinsFollowRedefinition") {
+    ExpectNoError("(define add (lambda () (+ 1 2)))");
+    ExpectEq("(add)", "3");
+    ExpectRuntimeError("((lambda (+) (+ 1 2)) 5)");
+
+    ExpectNoError("(define + 5)");
+    ExpectRuntimeError("(+ 1 2)");
+}
+
+TEST_CASE("OptimizerProducesFoldedCells") {
+    auto scope = MakeRef<Scope>();
+    AddBuiltins(scope);
+    Optimizer optimizer{scope};
+    auto parse = [](const std::string& expression) {
+        std::stringstream ss{expression};
+        Tokenizer tokenizer{&ss};
+        return Read(&tokenizer);
+    };
+
+    auto folded = As<FoldedCell>(optimizer.Optimize(parse("(* 60 60 24)")));
+    REQUIRE(folded);
+    REQUIRE(folded->GetReplacement()->Print() == "86400");
+
+    REQUIRE_FALSE(Is<FoldedCell>(optimizer.Optimize(parse("(/ 1 0)"))));
+    REQUIRE_FALSE(Is<FoldedCell>(optimizer.Optimize(parse("(+ x 1)"))));
+
+    auto lambda = As<Cell>(optimizer.Optimize(parse("(lambda (x) (+ x (* 2 3)))")));
+    auto body = As<Cell>(As<Cell>(As<Cell>(lambda->GetSecond())->GetSecond())->GetFirst());
+    REQUIRE_FALSE(Is<FoldedCell>(body));
+    REQUIRE(Is<FoldedCell>(As<Cell>(As<Cell>(body->GetSecond())->GetSecond())->GetFirst()));
+}
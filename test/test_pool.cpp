@@ -0,0 +1,101 @@
+#include <test/scheme_test.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pool.h"
+
+TEST_CASE("PoolInstancesAreIsolated") {
+    Scheme prototype;
+    prototype.Evaluate("(define base 10)");
+    prototype.Evaluate("(define add-base (lambda (x) (+ x base)))");
+    SchemePool pool{&prototype};
+    prototype.Evaluate("(define later 1)");
+
+    Scheme& local = pool.Local();
+    REQUIRE(&local == &pool.Local());
+    REQUIRE(pool.Instances() == 1);
+    REQUIRE(local.Evaluate("(add-base 5)") == "15");
+    REQUIRE_THROWS_AS(local.Evaluate("later"), NameError);
+
+    local.Evaluate("(set! base 20)");
+    REQUIRE(prototype.Evaluate("(add-base 5)") == "15");
+
+    std::string other_result;
+    std::thread{[&] { other_result = pool.Local().Evaluate("(add-base 5)"); }}.join();
+    REQUIRE(other_result == "15");
+    REQUIRE(pool.Instances() == 2);
+}
+
+TEST_CASE("PoolStress") {
+    Scheme prototype;
+    prototype.Evaluate(
+        "(define fib (lambda (b a n) (if (= n 0) a (fib (+ a b) (- b a) (- n 1)))))");
+    SchemePool pool{&prototype};
+
+    constexpr int kThreads = 8;
+    constexpr int kIterations = 200;
+    std::vector<std::thread> threads;
+    std::vector<int> failures(kThreads);
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&pool, &failures, t] {
+            Scheme& scheme = pool.Local();
+            scheme.Evaluate("(define id " + std::to_string(t) + ")");
+            scheme.Evaluate("(define counter 0)");
+            for (int i = 0; i < kIterations; ++i) {
+                scheme.Evaluate("(set! counter (+ counter 1))");
+                failures[t] += scheme.Evaluate("(fib 1 0 30)") != "832040";
+                failures[t] += scheme.Evaluate("(+ (* id 1000) counter)") !=
+                               std::to_string(t * 1000 + i + 1);
+                failures[t] += scheme.Evaluate("((lambda (x) (* x id)) 3)") !=
+                               std::to_string(3 * t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < kThreads; ++t) {
+        REQUIRE(failures[t] == 0);
+    }
+    REQUIRE(pool.Instances() == kThreads);
+}
+
+TEST_CASE("PoolReleasesInstancesOfLiveThreads") {
+    constexpr int kRounds = 5;
+    std::unique_ptr<SchemePool> pool;
+    std::mutex mutex;
+    std::condition_variable changed;
+    int started = 0;
+    int finished = 0;
+    std::vector<std::string> results(kRounds);
+    std::thread worker{[&] {
+        for (int round = 1; round <= kRounds; ++round) {
+            std::unique_lock lock{mutex};
+            changed.wait(lock, [&] { return started == round; });
+            Scheme& scheme = pool->Local();
+            scheme.Evaluate("(define x 1)");
+            results[round - 1] = scheme.Evaluate("x");
+            finished = round;
+            changed.notify_all();
+        }
+    }};
+    for (int round = 1; round <= kRounds; ++round) {
+        std::unique_lock lock{mutex};
+        pool = std::make_unique<SchemePool>();
+        started = round;
+        changed.notify_all();
+        changed.wait(lock, [&] { return finished == round; });
+        REQUIRE(pool->Instances() == 1);
+        REQUIRE_THROWS_AS(pool->Local().Evaluate("x"), NameError);
+        pool.reset();
+    }
+    worker.join();
+    for (const auto& result : results) {
+        REQUIRE(result == "1");
+    }
+}
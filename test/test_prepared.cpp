@@ -0,0 +1,67 @@
+#include <test/scheme_test.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "scheme.h"
+
+TEST_CASE("PreparedExpressionRuns") {
+    Scheme scheme;
+    auto prepared = scheme.Prepare("(+ x (* y 2))", {"x", "y"});
+    REQUIRE(prepared.Parameters() == std::vector<std::string>{"x", "y"});
+    REQUIRE(scheme.Run(prepared, 1, 2).As<int64_t>() == 5);
+    REQUIRE(scheme.Run(prepared, 10, 0).As<int64_t>() == 10);
+
+    auto constant = scheme.Prepare("(* 6 7)");
+    REQUIRE(scheme.Run(constant).As<int64_t>() == 42);
+
+    REQUIRE_THROWS_AS(scheme.Run(prepared, 1), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.Prepare("(+ x x)", {"x", "x"}), SyntaxError);
+    REQUIRE_THROWS_AS(scheme.Prepare(""), RuntimeError);
+}
+
+TEST_CASE("PreparedExpressionBindings") {
+    Scheme scheme;
+    scheme.Evaluate("(define x 100)");
+    scheme.Evaluate("(define base 1)");
+    scheme.Evaluate("(define add (lambda (a b) (+ a b)))");
+
+    auto shadowed = scheme.Prepare("(+ x 1)", {"x"});
+    REQUIRE(scheme.Run(shadowed, 1).As<int64_t>() == 2);
+    REQUIRE(scheme.Evaluate("x") == "100");
+
+    auto global = scheme.Prepare("(add v base)", {"v"});
+    REQUIRE(scheme.Run(global, 5).As<int64_t>() == 6);
+    scheme.Evaluate("(set! base 10)");
+    REQUIRE(scheme.Run(global, 5).As<int64_t>() == 15);
+
+    auto test = scheme.Prepare("(if flag a b)", {"flag", "a", "b"});
+    REQUIRE(scheme.Run(test, true, 1, 2).Print() == "1");
+    REQUIRE(scheme.Run(test, false, 1, 2).Print() == "2");
+}
+
+TEST_CASE("PreparedExpressionRejectsDefine") {
+    Scheme scheme;
+    REQUIRE_THROWS_AS(scheme.Prepare("(define z a)", {"a"}), SyntaxError);
+    REQUIRE_THROWS_AS(scheme.Prepare("(if a (define z 1) 0)", {"a"}), SyntaxError);
+    REQUIRE_THROWS_AS(scheme.Evaluate("z"), NameError);
+
+    // Внутри лямбды define пишет в её собственную область, как и в Evaluate.
+    auto local = scheme.Prepare("((lambda (x) (define y 2) (+ x y)) a)", {"a"});
+    REQUIRE(scheme.Run(local, 1).As<int64_t>() == 3);
+    auto quoted = scheme.Prepare("(quote (define z 1))");
+    REQUIRE(scheme.Run(quoted).Print() == "(define z 1)");
+}
+
+TEST_CASE("PreparedExpressionSkipsReader") {
+    Scheme scheme;
+    auto prepared = scheme.Prepare("(max a b 3)", {"a", "b"});
+    scheme.ResetStats();
+    for (int64_t i = 0; i < 100; ++i) {
+        REQUIRE(scheme.Run(prepared, i, 1).As<int64_t>() == std::max<int64_t>(i, 3));
+    }
+    auto stats = scheme.Stats();
+    REQUIRE(stats.tokens == 0);
+    REQUIRE(stats.parsed_nodes == 0);
+}
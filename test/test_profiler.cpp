@@ -0,0 +1,49 @@
+#include <test/scheme_test.h>
+
+TEST_CASE("ProfilerCountsCalls") {
+    Scheme scheme;
+    scheme.EnableProfiler();
+    scheme.Evaluate("(define x 0)");
+    scheme.Evaluate("(set! x 3)");
+    scheme.Evaluate("(define (inc y) (+ y 1))");
+    scheme.Evaluate("(define count (lambda (n acc) (if (= n 0) acc (count (- n 1) (+ acc 1)))))");
+    REQUIRE(scheme.Evaluate("(count 5 0)") == "5");
+    REQUIRE(scheme.Evaluate("(inc x)") == "4");
+
+    std::string report = scheme.ProfileReport();
+    INFO(report);
+    REQUIRE(report.find("procedure") == 0);
+    REQUIRE(report.find("count") != std::string::npos);
+    REQUIRE(report.find("inc") != std::string::npos);
+
+    std::stringstream ss{report};
+    std::string line;
+    bool found = false;
+    while (std::getline(ss, line)) {
+        std::stringstream row{line};
+        std::string name;
+        uint64_t calls = 0;
+        row >> name >> calls;
+        if (name == "count") {
+            REQUIRE(calls == 6);
+            found = true;
+        }
+    }
+    REQUIRE(found);
+}
+
+TEST_CASE("ProfileReportBuiltin") {
+    Scheme scheme;
+    REQUIRE_THROWS_AS(scheme.Evaluate("(profile-report)"), RuntimeError);
+    REQUIRE_THROWS_AS(scheme.ProfileReport(), RuntimeError);
+
+    scheme.EnableProfiler();
+    scheme.Evaluate("(define x 1)");
+    scheme.Evaluate("(set! x (+ x 1))");
+    auto report = scheme.Evaluate("(profile-report)");
+    REQUIRE(report.find("set!") != std::string::npos);
+    REQUIRE(report.find("+") != std::string::npos);
+
+    scheme.DisableProfiler();
+    REQUIRE_THROWS_AS(scheme.Evaluate("(profile-report)"), RuntimeError);
+}
@@ -0,0 +1,18 @@
+#include <test/scheme_test.h>
+
+TEST_CASE("RefCountsOwners") {
+    auto number = MakeRef<Number>(5);
+    REQUIRE(number->RefCount() == 1);
+    {
+        Ref<Object> object = number;
+        REQUIRE(number->RefCount() == 2);
+        REQUIRE(As<Number>(object) == number);
+        REQUIRE(!As<Symbol>(object));
+    }
+    REQUIRE(number->RefCount() == 1);
+
+    Ref<Object> moved = std::move(number);
+    REQUIRE(!number);
+    REQUIRE(moved->RefCount() == 1);
+    REQUIRE(sizeof(Ref<Object>) == sizeof(Object*));
+}
@@ -0,0 +1,72 @@
+#include <test/scheme_test.h>
+#include <sampler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE("SamplerRecordsSchemeStacks") {
+    Scheme scheme;
+    scheme.Evaluate("(define spin (lambda (n) (if (= n 0) 0 (spin (- n 1)))))");
+    scheme.Evaluate("(define outer (lambda (n) (spin n)))");
+
+    SamplingProfiler profiler{std::chrono::microseconds{500}};
+    profiler.Start();
+    REQUIRE(SamplingProfiler::Running());
+    auto start = std::chrono::steady_clock::now();
+    uint64_t partial = 0;
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds{300}) {
+        scheme.Evaluate("(outer 200)");
+        // Пока идёт семплирование, счётчики читаются под блокировкой фонового потока.
+        std::stringstream running;
+        profiler.WriteCollapsed(&running);
+        partial = std::max(partial, profiler.Samples());
+    }
+    profiler.Stop();
+    REQUIRE(profiler.Samples() >= partial);
+    REQUIRE(!SamplingProfiler::Running());
+
+    std::stringstream out;
+    profiler.WriteCollapsed(&out);
+    INFO(out.str());
+    REQUIRE(profiler.Samples() > 0);
+    REQUIRE(out.str().find("outer;spin;spin") != std::string::npos);
+}
+
+TEST_CASE("SamplerSingleInstance") {
+    SamplingProfiler first;
+    SamplingProfiler second;
+    first.Start();
+    REQUIRE_THROWS_AS(second.Start(), RuntimeError);
+    first.Stop();
+}
+
+TEST_CASE("SamplerStopsWhileThreadsAreSampled") {
+    std::atomic<bool> done = false;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 4; ++i) {
+        workers.emplace_back([&done] {
+            Scheme scheme;
+            scheme.Evaluate("(define spin (lambda (n) (if (= n 0) 0 (spin (- n 1)))))");
+            while (!done.load()) {
+                scheme.Evaluate("(spin 50)");
+            }
+        });
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < 20; ++i) {
+        auto profiler = std::make_unique<SamplingProfiler>(std::chrono::microseconds{500});
+        profiler->Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        profiler->Stop();
+        total += profiler->Samples() + profiler->Dropped();
+    }
+    done.store(true);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    REQUIRE(total > 0);
+}
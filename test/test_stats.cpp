@@ -0,0 +1,60 @@
+#include <test/scheme_test.h>
+
+TEST_CASE("RuntimeStatsCounters") {
+    Scheme scheme;
+    scheme.ResetStats();
+    scheme.Evaluate("(define x 1)");
+    scheme.Evaluate("(define f (lambda (y) (+ x y)))");
+    REQUIRE(scheme.Evaluate("(f 2)") == "3");
+    REQUIRE(scheme.Evaluate("(f 3)") == "4");
+
+    auto stats = scheme.Stats();
+    INFO(stats.ToString());
+    REQUIRE(stats.evals >= 4);
+    REQUIRE(stats.tokens > 20);
+    REQUIRE(stats.parsed_nodes > 10);
+    REQUIRE(stats.scope_lookups > 0);
+    REQUIRE(stats.average_scope_depth >= 1);
+    REQUIRE(stats.allocations["Lambda"] == 1);
+    REQUIRE(stats.allocations["Cell"] > 0);
+    REQUIRE(stats.peak_live_objects >= stats.live_objects);
+
+    scheme.ResetStats();
+    stats = scheme.Stats();
+    REQUIRE(stats.evals == 0);
+    REQUIRE(stats.allocations.empty());
+    REQUIRE(stats.peak_live_objects == stats.live_objects);
+}
+
+TEST_CASE("RuntimeStatsCountsApplies") {
+    Scheme scheme;
+    scheme.Evaluate("(define (f x) x)");
+
+    scheme.ResetStats();
+    REQUIRE(scheme.Evaluate("(f 2)") == "2");
+    auto stats = scheme.Stats();
+    REQUIRE(stats.evals == 1);
+    REQUIRE(stats.applies == 1);
+
+    scheme.ResetStats();
+    REQUIRE(scheme.Evaluate("((lambda (y) y) 2)") == "2");
+    stats = scheme.Stats();
+    REQUIRE(stats.evals == 2);
+    REQUIRE(stats.applies == 1);
+
+    scheme.ResetStats();
+    REQUIRE(scheme.Evaluate("(+ 1 2)") == "3");
+    stats = scheme.Stats();
+    REQUIRE(stats.evals == 1);
+    REQUIRE(stats.applies == 0);
+}
+
+TEST_CASE("RuntimeStatsBuiltin") {
+    Scheme scheme;
+    scheme.Evaluate("(runtime-stats-reset)");
+    scheme.Evaluate("(+ 1 2)");
+    auto report = scheme.Evaluate("(runtime-stats)");
+    REQUIRE(report.find("evals ") != std::string::npos);
+    REQUIRE(report.find("allocated Number") != std::string::npos);
+    REQUIRE_THROWS_AS(scheme.Evaluate("(runtime-stats 1)"), RuntimeError);
+}
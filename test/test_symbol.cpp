@@ -42,3 +42,53 @@ TEST_CASE_METHOD(SchemeTest, "SetInvalidSyntax") {
     ExpectSyntaxError("(set! 1)");
     ExpectSyntaxError("(set! x 1 2)");
 }
+
+TEST_CASE_METHOD(SchemeTest, "SymbolLookupSeesRebinding") {
+    ExpectNoError("(define x 1)");
+    ExpectNoError("(define get-x (lambda () x))");
+    ExpectEq("(get-x)", "1");
+
+    ExpectNoError("(define x 2)");
+    ExpectEq("(get-x)", "2");
+    ExpectNoError("(set! x 3)");
+    ExpectEq("(get-x)", "3");
+
+    ExpectNoError("(define shadow (lambda (flag) (if flag (define x 100) #f) x))");
+    ExpectEq("(shadow #f)", "3");
+    ExpectEq("(shadow #t)", "100");
+    ExpectEq("x", "3");
+}
+
+TEST_CASE("SymbolCacheSurvivesUnrelatedDefines") {
+    Scheme scheme;
+    scheme.Evaluate("(define y 1)");
+    scheme.Evaluate("(define get-y (lambda () y))");
+    REQUIRE(scheme.Evaluate("(get-y)") == "1");
+
+    scheme.Evaluate("(define other 5)");
+    scheme.ResetStats();
+    REQUIRE(scheme.Evaluate("(get-y)") == "1");
+    REQUIRE(scheme.Stats().symbol_cache_hits > 0);
+
+    scheme.Evaluate("(define shadow (lambda () (define y 2) (get-y)))");
+    REQUIRE(scheme.Evaluate("(shadow)") == "1");
+    REQUIRE(scheme.Evaluate("(get-y)") == "1");
+}
+
+TEST_CASE("SymbolCacheSurvivesInterpreterSwitches") {
+    Scheme scheme;
+    scheme.Evaluate("(define y 1)");
+    scheme.Evaluate("(define get-y (lambda () y))");
+    Scheme clone = scheme.Clone();
+    clone.Evaluate("(define y 2)");
+    REQUIRE(scheme.Evaluate("(get-y)") == "1");
+
+    REQUIRE(scheme.Evaluate("(touch (future (+ y 1)))") == "2");
+    REQUIRE(clone.Evaluate("(touch (future (+ y 1)))") == "3");
+    scheme.ResetStats();
+    REQUIRE(scheme.Evaluate("(get-y)") == "1");
+    REQUIRE(scheme.Stats().symbol_cache_hits > 0);
+
+    REQUIRE(clone.Evaluate("(get-y)") == "2");
+    REQUIRE(scheme.Evaluate("(get-y)") == "1");
+}
@@ -0,0 +1,64 @@
+#include <test/scheme_test.h>
+
+#include <sstream>
+
+TEST_CASE("TokenizerPositions") {
+    std::stringstream ss{"(a\n  12 'b)"};
+    Tokenizer tokenizer{&ss};
+    std::vector<std::pair<uint32_t, uint32_t>> positions;
+    while (!tokenizer.IsEnd()) {
+        positions.emplace_back(tokenizer.GetPosition().line, tokenizer.GetPosition().column);
+        tokenizer.Next();
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> expected = {
+        {1, 1}, {1, 2}, {2, 3}, {2, 6}, {2, 7}, {2, 8}};
+    REQUIRE(positions == expected);
+}
+
+TEST_CASE("CellPositions") {
+    std::stringstream ss{"(define x\n  (+ 1 (* 2 3)))"};
+    Tokenizer tokenizer{&ss};
+    auto form = As<Cell>(Read(&tokenizer));
+    REQUIRE(form->GetPosition().line == 1);
+    REQUIRE(form->GetPosition().column == 1);
+    auto value = As<Cell>(As<Cell>(As<Cell>(form->GetSecond())->GetSecond())->GetFirst());
+    REQUIRE(value->GetPosition().line == 2);
+    REQUIRE(value->GetPosition().column == 3);
+}
+
+TEST_CASE("EvalTraceOnError") {
+    Scheme scheme;
+    scheme.EnableTrace();
+    scheme.Evaluate("(define f (lambda (x) (abs x 2)))");
+    std::string trace;
+    try {
+        scheme.Evaluate("(+ 1\n   (f 2))");
+    } catch (const RuntimeError& ex) {
+        trace = ex.Trace();
+    }
+    INFO(trace);
+    REQUIRE(trace.find("+ 1:1\n") != std::string::npos);
+    REQUIRE(trace.find("f 2:4\n") != std::string::npos);
+    REQUIRE(trace.find("abs 1:23\n") != std::string::npos);
+    REQUIRE(trace.find("abs") > trace.find("f 2:4"));
+
+    REQUIRE(scheme.TraceDump().find("abs") != std::string::npos);
+    scheme.DisableTrace();
+    REQUIRE(scheme.TraceDump().empty());
+    try {
+        scheme.Evaluate("(f 2)");
+    } catch (const RuntimeError& ex) {
+        REQUIRE(ex.Trace().empty());
+    }
+}
+
+TEST_CASE("EvalTraceWrapsAround") {
+    Scheme scheme;
+    scheme.EnableTrace();
+    scheme.Evaluate("(define loop (lambda (n) (if (= n 0) 0 (loop (- n 1)))))");
+    scheme.Evaluate("(loop 1000)");
+    auto dump = scheme.TraceDump();
+    REQUIRE(std::count(dump.begin(), dump.end(), '\n') == EvalTrace::kSize);
+    REQUIRE(dump.rfind("+0 ", 0) == 0);
+    scheme.DisableTrace();
+}
@@ -4,6 +4,9 @@
 #include <istream>
 #include <iostream>
 
+#include "stats.h"
+#include "trace.h"
+
 struct SymbolToken {
     std::string name;
 
@@ -54,43 +57,45 @@ public:
         if (IsEnd()) {
             return;
         }
+        ++runtime_stats.tokens;
         while (in_->peek() == ' ' || in_->peek() == '\n' || in_->peek() == '\t') {
-            in_->get();
+            Get();
         }
+        position_ = {line_, column_};
         char symbol = in_->peek();
         if (symbol == EOF) {
             end_ = true;
         }
         std::string lexeme;
         if (symbol == '\'') {
-            in_->get();
+            Get();
             token_ = QuoteToken();
         } else if (symbol == '.') {
-            in_->get();
+            Get();
             token_ = DotToken();
         } else if (symbol == '(') {
-            in_->get();
+            Get();
             token_ = BracketToken::OPEN;
         } else if (symbol == ')') {
-            in_->get();
+            Get();
             token_ = BracketToken::CLOSE;
         } else if (std::isdigit(symbol)) {
             while (std::isdigit(in_->peek())) {
-                lexeme += in_->get();
+                lexeme += Get();
             }
-            token_ = ConstantToken{std::stoi(lexeme)};
+            token_ = ConstantToken{std::stoll(lexeme)};
         } else {
-            lexeme += in_->get();
+            lexeme += Get();
             if (std::isdigit(in_->peek())) {
                 while (std::isdigit(in_->peek())) {
-                    lexeme += in_->get();
+                    lexeme += Get();
                 }
-                token_ = ConstantToken{std::stoi(lexeme)};
+                token_ = ConstantToken{std::stoll(lexeme)};
             } else {
                 while (in_->peek() != EOF && in_->peek() != ' ' && in_->peek() != '\t' &&
                        in_->peek() != '\n' && in_->peek() != '(' && in_->peek() != ')' &&
                        in_->peek() != '.' && in_->peek() != '\'' && !std::isdigit(in_->peek())) {
-                    lexeme += in_->get();
+                    lexeme += Get();
                 }
                 if (lexeme == "#t") {
                     token_ = BooleanToken::True;
@@ -107,8 +112,27 @@ public:
         return token_;
     }
 
+    // Позиция начала текущего токена.
+    SourcePosition GetPosition() const {
+        return position_;
+    }
+
 private:
+    char Get() {
+        char symbol = in_->get();
+        if (symbol == '\n') {
+            ++line_;
+            column_ = 1;
+        } else {
+            ++column_;
+        }
+        return symbol;
+    }
+
     bool end_ = false;
     std::istream* in_;
     Token token_;
+    uint32_t line_ = 1;
+    uint32_t column_ = 1;
+    SourcePosition position_;
 };
@@ -0,0 +1,27 @@
+#include "trace.h"
+
+#include <sstream>
+
+#include "object.h"
+
+std::string EvalTrace::Dump() const {
+    std::stringstream ss;
+    uint64_t first = count > kSize ? count - kSize : 0;
+    for (uint64_t i = first; i < count; ++i) {
+        const Record& record = records[i % kSize];
+        ss << '+' << record.timestamp - records[first % kSize].timestamp << ' ';
+        if (record.name) {
+            ss << *record.name;
+        } else if (*record.type == typeid(Lambda)) {
+            ss << "lambda";
+        } else {
+            auto name = BuiltinName(*record.type);
+            ss << (name.empty() ? "?" : name);
+        }
+        if (record.position.line) {
+            ss << ' ' << record.position.line << ':' << record.position.column;
+        }
+        ss << '\n';
+    }
+    return ss.str();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+
+// Позиция в исходном тексте, нумерация с единицы; 0 означает, что позиция неизвестна.
+struct SourcePosition {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+// Кольцевой буфер последних вызовов текущего потока. Пока трассировка выключена,
+// вызов стоит одной проверки флага, включённая — нескольких записей в буфер.
+struct EvalTrace {
+    struct Record {
+        // Встроенные функции опознаются по типу, лямбды — по имени, под которым
+        // они определены (nullptr у безымянных).
+        const std::type_info* type;
+        const std::string* name;
+        SourcePosition position;
+        uint64_t timestamp;
+    };
+
+    static constexpr size_t kSize = 256;
+
+    bool enabled = false;
+    uint64_t count = 0;
+    std::array<Record, kSize> records{};
+
+    void Push(const std::type_info* type, const std::string* name, SourcePosition position) {
+        records[count++ % kSize] = {type, name, position, Timestamp()};
+    }
+
+    void Clear() {
+        count = 0;
+    }
+
+    // Записи от старых к новым: время в тиках от первой записи, процедура и позиция
+    // вызова, например "+1520 fib 3:7".
+    std::string Dump() const;
+
+    // Счётчик тактов процессора там, где он есть: он дешевле steady_clock.
+    static uint64_t Timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+};
+
+inline thread_local EvalTrace eval_trace;